@@ -52,6 +52,8 @@ namespace mage
 
 		while ( gIsRunning )
 		{
+			FrameAllocator::BeginFrame();
+
 			while ( SDL_PollEvent( &sdlEvent ) )
 			{
 				if ( !gInputFn( sdlEvent ) )
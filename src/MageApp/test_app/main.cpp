@@ -12,6 +12,8 @@ int main( int argc, char** argv )
 
 	Run();
 
+	FrameAllocator::Terminate();
+
 	return 0;
 }
 
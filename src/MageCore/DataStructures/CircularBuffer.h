@@ -15,14 +15,18 @@ namespace mage
 	{
 	public:
 		CircularBuffer( int size=512 );
+		CircularBuffer( const CircularBuffer& other );
 		~CircularBuffer();
 
+		CircularBuffer& operator=( const CircularBuffer& other );
+
 		inline bool IsEmpty() const;
 		void Write( const T& element );
 		const T& Read( int offset=0 ) const;
 		void Resize( int newSize );
 		void Clear();
 		int Length() const;
+		int Capacity() const;
 
 	private:
 		int mSize;
@@ -46,12 +50,40 @@ namespace mage
 	}
 	//---------------------------------------
 	template< typename T >
+	CircularBuffer< T >::CircularBuffer( const CircularBuffer& other )
+		: mSize( other.mSize )
+		, mStart( other.mStart )
+		, mEnd( other.mEnd )
+	{
+		mElements = new T[ mSize ];
+		for ( int i = 0; i < mSize; ++i )
+			mElements[i] = other.mElements[i];
+	}
+	//---------------------------------------
+	template< typename T >
 	CircularBuffer< T >::~CircularBuffer()
 	{
 		delete[] mElements;
 	}
 	//---------------------------------------
 	template< typename T >
+	CircularBuffer< T >& CircularBuffer< T >::operator=( const CircularBuffer& other )
+	{
+		if ( this != &other )
+		{
+			T* newElements = new T[ other.mSize ];
+			for ( int i = 0; i < other.mSize; ++i )
+				newElements[i] = other.mElements[i];
+			delete[] mElements;
+			mElements = newElements;
+			mSize = other.mSize;
+			mStart = other.mStart;
+			mEnd = other.mEnd;
+		}
+		return *this;
+	}
+	//---------------------------------------
+	template< typename T >
 	inline bool CircularBuffer< T >::IsEmpty() const
 	{
 		return mEnd == mStart;
@@ -70,7 +102,7 @@ namespace mage
 	}
 	//---------------------------------------
 	template< typename T >
-	const T& CircularBuffer< T >::Read( int offset=0 ) const
+	const T& CircularBuffer< T >::Read( int offset ) const
 	{
 		int index = ( mStart + offset ) % mSize;
 		return mElements[ index ];
@@ -79,11 +111,17 @@ namespace mage
 	template< typename T >
 	void CircularBuffer< T >::Resize( int newSize )
 	{
+		// Keep the newest elements that fit, oldest first
 		T* newBuffer = new T[ newSize+1 ];
-		memcpy( newBuffer, mElements, sizeof( T ) * mSize );
+		int length = Length();
+		int skip = length > newSize ? length - newSize : 0;
+		for ( int i = skip; i < length; ++i )
+			newBuffer[ i - skip ] = Read( i );
 		delete[] mElements;
 		mElements = newBuffer;
 		mSize = newSize+1;
+		mStart = 0;
+		mEnd = length - skip;
 	}
 	//---------------------------------------
 	template< typename T >
@@ -96,8 +134,13 @@ namespace mage
 	template< typename T >
 	int CircularBuffer< T >::Length() const
 	{
-		if ( mStart > mEnd ) return mSize - 1;
-		return mStart + mEnd;
+		return ( mEnd - mStart + mSize ) % mSize;
+	}
+	//---------------------------------------
+	template< typename T >
+	int CircularBuffer< T >::Capacity() const
+	{
+		return mSize - 1;
 	}
 	//---------------------------------------
 
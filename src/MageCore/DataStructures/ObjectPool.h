@@ -0,0 +1,286 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Pool of fixed size objects for types that are created and destroyed all
+ *   the time. Objects live in chunks of contiguous slots that are never moved
+ *   or freed until the pool is, free slots link to each other through their
+ *   own memory, so Create and Destroy are a couple of pointer moves.
+ *
+ *   Handles name an object by slot index and generation. A slot's generation
+ *   goes up every time it is created in or destroyed, so a handle to a
+ *   destroyed object gets NULL from Get instead of whatever reused the slot:
+ *
+ *   ObjectPool< Bullet >::Handle h = pool.GetHandle( pool.Create() );
+ *   if ( Bullet* b = pool.Get( h ) ) ...
+ *
+ *   TLock guards the pool for use from several threads, use SpinLock or Mutex.
+ *   The default NullLock does nothing. Locking only keeps the pool itself
+ *   consistent, an object destroyed on one thread is still gone for the others.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	// Lock that does nothing, for pools only used from one thread
+	struct NullLock
+	{
+		void Lock()		{}
+		void Unlock()	{}
+	};
+
+	template< typename T, typename TLock=NullLock >
+	class ObjectPool
+	{
+	public:
+		struct Handle
+		{
+			Handle()
+				: Index( 0 )
+				, Generation( 0 )
+			{}
+
+			bool IsNull() const									{ return Generation == 0; }
+			bool operator==( const Handle& other ) const		{ return Index == other.Index && Generation == other.Generation; }
+			bool operator!=( const Handle& other ) const		{ return !( *this == other ); }
+
+			uint32 Index;
+			uint32 Generation;				// Odd, 0 for the null handle
+		};
+
+		ObjectPool( uint32 objectsPerChunk=64 );
+		// Destroys any objects still alive
+		~ObjectPool();
+
+		// Default or copy constructed object, in the most recently freed slot. NULL if out of memory.
+		T* Create();
+		T* Create( const T& value );
+		void Destroy( T* object );
+		void Destroy( Handle handle );
+		// Destroy every object, chunks are kept for reuse
+		void Clear();
+
+		Handle GetHandle( const T* object ) const;
+		// NULL if the object the handle was made for has been destroyed
+		T* Get( Handle handle ) const;
+
+		// Call fn( T& ) for each live object in memory order. Don't create or destroy from fn.
+		template< typename TFunc >
+		void ForEach( const TFunc& fn );
+
+		uint32 GetCount() const									{ return mCount; }
+		uint32 GetCapacity() const								{ return (uint32) mChunks.size() * mObjectsPerChunk; }
+
+	private:
+		ObjectPool( const ObjectPool& );
+		ObjectPool& operator=( const ObjectPool& );
+
+		struct Slot
+		{
+			// First so a T* is its Slot*
+			union
+			{
+				uint8 Storage[ sizeof( T ) ];
+				uint32 NextFree;			// While the slot is free
+				double AlignDouble;
+				void* AlignPointer;
+			};
+			uint32 Index;
+			uint32 Generation;				// Odd while the slot holds an object
+		};
+
+		static const uint32 NO_FREE_SLOT = 0xFFFFFFFFU;
+
+		class Guard
+		{
+		public:
+			Guard( TLock& lock )	: mLock( lock )		{ mLock.Lock(); }
+			~Guard()									{ mLock.Unlock(); }
+		private:
+			Guard& operator=( const Guard& );
+			TLock& mLock;
+		};
+
+		Slot* GetSlot( uint32 index ) const						{ return &mChunks[ index / mObjectsPerChunk ][ index % mObjectsPerChunk ]; }
+		static Slot* SlotOf( const T* object )					{ return (Slot*) object; }
+		// Take a free slot, adding a chunk if there isn't one. NULL if out of memory.
+		Slot* AllocateSlot();
+		void FreeSlot( Slot* slot );
+
+		std::vector< Slot* > mChunks;
+		uint32 mObjectsPerChunk;
+		uint32 mFreeHead;
+		uint32 mCount;
+		mutable TLock mLock;
+	};
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename T, typename TLock >
+	ObjectPool< T, TLock >::ObjectPool( uint32 objectsPerChunk )
+		: mObjectsPerChunk( objectsPerChunk > 0 ? objectsPerChunk : 1 )
+		, mFreeHead( NO_FREE_SLOT )
+		, mCount( 0 )
+	{}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	ObjectPool< T, TLock >::~ObjectPool()
+	{
+		Clear();
+		for ( unsigned int i = 0; i < mChunks.size(); ++i )
+		{
+			free( mChunks[i] );
+		}
+	}
+	//---------------------------------------
+#pragma push_macro( "new" )
+#undef new
+	template< typename T, typename TLock >
+	T* ObjectPool< T, TLock >::Create()
+	{
+		Guard guard( mLock );
+		Slot* slot = AllocateSlot();
+		return slot ? new( (void*) slot->Storage ) T() : NULL;
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	T* ObjectPool< T, TLock >::Create( const T& value )
+	{
+		Guard guard( mLock );
+		Slot* slot = AllocateSlot();
+		return slot ? new( (void*) slot->Storage ) T( value ) : NULL;
+	}
+#pragma pop_macro( "new" )
+	//---------------------------------------
+	template< typename T, typename TLock >
+	void ObjectPool< T, TLock >::Destroy( T* object )
+	{
+		if ( !object ) return;
+
+		Guard guard( mLock );
+		Slot* slot = SlotOf( object );
+		DebugAsssertion( ( slot->Generation & 1 ) != 0, "ObjectPool : Object destroyed twice\n" );
+
+		object->~T();
+		FreeSlot( slot );
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	void ObjectPool< T, TLock >::Destroy( Handle handle )
+	{
+		Guard guard( mLock );
+		if ( handle.IsNull() || handle.Index >= GetCapacity() ) return;
+
+		Slot* slot = GetSlot( handle.Index );
+		if ( slot->Generation != handle.Generation ) return;
+
+		( (T*) slot->Storage )->~T();
+		FreeSlot( slot );
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	void ObjectPool< T, TLock >::Clear()
+	{
+		Guard guard( mLock );
+		for ( uint32 i = 0; i < GetCapacity(); ++i )
+		{
+			Slot* slot = GetSlot( i );
+			if ( slot->Generation & 1 )
+			{
+				( (T*) slot->Storage )->~T();
+				FreeSlot( slot );
+			}
+		}
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	typename ObjectPool< T, TLock >::Handle ObjectPool< T, TLock >::GetHandle( const T* object ) const
+	{
+		Handle handle;
+		if ( object )
+		{
+			const Slot* slot = SlotOf( object );
+			handle.Index = slot->Index;
+			handle.Generation = slot->Generation;
+		}
+		return handle;
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	T* ObjectPool< T, TLock >::Get( Handle handle ) const
+	{
+		Guard guard( mLock );
+		if ( handle.IsNull() || handle.Index >= GetCapacity() ) return NULL;
+
+		Slot* slot = GetSlot( handle.Index );
+		return slot->Generation == handle.Generation ? (T*) slot->Storage : NULL;
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	template< typename TFunc >
+	void ObjectPool< T, TLock >::ForEach( const TFunc& fn )
+	{
+		Guard guard( mLock );
+		for ( unsigned int c = 0; c < mChunks.size(); ++c )
+		{
+			Slot* chunk = mChunks[c];
+			for ( uint32 i = 0; i < mObjectsPerChunk; ++i )
+			{
+				if ( chunk[i].Generation & 1 )
+				{
+					fn( *(T*) chunk[i].Storage );
+				}
+			}
+		}
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	typename ObjectPool< T, TLock >::Slot* ObjectPool< T, TLock >::AllocateSlot()
+	{
+		if ( mFreeHead == NO_FREE_SLOT )
+		{
+			// Chunks come from malloc so slots aren't constructed, each is linked into the free list
+			Slot* chunk = (Slot*) malloc( mObjectsPerChunk * sizeof( Slot ) );
+			if ( !chunk )
+			{
+				ConsolePrintf( CONSOLE_ERROR, "ObjectPool : Out of memory adding a chunk of %u objects\n", mObjectsPerChunk );
+				return NULL;
+			}
+
+			uint32 first = GetCapacity();
+			mChunks.push_back( chunk );
+
+			// Link backwards so the first slot of the chunk is handed out first
+			for ( uint32 i = mObjectsPerChunk; i-- > 0; )
+			{
+				chunk[i].Index = first + i;
+				chunk[i].Generation = 0;
+				chunk[i].NextFree = mFreeHead;
+				mFreeHead = first + i;
+			}
+		}
+
+		Slot* slot = GetSlot( mFreeHead );
+		mFreeHead = slot->NextFree;
+		++slot->Generation;
+		++mCount;
+		return slot;
+	}
+	//---------------------------------------
+	template< typename T, typename TLock >
+	void ObjectPool< T, TLock >::FreeSlot( Slot* slot )
+	{
+		// Skip 0 when wrapping, it is the null handle's generation
+		if ( ++slot->Generation == 0 ) slot->Generation = 2;
+		slot->NextFree = mFreeHead;
+		mFreeHead = slot->Index;
+		--mCount;
+	}
+	//---------------------------------------
+
+}
@@ -0,0 +1,268 @@
+#include "CoreLib.h"
+
+using namespace mage;
+
+//---------------------------------------
+// Heap memory a thread took when its frame buffer was full, freed with the buffer
+struct FrameOverflow
+{
+	FrameOverflow* Next;
+};
+
+struct FrameAllocator::ThreadFrames
+{
+	LinearAllocator Buffers[ 2 ];				// Even and odd frames
+	int32 Frames[ 2 ];							// Frame each buffer was last reset for
+	FrameOverflow* Overflows[ 2 ];
+	uint32 OverflowBytes[ 2 ];
+	ThreadFrames* NextOrphan;					// Frames of threads that have exited, for the next thread that needs them
+	bool Orphaned;
+	ThreadFrames* NextFrames;					// Every thread's frames, to free them at shutdown
+};
+
+static volatile int32 gFrameNumber = 0;
+static uint32 gFrameSize = FrameAllocator::DEFAULT_FRAME_SIZE;
+static THREAD_LOCAL FrameAllocator::ThreadFrames* gThreadFrames = NULL;
+static FrameAllocator::ThreadFrames* gOrphanFrames = NULL;
+static FrameAllocator::ThreadFrames* gAllFrames = NULL;
+static Mutex gFramesMutex;
+
+//---------------------------------------
+static void FreeOverflows( FrameAllocator::ThreadFrames* frames, int index )
+{
+	FrameOverflow* overflow = frames->Overflows[ index ];
+	while ( overflow )
+	{
+		FrameOverflow* next = overflow->Next;
+		free( overflow );
+		overflow = next;
+	}
+
+	frames->Overflows[ index ] = NULL;
+	frames->OverflowBytes[ index ] = 0;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// LinearAllocator
+//---------------------------------------
+LinearAllocator::LinearAllocator()
+	: mBuffer( NULL )
+	, mCapacity( 0 )
+	, mUsed( 0 )
+	, mPeakUsed( 0 )
+{}
+//---------------------------------------
+LinearAllocator::~LinearAllocator()
+{
+	Terminate();
+}
+//---------------------------------------
+bool LinearAllocator::Initialize( uint32 capacity )
+{
+	Terminate();
+
+	mBuffer = (uint8*) malloc( capacity );
+	if ( !mBuffer )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "LinearAllocator : Failed to allocate %s\n", ByteDisplay( capacity ).ToString() );
+		return false;
+	}
+
+	mCapacity = capacity;
+	mUsed = 0;
+	return true;
+}
+//---------------------------------------
+void LinearAllocator::Terminate()
+{
+	free( mBuffer );
+	mBuffer = NULL;
+	mCapacity = 0;
+	mUsed = 0;
+}
+//---------------------------------------
+void LinearAllocator::Reset()
+{
+#ifdef _DEBUG
+	memset( mBuffer, POISON_BYTE, mUsed );
+#endif
+	mUsed = 0;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// FrameAllocator
+//---------------------------------------
+void FrameAllocator::SetFrameSize( uint32 bytes )
+{
+	gFrameSize = bytes;
+}
+//---------------------------------------
+void FrameAllocator::BeginFrame()
+{
+	AtomicIncrement( &gFrameNumber );
+}
+//---------------------------------------
+uint32 FrameAllocator::GetFrameNumber()
+{
+	return (uint32) AtomicLoadAcquire( &gFrameNumber );
+}
+//---------------------------------------
+void* FrameAllocator::Allocate( size_t bytes, uint32 alignment )
+{
+	ThreadFrames* frames = gThreadFrames;
+	if ( !frames )
+	{
+		frames = GetThreadFrames();
+		if ( !frames ) return NULL;
+	}
+
+	int32 frame = AtomicLoadAcquire( &gFrameNumber );
+	int index = frame & 1;
+
+	// First allocation this frame, the buffer's memory is two frames old
+	if ( frames->Frames[ index ] != frame )
+	{
+		BeginThreadFrame( frames, index, frame );
+	}
+
+	void* memory = frames->Buffers[ index ].Allocate( bytes, alignment );
+	if ( !memory )
+	{
+		memory = AllocateOverflow( frames, index, bytes, alignment );
+	}
+	return memory;
+}
+//---------------------------------------
+void FrameAllocator::ReleaseThreadFrames()
+{
+	ThreadFrames* frames = gThreadFrames;
+	if ( !frames ) return;
+
+	gThreadFrames = NULL;
+
+	// Memory handed out is left alone, it may still be in use until its frame is over
+	CriticalBlock( gFramesMutex );
+	frames->NextOrphan = gOrphanFrames;
+	frames->Orphaned = true;
+	gOrphanFrames = frames;
+}
+//---------------------------------------
+void FrameAllocator::Terminate()
+{
+	CriticalBlock( gFramesMutex );
+
+	// Threads still running hold on to their frames, freeing them would leave those threads pointing at freed memory
+	ThreadFrames* kept = NULL;
+	uint32 numKept = 0;
+
+	ThreadFrames* frames = gAllFrames;
+	while ( frames )
+	{
+		ThreadFrames* next = frames->NextFrames;
+		if ( frames->Orphaned || frames == gThreadFrames )
+		{
+			for ( int i = 0; i < 2; ++i )
+			{
+				FreeOverflows( frames, i );
+			}
+			delete frames;
+		}
+		else
+		{
+			frames->NextFrames = kept;
+			kept = frames;
+			++numKept;
+		}
+		frames = next;
+	}
+
+	if ( numKept > 0 )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "FrameAllocator : %u threads still running at Terminate, their frames aren't freed\n", numKept );
+	}
+
+	gAllFrames = kept;
+	gOrphanFrames = NULL;
+	gThreadFrames = NULL;
+}
+//---------------------------------------
+FrameAllocator::ThreadFrames* FrameAllocator::GetThreadFrames()
+{
+	CriticalBlock( gFramesMutex );
+
+	// Take over the frames of a thread that has exited, or make some
+	ThreadFrames* frames = gOrphanFrames;
+	if ( frames )
+	{
+		gOrphanFrames = frames->NextOrphan;
+	}
+	else
+	{
+		frames = new ThreadFrames;
+		for ( int i = 0; i < 2; ++i )
+		{
+			if ( !frames->Buffers[i].Initialize( gFrameSize ) )
+			{
+				delete frames;
+				return NULL;
+			}
+			frames->Frames[i] = AtomicLoadAcquire( &gFrameNumber );
+			frames->Overflows[i] = NULL;
+			frames->OverflowBytes[i] = 0;
+		}
+
+		frames->NextFrames = gAllFrames;
+		gAllFrames = frames;
+	}
+
+	frames->NextOrphan = NULL;
+	frames->Orphaned = false;
+	gThreadFrames = frames;
+	return frames;
+}
+//---------------------------------------
+void FrameAllocator::BeginThreadFrame( ThreadFrames* frames, int index, int32 frame )
+{
+	LinearAllocator& buffer = frames->Buffers[ index ];
+
+	if ( frames->Overflows[ index ] )
+	{
+		// Make room for what the last frame needed so it fits in the buffer next time, at least doubling it
+		uint32 size = buffer.GetCapacity() + frames->OverflowBytes[ index ];
+		if ( size < 2 * buffer.GetCapacity() ) size = 2 * buffer.GetCapacity();
+		FreeOverflows( frames, index );
+
+		ConsolePrintf( CONSOLE_WARNING, "FrameAllocator : Frame buffer overflowed, growing it to %s\n", ByteDisplay( size ).ToString() );
+		buffer.Initialize( size );
+	}
+	else
+	{
+		buffer.Reset();
+	}
+
+	frames->Frames[ index ] = frame;
+}
+//---------------------------------------
+void* FrameAllocator::AllocateOverflow( ThreadFrames* frames, int index, size_t bytes, uint32 alignment )
+{
+	// Room for the link and for aligning the memory after it
+	size_t header = ( sizeof( FrameOverflow ) + alignment - 1 ) & ~(size_t) ( alignment - 1 );
+	uint8* block = (uint8*) malloc( header + bytes + alignment );
+	if ( !block )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "FrameAllocator : Out of memory allocating %s\n", ByteDisplay( (uint32) bytes ).ToString() );
+		return NULL;
+	}
+
+	FrameOverflow* overflow = (FrameOverflow*) block;
+	overflow->Next = frames->Overflows[ index ];
+	frames->Overflows[ index ] = overflow;
+	frames->OverflowBytes[ index ] += (uint32) ( bytes + alignment );
+
+	return (void*) ( ( (size_t) block + header + alignment - 1 ) & ~(size_t) ( alignment - 1 ) );
+}
+//---------------------------------------
@@ -0,0 +1,181 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Scratch memory for work that only lasts a frame. Allocating is a pointer
+ *   bump and there is no free, a buffer is reset all at once.
+ *
+ *   Every thread, job workers included, has its own pair of frame buffers used
+ *   on alternate frames, so nothing is shared or locked. A thread switches
+ *   buffers the first time it allocates after FrameAllocator::BeginFrame, which
+ *   the main loop calls once per frame. Memory from frame N stays good through
+ *   frame N+1 and must not be touched once frame N+2 begins:
+ *
+ *   std::vector< float, FrameStlAllocator< float > > points;
+ *   points.reserve( 2 * segments );
+ *
+ *   Debug builds fill reset memory with LinearAllocator::POISON_BYTE so stale
+ *   pointers read garbage instead of what used to be there.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	//---------------------------------------
+	// Bump allocator over a fixed buffer
+	class LinearAllocator
+	{
+	public:
+		static const uint32 DEFAULT_ALIGNMENT = 16;
+		static const uint8 POISON_BYTE = 0xDD;
+
+		LinearAllocator();
+		~LinearAllocator();
+
+		// Buffer from malloc, not the memory pool, so it can be bigger than a pool block
+		bool Initialize( uint32 capacity );
+		void Terminate();
+
+		// NULL if there isn't room. alignment must be a power of two.
+		void* Allocate( size_t bytes, uint32 alignment=DEFAULT_ALIGNMENT );
+		// Forget everything allocated
+		void Reset();
+
+		uint32 GetCapacity() const			{ return mCapacity; }
+		uint32 GetUsed() const				{ return mUsed; }
+		uint32 GetPeakUsed() const			{ return mPeakUsed; }
+
+	private:
+		LinearAllocator( const LinearAllocator& );
+		LinearAllocator& operator=( const LinearAllocator& );
+
+		uint8* mBuffer;
+		uint32 mCapacity;
+		uint32 mUsed;
+		uint32 mPeakUsed;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Per thread, double buffered frame memory
+	class FrameAllocator
+	{
+	public:
+		static const uint32 DEFAULT_FRAME_SIZE = 1048576U; // 1MB
+
+		// Size of each frame buffer, for threads that haven't allocated yet
+		static void SetFrameSize( uint32 bytes );
+		// Start a new frame, call once per frame from the main loop
+		static void BeginFrame();
+		static uint32 GetFrameNumber();
+
+		// Memory for the rest of this frame and the next, on the calling thread's buffer.
+		// Falls back to the heap when the buffer is full, the buffer grows to fit when it is next reset.
+		static void* Allocate( size_t bytes, uint32 alignment=LinearAllocator::DEFAULT_ALIGNMENT );
+		// Uninitialized array of count T's
+		template< typename T >
+		static T* AllocateArray( uint32 count )	{ return (T*) Allocate( count * sizeof( T ) ); }
+
+		// Hand the calling thread's buffers to the next thread that needs them. Threads call this on exit.
+		static void ReleaseThreadFrames();
+		// Free the buffers of the calling thread and of threads that have exited. Call it once every
+		// other thread that used frame memory, job workers included, has been joined. The buffers of
+		// threads still running are left alone.
+		static void Terminate();
+
+		struct ThreadFrames;
+
+	private:
+		static ThreadFrames* GetThreadFrames();
+		static void BeginThreadFrame( ThreadFrames* frames, int index, int32 frame );
+		static void* AllocateOverflow( ThreadFrames* frames, int index, size_t bytes, uint32 alignment );
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Allocator for std containers that only live for a frame. Freeing does nothing.
+	template< typename T >
+	class FrameStlAllocator
+	{
+	public:
+
+		typedef T				value_type;
+		typedef T*				pointer;
+		typedef const T*		const_pointer;
+		typedef T&				reference;
+		typedef const T&		const_reference;
+		typedef std::size_t		size_type;
+		typedef std::ptrdiff_t	difference_type;
+
+		template< typename U >
+		struct rebind
+		{
+			typedef FrameStlAllocator< U > other;
+		};
+
+		pointer address( reference value ) const { return &value; }
+		const_pointer address( const_reference value ) const { return &value; }
+
+		FrameStlAllocator() throw() {}
+		FrameStlAllocator( const FrameStlAllocator& ) throw() {}
+
+		template< typename U >
+		FrameStlAllocator( const FrameStlAllocator< U >& ) throw() {}
+		~FrameStlAllocator() throw() {}
+
+		size_type max_size() const throw() { return std::numeric_limits< std::size_t >::max() / sizeof( T ); }
+
+		pointer allocate( size_type num, const void* = 0 )
+		{
+			return (pointer) FrameAllocator::Allocate( num * sizeof( T ) );
+		}
+
+#pragma push_macro( "new" )
+#undef new
+		void construct( pointer p, const_reference value )
+		{
+			new( (void*) p ) T(value);
+		}
+#pragma pop_macro( "new" )
+
+		void destroy( pointer p )
+		{
+			p->~T();
+		}
+
+		void deallocate( pointer, size_type )
+		{}
+	};
+
+	template< typename T1, typename T2 >
+	bool operator==( const FrameStlAllocator< T1 >&, const FrameStlAllocator< T2 >& ) throw() { return true; }
+	template< typename T1, typename T2 >
+	bool operator!=( const FrameStlAllocator< T1 >&, const FrameStlAllocator< T2 >& ) throw() { return false; }
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	inline void* LinearAllocator::Allocate( size_t bytes, uint32 alignment )
+	{
+		size_t start = ( (size_t) ( mBuffer + mUsed ) + alignment - 1 ) & ~(size_t) ( alignment - 1 );
+		size_t offset = start - (size_t) mBuffer;
+		if ( offset > mCapacity || bytes > mCapacity - offset )
+		{
+			return NULL;
+		}
+
+		mUsed = (uint32) ( offset + bytes );
+		if ( mUsed > mPeakUsed ) mPeakUsed = mUsed;
+		return (void*) start;
+	}
+	//---------------------------------------
+
+}
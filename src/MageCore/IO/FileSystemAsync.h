@@ -0,0 +1,41 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Data file reads that run on the file I/O worker and hand back a Task.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	// Contents of a data file, see OpenDataFile
+	struct DataFile
+	{
+		DataFile()
+			: Error( FSE_FILE_NOT_FOUND )
+			, Data( NULL )
+			, Length( 0 )
+		{}
+
+		bool IsValid() const				{ return Error == FSE_NO_ERROR; }
+
+		int Error;							// FileSystemError
+		char* Data;							// Null terminated, whoever takes the result delete[]s it
+		unsigned int Length;
+	};
+
+	// Read fname on the file I/O worker
+	inline Task< DataFile > ReadDataFileAsync( const char* fname, Job::JobPriority priority=Job::JP_AVERAGE )
+	{
+		std::string name( fname );
+		return Async< DataFile >( [name]() -> DataFile
+		{
+			DataFile file;
+			file.Error = OpenDataFile( name.c_str(), file.Data, file.Length );
+			return file;
+		}, Job::JOB_FILE_IO, priority );
+	}
+
+}
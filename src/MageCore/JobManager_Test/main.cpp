@@ -0,0 +1,249 @@
+#include <MageMath.h>
+#include <MageCore.h>
+
+using namespace mage;
+
+// Benchmarks and checks for the JobManager.
+// Usage: JobManager_Test [workers=5] [treeDepth=10]
+
+//---------------------------------------
+// Test jobs
+//---------------------------------------
+static volatile int32 gNumExecuted = 0;
+
+//---------------------------------------
+// Something for a job to do
+static void Spin( int iterations )
+{
+	volatile int x = 0;
+	for ( int i = 0; i < iterations; ++i )
+	{
+		x += i;
+	}
+}
+//---------------------------------------
+// Time from push to start
+class LatencyJob
+	: public Job
+{
+public:
+	LatencyJob( double* latencyUS )
+		: mLatencyUS( latencyUS )
+		, mPushTime( Clock::QueryTime( Clock::TIME_MICRO ) )
+	{}
+
+	void OnExecute()
+	{
+		*mLatencyUS = Clock::QueryTime( Clock::TIME_MICRO ) - mPushTime;
+	}
+	void OnCompletetion() {}
+
+private:
+	double* mLatencyUS;
+	double mPushTime;
+};
+//---------------------------------------
+class WorkJob
+	: public Job
+{
+public:
+	void OnExecute()
+	{
+		Spin( 200 );
+		AtomicIncrement( &gNumExecuted );
+	}
+	void OnCompletetion() {}
+};
+//---------------------------------------
+// Pushes two children until depth runs out, from inside the workers
+class TreeJob
+	: public Job
+{
+public:
+	TreeJob( int depth, JobCounter* counter )
+		: mDepth( depth )
+		, mTreeCounter( counter )
+	{
+		SetCounter( counter );
+	}
+
+	void OnExecute()
+	{
+		Spin( 200 );
+		if ( mDepth > 0 )
+		{
+			JobManager::GetInstance()->PushJob( new TreeJob( mDepth - 1, mTreeCounter ) );
+			JobManager::GetInstance()->PushJob( new TreeJob( mDepth - 1, mTreeCounter ) );
+		}
+		AtomicIncrement( &gNumExecuted );
+	}
+	void OnCompletetion() {}
+
+private:
+	int mDepth;
+	JobCounter* mTreeCounter;
+};
+//---------------------------------------
+// One stage of a pipeline, records the order it ran in
+class StageJob
+	: public Job
+{
+public:
+	StageJob( int* order )
+		: mOrder( order )
+	{}
+
+	void OnExecute()
+	{
+		*mOrder = AtomicIncrement( &gNumExecuted );
+		Spin( 20000 );
+	}
+	void OnCompletetion() {}
+
+private:
+	int* mOrder;
+};
+//---------------------------------------
+
+
+//---------------------------------------
+// Tests
+//---------------------------------------
+static double GetMS( double startUS )
+{
+	return ( Clock::QueryTime( Clock::TIME_MICRO ) - startUS ) / 1000.0;
+}
+//---------------------------------------
+// Run completions and delete finished jobs
+static void Finish( const JobCounter& counter )
+{
+	JobManager::GetInstance()->Wait( counter );
+	JobManager::GetInstance()->OnUpdate();
+}
+//---------------------------------------
+// One job at a time with the workers idle in between
+static void TestLatency()
+{
+	const int NUM_SAMPLES = 100;
+	std::vector< double > latencies( NUM_SAMPLES );
+
+	for ( int i = 0; i < NUM_SAMPLES; ++i )
+	{
+		JobCounter counter;
+		LatencyJob* job = new LatencyJob( &latencies[i] );
+		job->SetCounter( &counter );
+		JobManager::GetInstance()->PushJob( job );
+		Finish( counter );
+
+		// Let the workers go back to sleep
+		Thread::Sleep( 2 );
+	}
+
+	std::sort( latencies.begin(), latencies.end() );
+	ConsolePrintf( "Push to start latency: median %.1fus p90 %.1fus max %.1fus\n",
+		latencies[ NUM_SAMPLES / 2 ], latencies[ NUM_SAMPLES * 9 / 10 ], latencies[ NUM_SAMPLES - 1 ] );
+}
+//---------------------------------------
+// Many small jobs pushed from the main thread
+static void TestExternalJobs()
+{
+	const int NUM_JOBS = 20000;
+	JobCounter counter;
+	gNumExecuted = 0;
+
+	double start = Clock::QueryTime( Clock::TIME_MICRO );
+	for ( int i = 0; i < NUM_JOBS; ++i )
+	{
+		WorkJob* job = new WorkJob;
+		job->SetCounter( &counter );
+		JobManager::GetInstance()->PushJob( job );
+	}
+	Finish( counter );
+
+	ConsolePrintf( "%d external jobs: %.2fms (%d ran)\n", NUM_JOBS, GetMS( start ), gNumExecuted );
+}
+//---------------------------------------
+// Jobs pushed from jobs go on the workers' own deques
+static void TestFanOut( int depth )
+{
+	JobCounter counter;
+	gNumExecuted = 0;
+
+	double start = Clock::QueryTime( Clock::TIME_MICRO );
+	JobManager::GetInstance()->PushJob( new TreeJob( depth, &counter ) );
+	Finish( counter );
+
+	ConsolePrintf( "%d job fan-out tree: %.2fms (%d ran)\n", ( 2 << depth ) - 1, GetMS( start ), gNumExecuted );
+}
+//---------------------------------------
+// Four stage pipelines pushed last stage first, each stage must run after the one before it
+static void TestPipelines()
+{
+	const int NUM_PIPELINES = 8;
+	const int NUM_STAGES = 4;
+	int order[ NUM_PIPELINES ][ NUM_STAGES ];
+	std::vector< Job* > jobs;
+	JobCounter counter;
+	gNumExecuted = 0;
+
+	for ( int p = 0; p < NUM_PIPELINES; ++p )
+	{
+		Job* prev = NULL;
+		for ( int s = 0; s < NUM_STAGES; ++s )
+		{
+			Job* stage = new StageJob( &order[p][s] );
+			stage->SetCounter( &counter );
+			if ( prev )
+			{
+				prev->Then( stage );
+			}
+			jobs.push_back( stage );
+			prev = stage;
+		}
+	}
+
+	double start = Clock::QueryTime( Clock::TIME_MICRO );
+	for ( int i = (int) jobs.size() - 1; i >= 0; --i )
+	{
+		JobManager::GetInstance()->PushJob( jobs[i] );
+	}
+	Finish( counter );
+
+	bool inOrder = true;
+	for ( int p = 0; p < NUM_PIPELINES; ++p )
+	{
+		for ( int s = 1; s < NUM_STAGES; ++s )
+		{
+			inOrder = inOrder && order[p][s - 1] < order[p][s];
+		}
+	}
+
+	ConsolePrintf( inOrder ? CONSOLE_INFO : CONSOLE_ERROR, "%d pipelines of %d stages: %.2fms, %s\n",
+		NUM_PIPELINES, NUM_STAGES, GetMS( start ), inOrder ? "in order" : "OUT OF ORDER" );
+}
+//---------------------------------------
+
+
+//---------------------------------------
+int main( int argc, char** argv )
+{
+	int numWorkers = argc > 1 ? atoi( argv[1] ) : 5;
+	int treeDepth = argc > 2 ? atoi( argv[2] ) : 10;
+
+	Clock::Initialize();
+	JobManager::CreateJobManager();
+	JobManager::GetInstance()->SetMaxWorkerThreads( numWorkers );
+	ConsolePrintf( "JobManager_Test : %d workers\n", JobManager::GetInstance()->GetCurrentNumberOfWorkers() );
+
+	// Give the workers time to start and go to sleep
+	Thread::Sleep( 300 );
+
+	TestLatency();
+	TestExternalJobs();
+	TestFanOut( treeDepth );
+	TestPipelines();
+
+	JobManager::DestroyJobManager();
+	return 0;
+}
+//---------------------------------------
@@ -20,12 +20,14 @@
 
 // Memory
 #include "MageMemory.h"
+#include "FrameAllocator.h"
 
 // IO
 #include "Console.h"
 
 #include "Dictionary.h"
 #include "CircularBuffer.h"
+#include "ObjectPool.h"
 #include "Event.h"
 #include "Clock.h"
 #include "ProfilingSystem.h"
@@ -40,7 +42,18 @@
 #include "CommandArgs.h"
 
 // Threads
+#include "Atomic.h"
+#include "LockFreeQueue.h"
 #include "Mutex.h"
+#include "RWLock.h"
+#include "Semaphore.h"
+#include "SpinLock.h"
 #include "Thread.h"
+#include "WorkStealingDeque.h"
 #include "Job.h"
-#include "JobManager.h"
\ No newline at end of file
+#include "JobManager.h"
+#include "ParallelFor.h"
+#include "Task.h"
+
+// Async IO
+#include "FileSystemAsync.h"
\ No newline at end of file
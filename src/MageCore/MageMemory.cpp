@@ -23,10 +23,12 @@ static uint8 PMA = 0;						// Pre-Main allocation count
 
 
 const uint32 MemoryPool::DefaultPoolSize      = 536870912U; // 512MB //1073741824U;	// 1GB (1GB caused out-of-memory issues sometimes)
-const uint8 MemoryPool::BlockSize             = sizeof( MemoryPool::Block );
+const uint8 MemoryPool::BlockSize             = ( sizeof( MemoryPool::Block ) + MemoryPool::ALIGNMENT - 1 ) & ~( MemoryPool::ALIGNMENT - 1 );
 uint8* MemoryPool::Pool                       = NULL;
 MemoryPool::Block* MemoryPool::Head           = NULL;
-MemoryPool::Block* MemoryPool::NextFree		  = NULL;
+uint32 MemoryPool::FreeListBitmap             = 0;
+uint32 MemoryPool::FreeListSubBitmaps[ FL_INDEX_COUNT ];
+MemoryPool::Block* MemoryPool::FreeLists[ FL_INDEX_COUNT ][ SL_INDEX_COUNT ];
 uint32 MemoryPool::BlocksAllocated            = 0;
 uint32 MemoryPool::BlocksFreed                = 0;
 uint32 MemoryPool::TotalAllocationRequests    = 0;
@@ -38,6 +40,113 @@ uint32 MemoryPool::BlocksByUsage[ MEMUSAGE_COUNT ];
 // For thread safety
 static Mutex gMemoryMutex;
 
+//---------------------------------------
+// TLSF free lists
+// Sizes of the first level bin, all smaller sizes are binned ALIGNMENT bytes apart
+static const uint32 SMALL_BLOCK_SIZE = 1 << MemoryPool::FL_INDEX_SHIFT;
+// Free blocks hold their free list links, so this is the least a block can be
+static const uint32 MIN_BLOCK_SIZE = 2 * sizeof( MemoryPool::Block* );
+// Largest request the bins can hold
+static const uint32 MAX_BLOCK_SIZE = ( 1U << ( MemoryPool::FL_INDEX_COUNT + MemoryPool::FL_INDEX_SHIFT - 1 ) ) - 1;
+
+// Links of a free block, kept in its memory
+struct FreeLinks
+{
+	MemoryPool::Block* Next;
+	MemoryPool::Block* Prev;
+};
+
+//---------------------------------------
+static FreeLinks& FreeLinksOf( MemoryPool::Block* b )
+{
+	return *(FreeLinks*) ( (uint8*) b + MemoryPool::BlockSize );
+}
+//---------------------------------------
+static uint32 AlignSize( size_t bytes )
+{
+	return ( (uint32) bytes + MemoryPool::ALIGNMENT - 1 ) & ~( MemoryPool::ALIGNMENT - 1 );
+}
+//---------------------------------------
+// Bin a free block of size bytes goes in
+static void MappingInsert( uint32 size, int& fl, int& sl )
+{
+	if ( size < SMALL_BLOCK_SIZE )
+	{
+		fl = 0;
+		sl = (int) ( size / ( SMALL_BLOCK_SIZE / MemoryPool::SL_INDEX_COUNT ) );
+	}
+	else
+	{
+		int bit = HighestBitSet( size );
+		sl = (int) ( size >> ( bit - MemoryPool::SL_INDEX_BITS ) ) ^ MemoryPool::SL_INDEX_COUNT;
+		fl = bit - MemoryPool::FL_INDEX_SHIFT + 1;
+	}
+}
+//---------------------------------------
+// First bin where every block holds at least size bytes
+static void MappingSearch( uint32 size, int& fl, int& sl )
+{
+	if ( size >= SMALL_BLOCK_SIZE )
+	{
+		size += ( 1U << ( HighestBitSet( size ) - MemoryPool::SL_INDEX_BITS ) ) - 1;
+	}
+	MappingInsert( size, fl, sl );
+}
+//---------------------------------------
+
+//---------------------------------------
+// Thread caches
+// Size classes are 16 bytes apart up to 128 bytes then 32 apart up to MAX_CACHED_SIZE
+static const int NUM_SIZE_CLASSES = 12;
+// Blocks moved between a cache and the pool at once
+static const uint32 CACHE_BATCH_SIZE = 32;
+// Free blocks a cache holds per size class before giving a batch back
+static const uint32 MAX_CACHED_BLOCKS = 2 * CACHE_BATCH_SIZE;
+
+struct MemoryPool::ThreadCache
+{
+	// Free blocks are kept by their memory, the first word of which links to the next
+	void* FreeLists[ NUM_SIZE_CLASSES ];
+	uint32 NumFree[ NUM_SIZE_CLASSES ];
+	// Blocks freed by other threads, pushed lock-free and taken all at once by the owner
+	void* volatile RemoteFrees;
+	// Caches of threads that have exited are kept for the next thread that needs one
+	ThreadCache* NextOrphan;
+};
+
+static THREAD_LOCAL MemoryPool::ThreadCache* gThreadCache = NULL;
+static MemoryPool::ThreadCache* gOrphanCaches = NULL;
+
+//---------------------------------------
+static int SizeClassOf( size_t bytes )
+{
+	return bytes <= 128 ? (int) ( ( bytes + 15 ) / 16 ) - 1 : 8 + (int) ( ( bytes - 129 ) / 32 );
+}
+//---------------------------------------
+// Largest class a block holding capacity bytes can serve, blocks from the pool may be bigger than asked
+static int SizeClassOfCapacity( uint32 capacity )
+{
+	if ( capacity >= MemoryPool::MAX_CACHED_SIZE ) return NUM_SIZE_CLASSES - 1;
+	if ( capacity >= 160 ) return 8 + (int) ( ( capacity - 160 ) / 32 );
+	return capacity >= 128 ? 7 : (int) ( capacity / 16 ) - 1;
+}
+//---------------------------------------
+static uint32 SizeOfClass( int sizeClass )
+{
+	return sizeClass < 8 ? 16 * ( sizeClass + 1 ) : 128 + 32 * ( sizeClass - 7 );
+}
+//---------------------------------------
+static MemoryPool::Block* BlockOf( void* memory )
+{
+	return (MemoryPool::Block*) ( (uint8*) memory - MemoryPool::BlockSize );
+}
+//---------------------------------------
+static void*& NextFreeOf( void* memory )
+{
+	return *(void**) memory;
+}
+//---------------------------------------
+
 //---------------------------------------
 bool MemoryPool::InitializeMemory()
 {
@@ -52,16 +161,25 @@ bool MemoryPool::InitializeMemory()
 			return false;
 		}
 
-		Head = (Block*) Pool;
-		Head->BlockSize = DefaultPoolSize - BlockSize;
+		// Headers are a multiple of ALIGNMENT, so blocks starting aligned keep every allocation aligned
+		uint8* start = (uint8*) ( ( (size_t) Pool + ALIGNMENT - 1 ) & ~(size_t) ( ALIGNMENT - 1 ) );
+		uint32 usable = (uint32) ( Pool + DefaultPoolSize - start ) & ~( ALIGNMENT - 1 );
+
+		Head = (Block*) start;
+		Head->BlockSize = usable - BlockSize;
 		Head->FileName = 0;
 		Head->LineNumber = 0;
 		Head->Free = true;
 		Head->UserType = 0;
 		Head->PrevBlock = NULL;
 		Head->NextBlock = NULL;
+		Head->Cache = NULL;
+		Head->Cached = false;
 
-		NextFree = Head;
+		FreeListBitmap = 0;
+		memset( FreeListSubBitmaps, 0, sizeof( FreeListSubBitmaps ) );
+		memset( FreeLists, 0, sizeof( FreeLists ) );
+		InsertFreeBlock( Head );
 
 		++BlocksFreed;
 
@@ -82,13 +200,15 @@ void MemoryPool::TerminateMemory()
 		// Don't free the pool while there is a pre-main allocation
 		if ( PMA > 0 ) return;
 
+		ReleaseThreadCache();
+
 		// Report memory leaks
 		Block* b = Head;
 		Block* n = NULL;
 
 		while ( b )
 		{
-			if ( !b->Free )
+			if ( !b->Free && !b->Cached )
 			{
 				OutputDebugMessage( "%s(%u): Memory leak : %s.\n",
 					b->FileName, b->LineNumber, ByteDisplay( b->BlockSize ).ToString() );
@@ -98,6 +218,14 @@ void MemoryPool::TerminateMemory()
 			b = b->NextBlock;
 		}
 
+		// Caches of exited threads, this one's included. Running threads keep theirs.
+		while ( gOrphanCaches )
+		{
+			ThreadCache* next = gOrphanCaches->NextOrphan;
+			free( gOrphanCaches );
+			gOrphanCaches = next;
+		}
+
 		// Free memory pool
 		free( Pool );
 		Pool = NULL;
@@ -115,178 +243,128 @@ void* MemoryPool::Allocate( size_t bytes )
 //---------------------------------------
 void* MemoryPool::Allocate( const char* filename, uint16 line, size_t bytes, uint8 usage )
 {
-	CriticalBlock( gMemoryMutex );
-
 	// No memory Pool
 	DebugAsssertion( Pool != NULL, "Allocate called before MemoryPool::Initialize()\n" );
 	if ( Pool == NULL ) return NULL;
 	// 0 byte allocation request
 	if ( bytes == 0 ) return NULL;
 
-	Block* b = NextFree;
-	Block* n = NULL;
+	// Small blocks come from this thread's cache without locking
+	if ( bytes <= MAX_CACHED_SIZE )
+	{
+		ThreadCache* cache = GetThreadCache();
+		void* memory = cache ? AllocateCached( cache, SizeClassOf( bytes ) ) : NULL;
+		if ( memory )
+		{
+			Block* b = BlockOf( memory );
+			b->FileName = filename;
+			b->LineNumber = line;
+			b->UserType = usage;
+			return memory;
+		}
+	}
+
+	void* memory;
 
-	// Just start at the head if the next free block won't fit
-	if ( b->BlockSize < bytes ) b = Head;
+	BeginCriticalSection( gMemoryMutex );
+	memory = AllocateBlock( filename, line, bytes, usage );
+	EndCriticalSection();
 
+	if ( memory == NULL )
+	{
+		throw std::bad_alloc( "Out of memory. Try increasing default memory pool size." );
+	}
+	return memory;
+}
+//---------------------------------------
+void* MemoryPool::AllocateBlock( const char* filename, uint16 line, size_t bytes, uint8 usage )
+{
 	// Stats
 	++TotalAllocationRequests;
 	AverageAllocationRequested = (uint32) ( ( 0.9f * AverageAllocationRequested ) + ( 0.1f * bytes ) );
 	if ( bytes > LargestAllocationRequest ) LargestAllocationRequest = bytes;
 
-	// Search the linked list for a good spot to allocate
-	// Layout:
-	// NULL
-	// Head
-	// Block1
-	// ...
-	// BlockN
-	// NULL
+	if ( bytes > MAX_BLOCK_SIZE ) return NULL;
 
-	while ( b )
+	uint32 size = AlignSize( bytes < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : bytes );
+	Block* b = FindFreeBlock( size );
+
+	// Out of memory
+	if ( b == NULL ) return NULL;
+
+	DebugAsssertion( b->Free && b->BlockSize >= size, "Free list is corrupt!\n" );
+	RemoveFreeBlock( b );
+
+	// Split off what we don't need if it can hold a block
+	// [ b    ]    [ b    ]
+	// | b    | -> [ rest ]
+	// | b    |    | rest |
+	if ( b->BlockSize >= size + BlockSize + MIN_BLOCK_SIZE )
 	{
-		// Found good block
-		if ( b->Free && b->BlockSize >= bytes )
-		{
-			DebugAsssertion( b->BlockSize <= DefaultPoolSize, "BlockSize is larger than Memory Pool!\n" );
+		Block* rest = (Block*) ( (uint8*) b + BlockSize + size );
 
-			uint32 lastSize = b->BlockSize;
-			BlocksByUsage[ b->UserType ]--;
-			b->BlockSize = bytes;
-			b->FileName = filename;
-			b->LineNumber = line;
-			b->Free = false;
-			b->UserType = usage;
-			b->PrevBlock = n;
+		// Assert block is in pool
+		DebugAsssertion( (uint8*) rest < ( Pool + DefaultPoolSize ), "Split overruns memory pool!\n" );
 
-			++BlocksAllocated;
-			--BlocksFreed;
-			TotalBytesAllocated += bytes;
-			BlocksByUsage[ usage ]++;
+		rest->BlockSize = b->BlockSize - size - BlockSize;
+		rest->FileName = 0;
+		rest->LineNumber = 0;
+		rest->Free = true;
+		rest->UserType = 0;
+		rest->PrevBlock = b;
+		rest->NextBlock = b->NextBlock;
+		rest->Cache = NULL;
+		rest->Cached = false;
 
-			Block* next = b->NextBlock;
+		if ( rest->NextBlock )
+			rest->NextBlock->PrevBlock = rest;
+		b->NextBlock = rest;
+		b->BlockSize = size;
 
-			// Next is tail block, create new tail block
-			// [ head ]    [ head ]
-			// [ .... ] -> | tail |
-			// [ tail ]    | tail |
-			if ( next == NULL )
-			{
-				const uint32 sizeOfNextBlock = lastSize - b->BlockSize;
-				b->NextBlock = (Block*) ( ( (uint8*) b ) + ( BlockSize + b->BlockSize ) );
-
-				// Assert block is in pool
-				DebugAsssertion( (uint8*) b->NextBlock > 0 && (uint8*) b->NextBlock < ( Pool + DefaultPoolSize ), "Tail overruns memory pool!\n" );
-
-				next = b->NextBlock;
-				next->BlockSize = sizeOfNextBlock - BlockSize;
-				next->FileName = 0;
-				next->LineNumber = 0;
-				next->Free = true;
-				next->UserType = 0;
-				next->PrevBlock = b;
-				next->NextBlock = NULL;
-
-				NextFree = next;
-
-				++BlocksFreed;
-				BlocksByUsage[ next->UserType ]++;
-				
-				// Assert tail was successful
-				DebugAsssertion( b->NextBlock->NextBlock == NULL, "Tail block is corrupt!\n" );
-			}
-			// Not tail block
-			else
-			{
-				// Next is free, merge blocks
-				// [ block ]    [ block ]
-				// [ ----  ] -> | free  |
-				// [ free  ]    | free  |
-				if ( next->Free )
-				{
-					b->NextBlock = (Block*) ( (uint8*) b + ( BlockSize + bytes ) );
-
-					Block* newNext = b->NextBlock;
-
-					// Assert block is in pool
-					DebugAsssertion( (uint8*) newNext > 0 && (uint8*) newNext < ( Pool + DefaultPoolSize ), "Bad merge in memory pool!\n" );
-
-					newNext->BlockSize = (uint8*) newNext + BlockSize - (uint8*) next + next->BlockSize;
-					newNext->FileName = 0;
-					newNext->LineNumber = 0;
-					newNext->Free = true;
-					newNext->UserType = 0;
-					newNext->PrevBlock = b;
-					newNext->NextBlock = next->NextBlock;
-
-					NextFree = newNext;
-
-					BlocksByUsage[ newNext->UserType ]++;
-				}
-				// Insert free block
-				// [ block ]    [ block ]
-				// [ ----  ] -> [ free  ]
-				// [ next  ]    [ next  ]
-				else
-				{
-					uint32 freespace = lastSize - b->BlockSize;
-
-					// A new block can be inserted between current and next
-					if ( freespace > BlockSize )
-					{
-						b->NextBlock = (Block*) ( ( (uint8*) b ) + ( BlockSize + b->BlockSize ) );
-						
-						Block* newNext = b->NextBlock;
-
-						// Assert block is in pool
-						DebugAsssertion( (uint8*) newNext > 0 && (uint8*) newNext < ( Pool + DefaultPoolSize ), "Bad insertion in memory pool!\n" );
-
-						newNext->BlockSize = freespace - BlockSize;
-						newNext->FileName = 0;
-						newNext->LineNumber = 0;
-						newNext->Free = true;
-						newNext->UserType = 0;
-						newNext->PrevBlock = b;
-						newNext->NextBlock = next;
-
-						NextFree = newNext;
-
-						++BlocksFreed;
-						BlocksByUsage[ newNext->UserType ]++;
-					}
-					// else Not enough memory (do nothing)
-				}
-			}
-			uint8* _ret = (uint8*) b + BlockSize;
-			// Assert block is in pool
-			DebugAsssertion( _ret > 0 && _ret < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
-			return _ret;
-		}
+		InsertFreeBlock( rest );
 
-		n = b;
-		b = b->NextBlock;
+		++BlocksFreed;
+		BlocksByUsage[ rest->UserType ]++;
 	}
 
-	throw std::bad_alloc( "Out of memory. Try increasing default memory pool size." );
-
-	// Not reachable but w/e
-	return NULL;
+	BlocksByUsage[ b->UserType ]--;
+	b->FileName = filename;
+	b->LineNumber = line;
+	b->Free = false;
+	b->UserType = usage;
+	b->Cache = NULL;
+	b->Cached = false;
+
+	++BlocksAllocated;
+	--BlocksFreed;
+	TotalBytesAllocated += b->BlockSize;
+	BlocksByUsage[ usage ]++;
+
+	return (uint8*) b + BlockSize;
 }
 //---------------------------------------
 void MemoryPool::Free( void* memory )
 {
-	CriticalBlock( gMemoryMutex );
-
 	// Do nothing if memory is null
 	if ( !memory ) return;
 	if ( !Pool ) return;
 
-	Block* b = (Block*) ( (uint8*) memory - BlockSize );
-	// Assert block is in pool
-	DebugAsssertion( (uint8*)b > 0 && (uint8*)b < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
+	Block* b = BlockOf( memory );
+	if ( b->Cache )
+	{
+		FreeCached( b );
+		return;
+	}
 
-	Block* prev = b->PrevBlock;
-	Block* next = b->NextBlock;
+	CriticalBlock( gMemoryMutex );
+	FreeBlock( b );
+}
+//---------------------------------------
+void MemoryPool::FreeBlock( Block* b )
+{
+	// Assert block is in pool
+	DebugAsssertion( (uint8*) b >= Pool && (uint8*) b < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
+	DebugAsssertion( !b->Free, "Block freed twice!\n" );
 
 	BlocksByUsage[ b->UserType ]--;
 	b->FileName = 0;
@@ -294,74 +372,109 @@ void MemoryPool::Free( void* memory )
 	b->Free = true;
 	b->UserType = 0;
 
-	NextFree = b;
-
 	// Stats!
 	++BlocksFreed;
 	--BlocksAllocated;
 	TotalBytesAllocated -= b->BlockSize;
 	BlocksByUsage[ b->UserType ]++;
 
-	// 3 way merge
-	// [ prev  ]    | prev |
-	// [ b     ] -> | prev |
-	// [ next  ]    | prev |
-	if ( prev && next && prev->Free && next->Free )
+	// Neighbours are never both free, so merging with each is enough to keep it that way
+	// Merge with next block
+	// [ b     ]    [ b    ]
+	// [ next  ] -> | b    |
+	Block* next = b->NextBlock;
+	if ( next && next->Free )
 	{
-		BlocksByUsage[ b->UserType ]--;
+		RemoveFreeBlock( next );
 		BlocksByUsage[ next->UserType ]--;
 
-		prev->NextBlock = next->NextBlock;
-		if ( next->NextBlock )
-			next->NextBlock->PrevBlock = prev;
-		prev->BlockSize = prev->BlockSize + next->BlockSize + b->BlockSize + 2 * BlockSize;
-
-		NextFree = prev;
-
-		// Assert block is in pool
-		DebugAsssertion( (uint8*)prev > 0 && (uint8*)prev < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
+		b->BlockSize = b->BlockSize + BlockSize + next->BlockSize;
+		b->NextBlock = next->NextBlock;
+		if ( b->NextBlock )
+			b->NextBlock->PrevBlock = b;
 
-		BlocksFreed -= 2;
+		--BlocksFreed;
 	}
-	else
+
 	// Merge with previous block
-	// [ prev  ]    | prev |
+	// [ prev  ]    [ prev ]
 	// [ b     ] -> | prev |
-	// [ next  ]    [ next ]
+	Block* prev = b->PrevBlock;
 	if ( prev && prev->Free )
 	{
+		RemoveFreeBlock( prev );
 		BlocksByUsage[ b->UserType ]--;
-		
-		prev->BlockSize = prev->BlockSize + BlockSize + b->BlockSize;
-		prev->NextBlock = next;
-		next->PrevBlock = prev;
-
-		NextFree = prev;
 
-		// Assert block is in pool
-		DebugAsssertion( (uint8*)prev > 0 && (uint8*)prev < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
+		prev->BlockSize = prev->BlockSize + BlockSize + b->BlockSize;
+		prev->NextBlock = b->NextBlock;
+		if ( prev->NextBlock )
+			prev->NextBlock->PrevBlock = prev;
 
+		b = prev;
 		--BlocksFreed;
 	}
+
+	InsertFreeBlock( b );
+}
+//---------------------------------------
+void MemoryPool::InsertFreeBlock( Block* b )
+{
+	int fl, sl;
+	MappingInsert( b->BlockSize, fl, sl );
+
+	FreeLinks& links = FreeLinksOf( b );
+	links.Prev = NULL;
+	links.Next = FreeLists[ fl ][ sl ];
+	if ( links.Next )
+		FreeLinksOf( links.Next ).Prev = b;
+	FreeLists[ fl ][ sl ] = b;
+
+	FreeListBitmap |= 1U << fl;
+	FreeListSubBitmaps[ fl ] |= 1U << sl;
+}
+//---------------------------------------
+void MemoryPool::RemoveFreeBlock( Block* b )
+{
+	int fl, sl;
+	MappingInsert( b->BlockSize, fl, sl );
+
+	FreeLinks& links = FreeLinksOf( b );
+	if ( links.Next )
+		FreeLinksOf( links.Next ).Prev = links.Prev;
+	if ( links.Prev )
+		FreeLinksOf( links.Prev ).Next = links.Next;
 	else
-	// Merge with next block
-	// [ prev  ]    [ prev ]
-	// [ b     ] -> | b    |
-	// [ next  ]    | b    |
-	if ( next && next->Free )
-	{
-		BlocksByUsage[ next->UserType ]--;
+		FreeLists[ fl ][ sl ] = links.Next;
 
-		b->BlockSize = b->BlockSize + BlockSize + next->BlockSize;
-		b->NextBlock = next->NextBlock;
-		if ( b->NextBlock )
-			b->NextBlock->PrevBlock = b;
+	// Bin is empty
+	if ( FreeLists[ fl ][ sl ] == NULL )
+	{
+		FreeListSubBitmaps[ fl ] &= ~( 1U << sl );
+		if ( FreeListSubBitmaps[ fl ] == 0 )
+			FreeListBitmap &= ~( 1U << fl );
+	}
+}
+//---------------------------------------
+MemoryPool::Block* MemoryPool::FindFreeBlock( uint32 size )
+{
+	int fl, sl;
+	MappingSearch( size, fl, sl );
+	if ( fl >= FL_INDEX_COUNT ) return NULL;
 
-		// Assert block is in pool
-		DebugAsssertion( (uint8*)b > 0 && (uint8*)b < ( Pool + DefaultPoolSize ), "Access violation in memory pool!\n" );
+	// A bin at this level at least as big
+	uint32 slMap = FreeListSubBitmaps[ fl ] & ( ~0U << sl );
+	if ( slMap == 0 )
+	{
+		// Otherwise the smallest bin of a bigger level
+		uint32 flMap = FreeListBitmap & ( ~0U << ( fl + 1 ) );
+		if ( flMap == 0 ) return NULL;
 
-		--BlocksFreed;
+		fl = LowestBitSet( flMap );
+		slMap = FreeListSubBitmaps[ fl ];
 	}
+	sl = LowestBitSet( slMap );
+
+	return FreeLists[ fl ][ sl ];
 }
 //---------------------------------------
 void MemoryPool::Free( void* memory, const char*, uint16 )
@@ -369,6 +482,161 @@ void MemoryPool::Free( void* memory, const char*, uint16 )
 	Free( memory );
 }
 //---------------------------------------
+void MemoryPool::ReleaseThreadCache()
+{
+	ThreadCache* cache = gThreadCache;
+	if ( !cache ) return;
+
+	gThreadCache = NULL;
+	ReclaimRemoteFrees( cache );
+
+	CriticalBlock( gMemoryMutex );
+
+	for ( int i = 0; i < NUM_SIZE_CLASSES; ++i )
+	{
+		DrainCache( cache, i, cache->NumFree[i] );
+	}
+
+	// Blocks this thread handed out are still owned by the cache and may be freed later
+	cache->NextOrphan = gOrphanCaches;
+	gOrphanCaches = cache;
+}
+//---------------------------------------
+MemoryPool::ThreadCache* MemoryPool::GetThreadCache()
+{
+	if ( gThreadCache )
+	{
+		return gThreadCache;
+	}
+
+	CriticalBlock( gMemoryMutex );
+
+	// Take over a cache from a thread that has exited, or make one. Not from the pool, we are the pool.
+	ThreadCache* cache = gOrphanCaches;
+	if ( cache )
+	{
+		gOrphanCaches = cache->NextOrphan;
+	}
+	else
+	{
+		cache = (ThreadCache*) malloc( sizeof( ThreadCache ) );
+		if ( !cache ) return NULL;
+		memset( cache, 0, sizeof( ThreadCache ) );
+	}
+
+	cache->NextOrphan = NULL;
+	gThreadCache = cache;
+	return cache;
+}
+//---------------------------------------
+void* MemoryPool::AllocateCached( ThreadCache* cache, int sizeClass )
+{
+	if ( !cache->FreeLists[ sizeClass ] )
+	{
+		ReclaimRemoteFrees( cache );
+		if ( !cache->FreeLists[ sizeClass ] )
+		{
+			RefillCache( cache, sizeClass );
+			if ( !cache->FreeLists[ sizeClass ] ) return NULL;
+		}
+	}
+
+	void* memory = cache->FreeLists[ sizeClass ];
+	cache->FreeLists[ sizeClass ] = NextFreeOf( memory );
+	--cache->NumFree[ sizeClass ];
+
+	BlockOf( memory )->Cached = false;
+	return memory;
+}
+//---------------------------------------
+void MemoryPool::FreeCached( Block* b )
+{
+	void* memory = (uint8*) b + BlockSize;
+	ThreadCache* cache = b->Cache;
+
+	b->FileName = 0;
+	b->LineNumber = 0;
+	b->UserType = MEMUSAGE_GENERAL;
+	b->Cached = true;
+
+	// Our own block, keep it for the next allocation
+	if ( cache == gThreadCache )
+	{
+		int sizeClass = SizeClassOfCapacity( b->BlockSize );
+		NextFreeOf( memory ) = cache->FreeLists[ sizeClass ];
+		cache->FreeLists[ sizeClass ] = memory;
+
+		if ( ++cache->NumFree[ sizeClass ] > MAX_CACHED_BLOCKS )
+		{
+			CriticalBlock( gMemoryMutex );
+			DrainCache( cache, sizeClass, CACHE_BATCH_SIZE );
+		}
+		return;
+	}
+
+	// Another thread's block, hand it back to that thread
+	void* head;
+	do
+	{
+		head = AtomicLoadAcquirePointer( &cache->RemoteFrees );
+		NextFreeOf( memory ) = head;
+	} while ( AtomicCompareExchangePointer( &cache->RemoteFrees, memory, head ) != head );
+}
+//---------------------------------------
+void MemoryPool::RefillCache( ThreadCache* cache, int sizeClass )
+{
+	uint32 size = SizeOfClass( sizeClass );
+
+	CriticalBlock( gMemoryMutex );
+
+	for ( uint32 i = 0; i < CACHE_BATCH_SIZE; ++i )
+	{
+		void* memory = AllocateBlock( NULL, 0, size, MEMUSAGE_GENERAL );
+		if ( !memory ) break;
+
+		Block* b = BlockOf( memory );
+		b->Cache = cache;
+		b->Cached = true;
+
+		NextFreeOf( memory ) = cache->FreeLists[ sizeClass ];
+		cache->FreeLists[ sizeClass ] = memory;
+		++cache->NumFree[ sizeClass ];
+	}
+}
+//---------------------------------------
+void MemoryPool::DrainCache( ThreadCache* cache, int sizeClass, uint32 count )
+{
+	while ( count-- > 0 && cache->FreeLists[ sizeClass ] )
+	{
+		void* memory = cache->FreeLists[ sizeClass ];
+		cache->FreeLists[ sizeClass ] = NextFreeOf( memory );
+		--cache->NumFree[ sizeClass ];
+
+		Block* b = BlockOf( memory );
+		b->Cache = NULL;
+		b->Cached = false;
+		FreeBlock( b );
+	}
+}
+//---------------------------------------
+void MemoryPool::ReclaimRemoteFrees( ThreadCache* cache )
+{
+	if ( !AtomicLoadAcquirePointer( &cache->RemoteFrees ) ) return;
+
+	void* memory = AtomicExchangePointer( &cache->RemoteFrees, NULL );
+	while ( memory )
+	{
+		void* next = NextFreeOf( memory );
+		int sizeClass = SizeClassOfCapacity( BlockOf( memory )->BlockSize );
+
+		NextFreeOf( memory ) = cache->FreeLists[ sizeClass ];
+		cache->FreeLists[ sizeClass ] = memory;
+		++cache->NumFree[ sizeClass ];
+
+		memory = next;
+	}
+}
+//---------------------------------------
 uint32 MemoryPool::GetFreeBlockCount()
 {
 	return BlocksFreed;
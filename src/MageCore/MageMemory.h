@@ -106,19 +106,40 @@ namespace mage
 
 
 	//---------------------------------------
+	// The pool is a TLSF (two level segregated fit) allocator. Free blocks are binned by the highest bit
+	// of their size, then by the next SL_INDEX_BITS bits, with bitmaps of which bins have blocks, so
+	// finding a block that fits takes a couple of bit scans however fragmented the pool is. Freed blocks
+	// merge with free neighbours right away. Allocations are ALIGNMENT byte aligned.
+	//
+	// Allocations of up to MAX_CACHED_SIZE bytes come from a per thread cache of blocks without taking
+	// the pool lock. Caches refill from and drain to the pool in batches. Blocks freed on another thread
+	// go back to the cache that handed them out. Cached blocks count as allocated in the pool stats.
 	class MemoryPool
 	{
 	public:
+		struct ThreadCache;
+
 		struct Block 
 		{
-			Block* PrevBlock;			// 4
-			Block* NextBlock;			// 4
-			uint32 BlockSize;			// 4
-			const char* FileName;		// 4
-			uint16 LineNumber;			// 2
-			bool Free;					// 1
-			uint8 UserType;				// 1
-		}; // 20 bytes
+			Block* PrevBlock;			// Block before this one in memory, NULL for Head
+			Block* NextBlock;			// Block after this one in memory, NULL for the last
+			uint32 BlockSize;			// Usable bytes after the header, a multiple of ALIGNMENT
+			const char* FileName;
+			uint16 LineNumber;
+			bool Free;
+			uint8 UserType;
+			ThreadCache* Cache;			// Cache that owns this block, NULL if it isn't a cached block
+			bool Cached;				// Waiting in a cache to be handed out again
+		}; // Padded to a multiple of ALIGNMENT, see BlockSize
+
+		static const uint32 ALIGNMENT = 16;
+		static const uint32 MAX_CACHED_SIZE = 256;
+		static const int SL_INDEX_BITS = 4;
+		static const int SL_INDEX_COUNT = 1 << SL_INDEX_BITS;
+		// Sizes below 1 << FL_INDEX_SHIFT share the first level, ALIGNMENT bytes apart
+		static const int FL_INDEX_SHIFT = 8;
+		// Enough for blocks under 2GB
+		static const int FL_INDEX_COUNT = 24;
 
 		// Only ever call this once
 		static bool InitializeMemory();
@@ -128,6 +149,8 @@ namespace mage
 		static void* Allocate( const char* filename, uint16 line, size_t bytes, uint8 usage=MEMUSAGE_GENERAL );
 		static void Free( void* memory );
 		static void Free( void* memory, const char*, uint16 );
+		// Give the calling thread's cached blocks back to the pool. Threads do this as they exit.
+		static void ReleaseThreadCache();
 
 		// Statistical info
 		static uint32 GetFreeBlockCount();
@@ -139,10 +162,12 @@ namespace mage
 
 //	private:	// Public for now... easier to display debug info
 		static const uint32 DefaultPoolSize;
-		static const uint8 BlockSize;
+		static const uint8 BlockSize;					// Header size
 		static uint8* Pool;
-		static Block* Head;								// (Block*) Pool
-		static Block* NextFree;							// Last free block encountered
+		static Block* Head;								// First block, Pool rounded up to ALIGNMENT
+		static uint32 FreeListBitmap;					// Bit per first level with free blocks
+		static uint32 FreeListSubBitmaps[ FL_INDEX_COUNT ];			// Bit per second level with free blocks
+		static Block* FreeLists[ FL_INDEX_COUNT ][ SL_INDEX_COUNT ];
 		static uint32 BlocksAllocated;					// Total allocated block count
 		static uint32 BlocksFreed;
 		static uint32 BlocksByUsage[ MEMUSAGE_COUNT ];	// Blocks by usage tag
@@ -150,6 +175,24 @@ namespace mage
 		static uint32 TotalBytesAllocated;
 		static uint32 LargestAllocationRequest;
 		static uint32 AverageAllocationRequested;		// Running average
+
+	private:
+		// Pool operations, gMemoryMutex must be held. Returns NULL when the pool is out of memory.
+		static void* AllocateBlock( const char* filename, uint16 line, size_t bytes, uint8 usage );
+		static void FreeBlock( Block* b );
+		static void InsertFreeBlock( Block* b );
+		static void RemoveFreeBlock( Block* b );
+		// Free block of at least size bytes, from the first bin whose blocks are all big enough
+		static Block* FindFreeBlock( uint32 size );
+
+		static ThreadCache* GetThreadCache();
+		static void* AllocateCached( ThreadCache* cache, int sizeClass );
+		static void FreeCached( Block* b );
+		static void RefillCache( ThreadCache* cache, int sizeClass );
+		// Return count blocks of sizeClass to the pool, gMemoryMutex must be held
+		static void DrainCache( ThreadCache* cache, int sizeClass, uint32 count );
+		// Move blocks other threads freed onto the cache's own lists
+		static void ReclaimRemoteFrees( ThreadCache* cache );
 	};
 
 }
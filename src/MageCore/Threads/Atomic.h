@@ -0,0 +1,170 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Atomic operations on 32 bit integers and pointers for lock-free code.
+ *   Read-modify-write operations are full barriers and return the new value,
+ *   except Exchange and CompareExchange which return the previous value.
+ */
+
+#pragma once
+
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif
+
+namespace mage
+{
+
+	// Keep data written by different threads this far apart to avoid false sharing
+	static const int CACHE_LINE_SIZE = 64;
+
+#ifdef _MSC_VER
+
+	//---------------------------------------
+	inline int32 AtomicIncrement( volatile int32* value )
+	{
+		return _InterlockedIncrement( (volatile long*) value );
+	}
+	//---------------------------------------
+	inline int32 AtomicDecrement( volatile int32* value )
+	{
+		return _InterlockedDecrement( (volatile long*) value );
+	}
+	//---------------------------------------
+	inline int32 AtomicAdd( volatile int32* value, int32 amount )
+	{
+		return _InterlockedExchangeAdd( (volatile long*) value, amount ) + amount;
+	}
+	//---------------------------------------
+	inline int32 AtomicExchange( volatile int32* value, int32 newValue )
+	{
+		return _InterlockedExchange( (volatile long*) value, newValue );
+	}
+	//---------------------------------------
+	// Set value to newValue if it equals expected
+	inline int32 AtomicCompareExchange( volatile int32* value, int32 newValue, int32 expected )
+	{
+		return _InterlockedCompareExchange( (volatile long*) value, newValue, expected );
+	}
+	//---------------------------------------
+	// Reads and writes after this can't move before it
+	inline int32 AtomicLoadAcquire( const volatile int32* value )
+	{
+		int32 v = *value;
+		_ReadWriteBarrier();
+		return v;
+	}
+	//---------------------------------------
+	// Reads and writes before this can't move after it
+	inline void AtomicStoreRelease( volatile int32* value, int32 newValue )
+	{
+		_ReadWriteBarrier();
+		*value = newValue;
+	}
+	//---------------------------------------
+	// No reads or writes move across this, including a later read passing an earlier write
+	inline void AtomicThreadFence()
+	{
+		_ReadWriteBarrier();
+		_mm_mfence();
+		_ReadWriteBarrier();
+	}
+	//---------------------------------------
+	inline void* AtomicLoadAcquirePointer( void* const volatile* target )
+	{
+		void* v = *target;
+		_ReadWriteBarrier();
+		return v;
+	}
+	//---------------------------------------
+	inline void* AtomicExchangePointer( void* volatile* target, void* newValue )
+	{
+		return _InterlockedExchangePointer( target, newValue );
+	}
+	//---------------------------------------
+	inline void* AtomicCompareExchangePointer( void* volatile* target, void* newValue, void* expected )
+	{
+		return _InterlockedCompareExchangePointer( target, newValue, expected );
+	}
+	//---------------------------------------
+	// Call in spin loops, lets the other hyper-thread on the core run and eases the exit from the loop
+	inline void CpuPause()
+	{
+		_mm_pause();
+	}
+	//---------------------------------------
+
+#else
+
+	//---------------------------------------
+	inline int32 AtomicIncrement( volatile int32* value )
+	{
+		return __atomic_add_fetch( value, 1, __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline int32 AtomicDecrement( volatile int32* value )
+	{
+		return __atomic_sub_fetch( value, 1, __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline int32 AtomicAdd( volatile int32* value, int32 amount )
+	{
+		return __atomic_add_fetch( value, amount, __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline int32 AtomicExchange( volatile int32* value, int32 newValue )
+	{
+		return __atomic_exchange_n( value, newValue, __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline int32 AtomicCompareExchange( volatile int32* value, int32 newValue, int32 expected )
+	{
+		__atomic_compare_exchange_n( value, &expected, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+		return expected;
+	}
+	//---------------------------------------
+	inline int32 AtomicLoadAcquire( const volatile int32* value )
+	{
+		return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+	}
+	//---------------------------------------
+	inline void AtomicStoreRelease( volatile int32* value, int32 newValue )
+	{
+		__atomic_store_n( value, newValue, __ATOMIC_RELEASE );
+	}
+	//---------------------------------------
+	inline void AtomicThreadFence()
+	{
+		__atomic_thread_fence( __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline void* AtomicLoadAcquirePointer( void* const volatile* target )
+	{
+		return __atomic_load_n( target, __ATOMIC_ACQUIRE );
+	}
+	//---------------------------------------
+	inline void* AtomicExchangePointer( void* volatile* target, void* newValue )
+	{
+		return __atomic_exchange_n( target, newValue, __ATOMIC_SEQ_CST );
+	}
+	//---------------------------------------
+	inline void* AtomicCompareExchangePointer( void* volatile* target, void* newValue, void* expected )
+	{
+		__atomic_compare_exchange_n( target, &expected, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST );
+		return expected;
+	}
+	//---------------------------------------
+	inline void CpuPause()
+	{
+#	if defined( __i386__ ) || defined( __x86_64__ )
+		__builtin_ia32_pause();
+#	elif defined( __aarch64__ )
+		__asm__ __volatile__( "yield" );
+#	endif
+	}
+	//---------------------------------------
+
+#endif
+
+}
@@ -6,8 +6,24 @@ using namespace mage;
 Job::Job( JobPriority priority, JobType jobType )
 	: mPriority( priority )
 	, mJobType( jobType )
+	, mDependencies( 1 )
+	, mCounter( NULL )
+	, mPushed( false )
+	, mCallerOwned( false )
 {}
 //---------------------------------------
 Job::~Job()
 {}
+//---------------------------------------
+void Job::AddDependency( Job* prerequisite )
+{
+	if ( prerequisite->mPushed )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "Job : Dependency added after the prerequisite was pushed, ignoring it\n" );
+		return;
+	}
+
+	AtomicIncrement( &mDependencies );
+	prerequisite->mContinuations.push_back( this );
+}
 //---------------------------------------
\ No newline at end of file
@@ -10,6 +10,27 @@
 namespace mage
 {
 
+	//---------------------------------------
+	// Number of jobs pushed with it that haven't finished, see Job::SetCounter and JobManager::Wait
+	class JobCounter
+	{
+	public:
+		JobCounter() : mCount( 0 ) {}
+
+		bool IsDone() const					{ return AtomicLoadAcquire( &mCount ) == 0; }
+
+		// Count work that isn't a pushed job. Each Increment needs a Decrement once that work is finished.
+		void Increment()					{ AtomicIncrement( &mCount ); }
+		void Decrement()					{ AtomicDecrement( &mCount ); }
+
+	private:
+		friend class JobManager;
+		volatile int32 mCount;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
 	class Job
 	{
 	public:
@@ -21,7 +42,8 @@ namespace mage
 			JP_AVERAGE,
 			JP_ABOVE_AVERAGE,
 			JP_HIGH,
-			JP_HIGHEST
+			JP_HIGHEST,
+			JP_COUNT
 		};
 
 		enum JobType
@@ -34,9 +56,23 @@ namespace mage
 		Job( JobPriority priority=JP_AVERAGE, JobType jobType=JOB_GENERIC );
 		virtual ~Job();
 
+		// Runs on a worker
 		virtual void OnExecute() = 0;
+		// Runs on the main thread from JobManager::OnUpdate, after which the job is deleted
 		virtual void OnCompletetion() = 0;
 
+		// Don't start this job until prerequisite has executed. Call before either job is pushed.
+		// A job with dependencies can be pushed right away, it is held until they finish.
+		void AddDependency( Job* prerequisite );
+		// Start next on a worker the moment this job has executed. Returns next to chain:
+		//  load->Then( decompress )->Then( parse );
+		Job* Then( Job* next )				{ next->AddDependency( this ); return next; }
+		// counter counts this job from when it is pushed until it has executed
+		void SetCounter( JobCounter* counter )	{ mCounter = counter; }
+		// Caller owned jobs are not deleted and get no OnCompletetion. The owner keeps the job alive
+		// until its counter says it has executed, so jobs can live on the stack.
+		void SetCallerOwned( bool callerOwned )	{ mCallerOwned = callerOwned; }
+
 		JobType     GetJobType()     const { return mJobType;  }
 		JobPriority GetJobPriority() const { return mPriority; }
 
@@ -48,6 +84,16 @@ namespace mage
 	protected:
 		JobPriority mPriority;
 		JobType mJobType;
+
+	private:
+		friend class JobManager;
+
+		volatile int32 mDependencies;		// Unfinished prerequisites, plus one until pushed
+		std::vector< Job* > mContinuations;	// Jobs waiting on this one
+		JobCounter* mCounter;
+		bool mPushed;
+		bool mCallerOwned;
 	};
+	//---------------------------------------
 
 }
\ No newline at end of file
@@ -4,6 +4,7 @@ using namespace mage;
 
 //---------------------------------------
 JobManager* JobManager::msJobManager;
+THREAD_LOCAL JobManager::Worker* JobManager::msCurrentWorker = NULL;
 //---------------------------------------
 void JobManager::CreateJobManager()
 {
@@ -35,30 +36,35 @@ void JobManager::_worker_function( void* pWorker )
 	Worker* worker = (Worker*) pWorker;
 	JobManager* jobManager = JobManager::GetInstance();
 
+	msCurrentWorker = worker;
+
 	while ( worker->Alive )
 	{
-		// Try to get a job
-		worker->CurrentJob = jobManager->AquireNextJob( worker->MyPerferedJobType );
-		
-		// Wait a bit before trying to get another job
-		if ( !worker->CurrentJob )
-		{
-			Thread::Sleep( 100 );
-		}
-		else
+		// Get a job, sleeping until one is pushed
+		worker->CurrentJob = jobManager->WaitForJob( worker );
+
+		if ( worker->CurrentJob )
 		{
-			worker->CurrentJob->OnExecute();
-			jobManager->SubmitCompletedJob( worker->CurrentJob );
+			jobManager->ExecuteJob( worker->CurrentJob );
+			worker->CurrentJob = NULL;
 		}
 	}
 
-	delete worker;
+	// Hand anything left on our deque to the remaining workers
+	msCurrentWorker = NULL;
+
+	Job* job;
+	while ( jobManager->mLocalQueues[ worker->Index ].Pop( job ) )
+	{
+		jobManager->ScheduleJob( job );
+	}
 }
 //---------------------------------------
 
 
 //---------------------------------------
 JobManager::JobManager()
+	: mNumLocalQueues( 0 )
 {
 	mMaxNumberOfWorkers = 0;//Thread::GetMaxThreadConcurrency();
 
@@ -70,27 +76,41 @@ JobManager::JobManager()
 	{
 		ConsolePrintf( CONSOLE_INFO, "JobManager : Max concurrent threads is %d.\n", mMaxNumberOfWorkers );
 	}
+
+	mLocalQueues = new WorkStealingDeque< Job* >[ MAX_WORKERS ];
+	for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
+	{
+		mNumPendingJobs[i] = 0;
+		mNumSleeping[i] = 0;
+	}
 }
 //---------------------------------------
 JobManager::~JobManager()
 {
 	DestroyAllWorkers();
+	delete[] mLocalQueues;
 }
 //---------------------------------------
 void JobManager::Initialize()
 {
-	if ( mMaxNumberOfWorkers > 0 )
-	{
-		for ( unsigned int i = 0; i < mMaxNumberOfWorkers; ++i )
-		{
-			Worker* worker = new Worker;
-			worker->MyThread = new Thread( _worker_function, (void*) worker );
-			mWorkers.push_back( worker );
-		}
+	SetMaxWorkerThreads( mMaxNumberOfWorkers );
+}
+//---------------------------------------
+JobManager::Worker* JobManager::CreateWorker( int index, Job::JobType jobType )
+{
+	Worker* worker = new Worker;
+	worker->Index = index;
+	worker->MyPerferedJobType = jobType;
+	worker->StealSeed = 2654435761u * ( index + 1 );
 
-		// Set the last work to do file I/O for now...
-		mWorkers.back()->MyPerferedJobType = Job::JOB_FILE_IO;
+	if ( index >= mNumLocalQueues )
+	{
+		AtomicStoreRelease( &mNumLocalQueues, index + 1 );
 	}
+
+	worker->MyThread = new Thread( _worker_function, (void*) worker );
+	worker->MyThread->SetName( jobType == Job::JOB_FILE_IO ? "Job File IO" : "Job Worker" );
+	return worker;
 }
 //---------------------------------------
 void JobManager::OnUpdate()
@@ -105,30 +125,18 @@ void JobManager::OnUpdate()
 		++nextType;
 		if ( nextType >= Job::JOB_TYPE_COUNT ) nextType = 0;
 
-		if ( !mPendingJobQueue[ nextType ].empty() )
-		{
-			job = mPendingJobQueue[ nextType ].back();
-			mPendingJobQueue[ nextType ].pop_back();
-		}
+		job = AquireNextJob( (Job::JobType) nextType );
+
 		// There was not job of the next 'even' type, look for another job of any type
-		else
+		for ( int i = 0; i < Job::JOB_TYPE_COUNT && !job; ++i )
 		{
-			for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
-			{
-				if ( !mPendingJobQueue[ i ].empty() )
-				{
-					job = mPendingJobQueue[ i ].back();
-					mPendingJobQueue[ i ].pop_back();
-					break;
-				}
-			}
+			job = AquireNextJob( (Job::JobType) i );
 		}
 
 		// Execute job if there is one
 		if ( job )
 		{
-			job->OnExecute();
-			SubmitCompletedJob( job );
+			ExecuteJob( job );
 		}
 	}
 
@@ -137,8 +145,7 @@ void JobManager::OnUpdate()
 
 	BeginCriticalSection( mJobCompleteMutex );
 	
-	completedJobs = mCompletedJobList;
-	mCompletedJobList.clear();
+	completedJobs.swap( mCompletedJobList );
 	
 	EndCriticalSection();
 
@@ -151,24 +158,146 @@ void JobManager::OnUpdate()
 //---------------------------------------
 void JobManager::PushJob( Job* job )
 {
-	CriticalBlock( mJobQueueMutex );
+	job->mPushed = true;
+	if ( job->mCounter )
+	{
+		AtomicIncrement( &job->mCounter->mCount );
+	}
 
-	// Add new job
-	mPendingJobQueue[ job->GetJobType() ].push_front( job );
-	// Sort on priority
-	mPendingJobQueue[ job->GetJobType() ].sort( [&]( const Job* jobA, const Job* jobB ) -> bool
+	// Drop the hold taken at construction. If prerequisites are still running the last one to finish schedules it.
+	if ( AtomicDecrement( &job->mDependencies ) == 0 )
 	{
-		return *jobA < *jobB;
-	});
+		ScheduleJob( job );
+	}
 }
 //---------------------------------------
-void JobManager::DestroyAllWorkers()
+void JobManager::ScheduleJob( Job* job )
+{
+	Job::JobType jobType = job->GetJobType();
+	Worker* worker = msCurrentWorker;
+
+	// Jobs made by a generic worker stay on its own deque
+	if ( worker && worker->MyPerferedJobType == Job::JOB_GENERIC && jobType == Job::JOB_GENERIC
+		&& mLocalQueues[ worker->Index ].Push( job ) )
+	{
+		WakeWorker( jobType );
+		return;
+	}
+
+	BeginCriticalSection( mJobQueueMutex );
+
+	mPendingJobQueue[ jobType ][ job->GetJobPriority() ].push_back( job );
+	AtomicIncrement( &mNumPendingJobs[ jobType ] );
+
+	EndCriticalSection();
+
+	WakeWorker( jobType );
+}
+//---------------------------------------
+void JobManager::ExecuteJob( Job* job )
 {
-	for ( auto itr = mWorkers.begin(); itr != mWorkers.end(); ++itr )
+	job->OnExecute();
+
+	// Continuations start now instead of waiting for OnUpdate
+	for ( unsigned int i = 0; i < job->mContinuations.size(); ++i )
+	{
+		Job* next = job->mContinuations[i];
+		if ( AtomicDecrement( &next->mDependencies ) == 0 )
+		{
+			ScheduleJob( next );
+		}
+	}
+
+	// A caller owned job may be gone as soon as its counter drops
+	bool callerOwned = job->mCallerOwned;
+	if ( job->mCounter )
+	{
+		AtomicDecrement( &job->mCounter->mCount );
+	}
+
+	if ( !callerOwned )
+	{
+		SubmitCompletedJob( job );
+	}
+}
+//---------------------------------------
+void JobManager::Wait( const JobCounter& counter )
+{
+	Worker* worker = msCurrentWorker;
+	uint32 stealSeed = (uint32) (size_t) &counter | 1;
+
+	while ( !counter.IsDone() )
+	{
+		Job* job = worker ? FindJob( worker ) : FindJobToHelp( stealSeed );
+		if ( job )
+		{
+			ExecuteJob( job );
+		}
+		else
+		{
+			// What's left is running on other threads
+			Thread::Sleep( 0 );
+		}
+	}
+}
+//---------------------------------------
+void JobManager::WakeWorker( Job::JobType jobType )
+{
+	// The job must be visible before we look for sleepers, pairs with the increment in WaitForJob
+	AtomicThreadFence();
+	if ( AtomicLoadAcquire( &mNumSleeping[ jobType ] ) > 0 )
+	{
+		mWakeSignal[ jobType ].Signal();
+		return;
+	}
+
+	// Only the file I/O worker runs file I/O
+	if ( jobType == Job::JOB_FILE_IO )
+	{
+		return;
+	}
+
+	// Nobody of that type is idle, any sleeping worker will take it
+	for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
+	{
+		if ( i != jobType && AtomicLoadAcquire( &mNumSleeping[ i ] ) > 0 )
+		{
+			mWakeSignal[ i ].Signal();
+			return;
+		}
+	}
+}
+//---------------------------------------
+void JobManager::DestroyWorkers( unsigned int index )
+{
+	if ( index >= mWorkers.size() )
+	{
+		return;
+	}
+
+	for ( unsigned int i = index; i < mWorkers.size(); ++i )
 	{
-		(*itr)->Alive = false;
+		mWorkers[ i ]->Alive = false;
 	}
-	mWorkers.clear();
+
+	// Wake everyone, workers that aren't stopping go back to sleep
+	for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
+	{
+		mWakeSignal[ i ].Signal( (int) mWorkers.size() );
+	}
+
+	for ( unsigned int i = index; i < mWorkers.size(); ++i )
+	{
+		mWorkers[ i ]->MyThread->Join();
+		delete mWorkers[ i ]->MyThread;
+		delete mWorkers[ i ];
+	}
+	mWorkers.resize( index );
+}
+//---------------------------------------
+void JobManager::DestroyAllWorkers()
+{
+	DestroyWorkers( 0 );
 }
 //---------------------------------------
 void JobManager::DestroyAllPendingJobs()
@@ -177,11 +306,11 @@ void JobManager::DestroyAllPendingJobs()
 
 	for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
 	{
-		while ( !mPendingJobQueue[ i ].empty() )
+		for ( int p = 0; p < Job::JP_COUNT; ++p )
 		{
-			delete mPendingJobQueue[ i ].back();
-			mPendingJobQueue[ i ].pop_back();
+			DestroyVector( mPendingJobQueue[ i ][ p ] );
 		}
+		AtomicExchange( &mNumPendingJobs[ i ], 0 );
 	}
 }
 //---------------------------------------
@@ -189,61 +318,171 @@ void JobManager::DestroyAllPendingJobsOfType( Job::JobType jobType )
 {
 	CriticalBlock( mJobQueueMutex );
 
-	while ( !mPendingJobQueue[ jobType ].empty() )
+	for ( int p = 0; p < Job::JP_COUNT; ++p )
 	{
-		delete mPendingJobQueue[ jobType ].back();
-		mPendingJobQueue[ jobType ].pop_back();
+		DestroyVector( mPendingJobQueue[ jobType ][ p ] );
 	}
+	AtomicExchange( &mNumPendingJobs[ jobType ], 0 );
 }
 //---------------------------------------
 void JobManager::SetMaxWorkerThreads( int maxWorkers )
 {
-	mMaxNumberOfWorkers = maxWorkers;
+	if ( maxWorkers > MAX_WORKERS )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "JobManager : %d workers requested, limiting to %d.\n", maxWorkers, MAX_WORKERS );
+		maxWorkers = MAX_WORKERS;
+	}
+	mMaxNumberOfWorkers = maxWorkers > 0 ? maxWorkers : 0;
 
 	// Limit number of workers
 	if ( mWorkers.size() > mMaxNumberOfWorkers )
 	{
-		for ( unsigned int i = mMaxNumberOfWorkers; i < mWorkers.size(); ++i )
-		{
-			mWorkers[ i ]->Alive = false;
-		}
-		// Remove dead workers from the list
-		// Dead workers will free there own memory when their thread dies
-		mWorkers.erase( std::remove_if( mWorkers.begin(), mWorkers.end(), [&]( const Worker* worker ) -> bool
-		{
-			return worker->Alive;
-		}), mWorkers.end() );
+		DestroyWorkers( mMaxNumberOfWorkers );
 	}
 	// Make more workers
-	else if ( mWorkers.size() < mMaxNumberOfWorkers )
+	else
 	{
+		// The first worker does file I/O so one is always around.
+		// Idle workers of either type take the other's jobs.
 		for ( unsigned int i = mWorkers.size(); i < mMaxNumberOfWorkers; ++i )
 		{
-			Worker* worker = new Worker;
-			worker->MyThread = new Thread( _worker_function, (void*) worker );
-			mWorkers.push_back( worker );
+			mWorkers.push_back( CreateWorker( i, i == 0 ? Job::JOB_FILE_IO : Job::JOB_GENERIC ) );
 		}
-		// Hack to make sure a file IO worker is always around
-		// @TODO generic workers should take over file IO if no file IO work is available.
-		bool canLoadFiles = false;
-		for ( unsigned int i = mWorkers.size(); i < mMaxNumberOfWorkers; ++i )
+	}
+}
+//---------------------------------------
+int JobManager::GetCurrentNumberOfWorkers() const
+{
+	return mMaxNumberOfWorkers;
+}
+//---------------------------------------
+int JobManager::GetNumGenericWorkers() const
+{
+	return mMaxNumberOfWorkers > 1 ? mMaxNumberOfWorkers - 1 : 0;
+}
+//---------------------------------------
+Job* JobManager::FindJob( Worker* worker )
+{
+	Job* job = NULL;
+	Job::JobType jobType = worker->MyPerferedJobType;
+
+	// Newest job we made ourself
+	if ( jobType == Job::JOB_GENERIC && mLocalQueues[ worker->Index ].Pop( job ) )
+	{
+		return job;
+	}
+
+	// Jobs pushed from outside the workers
+	if ( AtomicLoadAcquire( &mNumPendingJobs[ jobType ] ) > 0 )
+	{
+		job = AquireNextJob( jobType );
+		if ( job )
+		{
+			return job;
+		}
+	}
+
+	// Oldest job another worker made
+	job = StealJob( worker->StealSeed, worker->Index );
+	if ( job )
+	{
+		return job;
+	}
+
+	// Nothing of our type anywhere, help with other types rather than sit idle.
+	// File I/O blocks, it stays on its own worker so generic workers never wait on it.
+	for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
+	{
+		if ( i != jobType && i != Job::JOB_FILE_IO && AtomicLoadAcquire( &mNumPendingJobs[ i ] ) > 0 )
 		{
-			if ( mWorkers[i]->MyPerferedJobType == Job::JOB_FILE_IO )
+			job = AquireNextJob( (Job::JobType) i );
+			if ( job )
 			{
-				canLoadFiles = true;
-				break;
+				return job;
 			}
 		}
-		if ( !canLoadFiles )
+	}
+	return NULL;
+}
+//---------------------------------------
+Job* JobManager::FindJobToHelp( uint32& stealSeed )
+{
+	Job* job = NULL;
+
+	// With no workers everything runs here
+	if ( mMaxNumberOfWorkers == 0 )
+	{
+		for ( int i = 0; i < Job::JOB_TYPE_COUNT && !job; ++i )
 		{
-			mWorkers.back()->MyPerferedJobType = Job::JOB_FILE_IO;
+			job = AquireNextJob( (Job::JobType) i );
 		}
+		return job;
 	}
+
+	// Leave file I/O to its worker
+	if ( AtomicLoadAcquire( &mNumPendingJobs[ Job::JOB_GENERIC ] ) > 0 )
+	{
+		job = AquireNextJob( Job::JOB_GENERIC );
+	}
+	return job ? job : StealJob( stealSeed, -1 );
 }
 //---------------------------------------
-int JobManager::GetCurrentNumberOfWorkers() const
+Job* JobManager::WaitForJob( Worker* worker )
 {
-	return mMaxNumberOfWorkers;
+	Job* job = FindJob( worker );
+	if ( job )
+	{
+		return job;
+	}
+
+	// Say we're going to sleep, then look once more. A job pushed in between either
+	// shows up here or its push sees us sleeping and wakes us.
+	Job::JobType jobType = worker->MyPerferedJobType;
+	AtomicIncrement( &mNumSleeping[ jobType ] );
+
+	job = FindJob( worker );
+	if ( !job && worker->Alive )
+	{
+		mWakeSignal[ jobType ].Wait();
+	}
+
+	AtomicDecrement( &mNumSleeping[ jobType ] );
+	return job;
+}
+//---------------------------------------
+Job* JobManager::StealJob( uint32& stealSeed, int thiefIndex )
+{
+	int numQueues = AtomicLoadAcquire( &mNumLocalQueues );
+	if ( numQueues == 0 )
+	{
+		return NULL;
+	}
+
+	// Start at a random worker so thieves spread out (xorshift)
+	uint32 x = stealSeed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	stealSeed = x;
+
+	Job* job;
+	int start = (int) ( x % numQueues );
+	for ( int i = 0; i < numQueues; ++i )
+	{
+		int victim = ( start + i ) % numQueues;
+		if ( victim == thiefIndex )
+			continue;
+
+		// A failed steal means another thread took the job, keep going while there are more
+		while ( !mLocalQueues[ victim ].IsEmpty() )
+		{
+			if ( mLocalQueues[ victim ].Steal( job ) )
+			{
+				return job;
+			}
+		}
+	}
+	return NULL;
 }
 //---------------------------------------
 Job* JobManager::AquireNextJob( Job::JobType requestedType )
@@ -252,27 +491,18 @@ Job* JobManager::AquireNextJob( Job::JobType requestedType )
 
 	BeginCriticalSection( mJobQueueMutex );
 
-	// Try to get the requested type of job
-	if ( !mPendingJobQueue[ requestedType ].empty() )
+	// Highest priority first, oldest first within a priority
+	for ( int p = Job::JP_COUNT - 1; p >= 0; --p )
 	{
-		job = mPendingJobQueue[ requestedType ].back();
-		mPendingJobQueue[ requestedType ].pop_back();
-		//ConsolePrintf( CONSOLE_INFO, "Job %d started!\n", requestedType );
-	}
-	// We have no jobs of that type, look for other jobs
-	// @TODO this will cause generic works to load files, which is generally not wanted.
-	/*else
-	{
-		for ( int i = 0; i < Job::JOB_TYPE_COUNT; ++i )
+		std::deque< Job* >& queue = mPendingJobQueue[ requestedType ][ p ];
+		if ( !queue.empty() )
 		{
-			if ( !mPendingJobQueue[ i ].empty() )
-			{
-				job = mPendingJobQueue[ i ].back();
-				mPendingJobQueue[ i ].pop_back();
-				break;
-			}
+			job = queue.front();
+			queue.pop_front();
+			AtomicDecrement( &mNumPendingJobs[ requestedType ] );
+			break;
 		}
-	}*/
+	}
 
 	EndCriticalSection();
 
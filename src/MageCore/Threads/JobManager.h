@@ -2,7 +2,14 @@
  * Author      : Matthew Johnson
  * Date        : 11/Jun/2013
  * Description :
- *   
+ *   Runs Jobs on a pool of worker threads.
+ *   Each generic worker owns a work stealing deque. Jobs pushed from a generic
+ *   worker go on its own deque and run there last in first out, unless an idle
+ *   worker steals them first. Jobs pushed from any other thread go through the
+ *   shared pending queues, highest priority first and in push order within a
+ *   priority. The file I/O worker runs generic jobs rather than sit idle, but
+ *   file I/O blocks and only ever runs on its own worker. Idle workers sleep on
+ *   a semaphore and are woken as soon as a job they can run is pushed.
  */
  
 #pragma once
@@ -18,11 +25,16 @@ namespace mage
 		static void CreateJobManager();
 		static JobManager* GetInstance();
 		static void DestroyJobManager();
+		static bool HasInstance()						{ return msJobManager != NULL; }
 		
 		// Update sends out signals for completed jobs
 		void OnUpdate();
-		// Add a job to the job queue
+		// Add a job to the job queue. Safe from any thread, including from inside a job.
+		// Jobs with dependencies are held until their prerequisites finish.
 		void PushJob( Job* job );
+		// Run other jobs until every job pushed with counter has executed.
+		// Their OnCompletetion still fires from OnUpdate.
+		void Wait( const JobCounter& counter );
 		// Destroy all jobs of all types
 		void DestroyAllPendingJobs();
 		// Destroy all jobs of a given type
@@ -32,39 +44,77 @@ namespace mage
 		void SetMaxWorkerThreads( int maxWorkers );
 		// Get the current number of worker threads
 		int GetCurrentNumberOfWorkers() const;
+		// Workers that run JOB_GENERIC jobs, one worker is kept for file I/O
+		int GetNumGenericWorkers() const;
 		
 	private:
-		static void _worker_function( void* pWorker );
-		void Initialize();
-		Job* AquireNextJob( Job::JobType requestedType );
-		void SubmitCompletedJob( Job* job );
-		void DestroyAllWorkers();
-
-		unsigned int mMaxNumberOfWorkers;
+		static const int MAX_WORKERS = 32;
 
 		struct Worker
 		{
 			Worker()
-				: CurrentJob( NULL)
+				: Index( 0 )
+				, CurrentJob( NULL)
+				, MyThread( NULL )
 				, Alive( true )
 				, MyPerferedJobType( Job::JOB_GENERIC )
+				, StealSeed( 1 )
 			{}
 
+			int Index;						// Slot in mLocalQueues
 			Job* CurrentJob;
 			Thread* MyThread;
-			bool Alive;
+			volatile bool Alive;
 			Job::JobType MyPerferedJobType;
+			uint32 StealSeed;				// Picks the first worker to try stealing from
 		};
 
+		static void _worker_function( void* pWorker );
+		void Initialize();
+		Worker* CreateWorker( int index, Job::JobType jobType );
+		// Stop and join workers from index up
+		void DestroyWorkers( unsigned int index );
+		void DestroyAllWorkers();
+		// Queue a job that is ready to run
+		void ScheduleJob( Job* job );
+		// Execute, start continuations that were waiting on it and queue its completion callback
+		void ExecuteJob( Job* job );
+		// Look for a job in this worker's deque, the pending queue for its type, other workers' deques
+		// and finally the pending generic jobs if it is the file I/O worker
+		Job* FindJob( Worker* worker );
+		// Job for a thread that isn't a worker to run while it waits
+		Job* FindJobToHelp( uint32& stealSeed );
+		// FindJob, sleeping until a job is pushed if there is none. Returns NULL if woken to exit.
+		Job* WaitForJob( Worker* worker );
+		// Take the oldest job from any worker but thiefIndex
+		Job* StealJob( uint32& stealSeed, int thiefIndex );
+		// Oldest of the highest priority pending jobs of requestedType
+		Job* AquireNextJob( Job::JobType requestedType );
+		// Wake a worker sleeping in WaitForJob, preferring one for jobType
+		void WakeWorker( Job::JobType jobType );
+		void SubmitCompletedJob( Job* job );
+
+		unsigned int mMaxNumberOfWorkers;
+
 		std::vector< Worker* > mWorkers;
-		// New jobs are added to the front, works acquire jobs from the back
-		std::list< Job* > mPendingJobQueue[ Job::JOB_TYPE_COUNT ];
+		// Per worker deques, indexed by Worker::Index. They outlive their workers so thieves never see a deleted one.
+		WorkStealingDeque< Job* >* mLocalQueues;
+		volatile int32 mNumLocalQueues;				// Highest worker index used plus one
+		// One FIFO per type and priority. New jobs are added to the back, workers acquire jobs from the front.
+		std::deque< Job* > mPendingJobQueue[ Job::JOB_TYPE_COUNT ][ Job::JP_COUNT ];
+		volatile int32 mNumPendingJobs[ Job::JOB_TYPE_COUNT ];	// Lets idle workers skip mJobQueueMutex
 		std::list< Job* > mCompletedJobList;
 
+		// Idle workers sleep on the semaphore for their preferred type
+		Semaphore mWakeSignal[ Job::JOB_TYPE_COUNT ];
+		volatile int32 mNumSleeping[ Job::JOB_TYPE_COUNT ];
+
 		Mutex mJobQueueMutex;
 		Mutex mJobCompleteMutex;
 
 		static JobManager* msJobManager;
+		// Worker running on this thread, NULL on other threads
+		static THREAD_LOCAL Worker* msCurrentWorker;
 
 	};
 
@@ -0,0 +1,162 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Bounded lock-free FIFO, safe for any number of producer and consumer threads.
+ *   Each cell carries a sequence number telling whether it is ready to be
+ *   written or read on the current lap around the buffer, so a push or pop is
+ *   one compare-exchange on the position plus a release store on the cell.
+ *   Nothing is allocated after construction. TryPush fails when the queue is
+ *   full and TryPop fails when it is empty, neither ever waits on other threads.
+ *   Copying T must not throw.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename T >
+	class LockFreeQueue
+	{
+	public:
+		// capacity is rounded up to a power of two
+		LockFreeQueue( uint32 capacity=256 );
+		~LockFreeQueue();
+
+		// Add value to the back. Returns false if the queue is full.
+		bool TryPush( const T& value );
+		// Remove the front into value. Returns false if the queue is empty.
+		bool TryPop( T& value );
+
+		uint32 Capacity() const						{ return mMask + 1; }
+		// Only a snapshot while other threads are pushing and popping
+		bool IsEmpty() const;
+
+	private:
+		LockFreeQueue( const LockFreeQueue& );
+		LockFreeQueue& operator=( const LockFreeQueue& );
+
+		struct Cell
+		{
+			volatile int32 Sequence;
+			T Data;
+		};
+
+		Cell* mCells;
+		uint32 mMask;
+		// Producers and consumers each own a cache line
+		uint8 mPad0[ CACHE_LINE_SIZE ];
+		volatile int32 mEnqueuePos;
+		uint8 mPad1[ CACHE_LINE_SIZE ];
+		volatile int32 mDequeuePos;
+		uint8 mPad2[ CACHE_LINE_SIZE ];
+	};
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename T >
+	LockFreeQueue< T >::LockFreeQueue( uint32 capacity )
+		: mEnqueuePos( 0 )
+		, mDequeuePos( 0 )
+	{
+		uint32 size = 2;
+		while ( size < capacity )
+			size <<= 1;
+
+		mMask = size - 1;
+		mCells = new Cell[ size ];
+		for ( uint32 i = 0; i < size; ++i )
+		{
+			mCells[i].Sequence = (int32) i;
+		}
+	}
+	//---------------------------------------
+	template< typename T >
+	LockFreeQueue< T >::~LockFreeQueue()
+	{
+		delete[] mCells;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool LockFreeQueue< T >::TryPush( const T& value )
+	{
+		// Positions only ever count up, differences are taken unsigned so they survive wrapping
+		Cell* cell;
+		int32 pos = AtomicLoadAcquire( &mEnqueuePos );
+		for ( ;; )
+		{
+			cell = &mCells[ pos & mMask ];
+			int32 seq = AtomicLoadAcquire( &cell->Sequence );
+			int32 diff = (int32) ( (uint32) seq - (uint32) pos );
+			if ( diff == 0 )
+			{
+				// Cell is free on this lap, claim it
+				int32 prev = AtomicCompareExchange( &mEnqueuePos, (int32) ( (uint32) pos + 1 ), pos );
+				if ( prev == pos )
+					break;
+				pos = prev;
+			}
+			else if ( diff < 0 )
+			{
+				// Cell still holds a value from the last lap
+				return false;
+			}
+			else
+			{
+				// Another producer got here first
+				pos = AtomicLoadAcquire( &mEnqueuePos );
+			}
+		}
+
+		cell->Data = value;
+		// Publish to consumers
+		AtomicStoreRelease( &cell->Sequence, (int32) ( (uint32) pos + 1 ) );
+		return true;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool LockFreeQueue< T >::TryPop( T& value )
+	{
+		Cell* cell;
+		int32 pos = AtomicLoadAcquire( &mDequeuePos );
+		for ( ;; )
+		{
+			cell = &mCells[ pos & mMask ];
+			int32 seq = AtomicLoadAcquire( &cell->Sequence );
+			int32 diff = (int32) ( (uint32) seq - (uint32) pos - 1 );
+			if ( diff == 0 )
+			{
+				int32 prev = AtomicCompareExchange( &mDequeuePos, (int32) ( (uint32) pos + 1 ), pos );
+				if ( prev == pos )
+					break;
+				pos = prev;
+			}
+			else if ( diff < 0 )
+			{
+				// Nothing written here yet
+				return false;
+			}
+			else
+			{
+				pos = AtomicLoadAcquire( &mDequeuePos );
+			}
+		}
+
+		value = cell->Data;
+		// Hand the cell back to producers for the next lap
+		AtomicStoreRelease( &cell->Sequence, (int32) ( (uint32) pos + mMask + 1 ) );
+		return true;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool LockFreeQueue< T >::IsEmpty() const
+	{
+		return AtomicLoadAcquire( &mEnqueuePos ) == AtomicLoadAcquire( &mDequeuePos );
+	}
+	//---------------------------------------
+
+}
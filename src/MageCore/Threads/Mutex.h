@@ -17,6 +17,13 @@
 #define CriticalBlock( MUTEX )							\
 	CriticalSection MUTEX##cs( MUTEX );
 
+// Linux mutexes are a futex word locked and unlocked inline, only contention calls into Mutex_Linux.cpp.
+// Other platforms go through PDIMutex.
+// None of the projects build the *_Linux.cpp backends yet, MageMath doesn't compile with GCC. They have
+// only been built and run outside the tree against stubs for the rest of MageCore.
+#if defined( __linux__ )
+#	define MAGE_FUTEX_MUTEX
+#endif
 	
 
 namespace mage
@@ -39,7 +46,15 @@ namespace mage
 		inline void Unlock();
 
 	private:
+#ifdef MAGE_FUTEX_MUTEX
+		// Spin briefly then sleep on the futex until the mutex is ours
+		void LockContended();
+		void WakeWaiter();
+
+		volatile int32 mState;				// 0 unlocked, 1 locked, 2 locked and threads may be sleeping on it
+#else
 		class PDIMutex* mPDIMutex;
+#endif
 	};
 	//---------------------------------------
 
@@ -80,6 +95,28 @@ namespace mage
 
 
 	//---------------------------------------
+#ifdef MAGE_FUTEX_MUTEX
+	inline void Mutex::Lock()
+	{
+		if ( AtomicCompareExchange( &mState, 1, 0 ) != 0 )
+		{
+			LockContended();
+		}
+	}
+
+	inline bool Mutex::TryLock()
+	{
+		return AtomicCompareExchange( &mState, 1, 0 ) == 0;
+	}
+
+	inline void Mutex::Unlock()
+	{
+		if ( AtomicExchange( &mState, 0 ) == 2 )
+		{
+			WakeWaiter();
+		}
+	}
+#else
 	inline void Mutex::Lock()
 	{
 		return mPDIMutex->Lock();
@@ -94,5 +131,6 @@ namespace mage
 	{
 		return mPDIMutex->Unlock();
 	}
+#endif
 	//---------------------------------------
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "CoreLib.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace mage;
+
+//---------------------------------------
+// Tries before going to sleep, a little longer than a short critical section usually takes
+static const int MUTEX_SPIN_COUNT = 100;
+//---------------------------------------
+
+
+//---------------------------------------
+Mutex::Mutex()
+	: mState( 0 )
+{}
+//---------------------------------------
+Mutex::~Mutex()
+{}
+//---------------------------------------
+void Mutex::LockContended()
+{
+	// The holder is probably about to unlock, wait it out without a syscall
+	for ( int i = 0; i < MUTEX_SPIN_COUNT; ++i )
+	{
+		CpuPause();
+		if ( AtomicLoadAcquire( &mState ) == 0 && AtomicCompareExchange( &mState, 1, 0 ) == 0 )
+		{
+			return;
+		}
+	}
+
+	// Mark the mutex as having sleepers so the unlock wakes one. If it was unlocked
+	// when we marked it, it's ours, otherwise sleep while it is still marked.
+	while ( AtomicExchange( &mState, 2 ) != 0 )
+	{
+		syscall( SYS_futex, &mState, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0 );
+	}
+}
+//---------------------------------------
+void Mutex::WakeWaiter()
+{
+	syscall( SYS_futex, &mState, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0 );
+}
+//---------------------------------------
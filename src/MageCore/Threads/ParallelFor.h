@@ -0,0 +1,250 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Data parallel loops on top of the JobManager.
+ *   A range is split into chunks, one job each. The calling thread runs the
+ *   first chunk itself then helps with the rest in JobManager::Wait, so it is
+ *   safe to call from inside a job. The chunk jobs live on the caller's stack.
+ *   Ranges of one grain, or when there are no generic workers (or no
+ *   JobManager), run serially on the calling thread.
+ *
+ *   grainSize is the fewest indices a chunk gets. Pass 0 to size chunks from
+ *   the range and the number of workers, at least MIN_AUTO_GRAIN indices each.
+ *   Give a grain for loops with expensive elements.
+ *
+ *   ParallelFor( 0, numParticles, 0, [&]( int i ) { particles[i].OnUpdate( dt ); } );
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	enum
+	{
+		MAX_PARALLEL_CHUNKS		= 64,
+		MIN_AUTO_GRAIN			= 64,
+		PARALLEL_SORT_GRAIN		= 2048,
+	};
+
+	// Call fn( i ) for every i in [begin, end)
+	template< typename TFunc >
+	void ParallelFor( int begin, int end, int grainSize, const TFunc& fn );
+
+	// Call fn( rangeBegin, rangeEnd ) once per chunk of [begin, end), for loops with per chunk setup
+	template< typename TFunc >
+	void ParallelForRange( int begin, int end, int grainSize, const TFunc& fn );
+
+	// Combine rangeFn( rangeBegin, rangeEnd ) for each chunk of [begin, end) with combine( a, b ).
+	// Partial results are combined in range order starting from identity.
+	template< typename T, typename TRangeFunc, typename TCombine >
+	T ParallelReduce( int begin, int end, int grainSize, const T& identity, const TRangeFunc& rangeFn, const TCombine& combine );
+
+	// Sort [first, last). Chunks are sorted in parallel, then merged pairwise in parallel rounds.
+	// Not stable, like std::sort. Needs a temporary copy of the range.
+	template< typename T, typename TLess >
+	void ParallelSort( T* first, T* last, const TLess& less );
+	template< typename T >
+	void ParallelSort( T* first, T* last );
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	// One chunk of a ParallelForRange
+	template< typename TFunc >
+	class ParallelRangeJob
+		: public Job
+	{
+	public:
+		ParallelRangeJob()
+			: Job( JP_HIGHEST, JOB_GENERIC )
+			, mFunc( NULL )
+			, mBegin( 0 )
+			, mEnd( 0 )
+		{
+			SetCallerOwned( true );
+		}
+
+		void SetRange( const TFunc* fn, int begin, int end )
+		{
+			mFunc = fn;
+			mBegin = begin;
+			mEnd = end;
+		}
+
+		virtual void OnExecute()				{ (*mFunc)( mBegin, mEnd ); }
+		virtual void OnCompletetion()			{}
+
+	private:
+		const TFunc* mFunc;
+		int mBegin;
+		int mEnd;
+	};
+	//---------------------------------------
+	// How many chunks to split count indices into, 1 to run serially
+	inline int ParallelChunkCount( int count, int grainSize )
+	{
+		if ( count <= 0 || !JobManager::HasInstance() )
+			return 1;
+
+		int workers = JobManager::GetInstance()->GetNumGenericWorkers();
+		if ( workers == 0 )
+			return 1;
+
+		// A few chunks per thread so uneven chunks even out
+		if ( grainSize <= 0 )
+			grainSize = Mathi::Max( count / ( 4 * ( workers + 1 ) ), MIN_AUTO_GRAIN );
+
+		int chunks = count / grainSize + ( count % grainSize != 0 ? 1 : 0 );
+		return Mathi::Min( chunks, MAX_PARALLEL_CHUNKS );
+	}
+	//---------------------------------------
+	// Bounds of chunk i when count indices from begin are split into numChunks, the remainder going to the first chunks
+	inline void ParallelChunkBounds( int begin, int count, int numChunks, int i, int& chunkBegin, int& chunkEnd )
+	{
+		int size = count / numChunks;
+		int extra = count % numChunks;
+		chunkBegin = begin + i * size + Mathi::Min( i, extra );
+		chunkEnd = chunkBegin + size + ( i < extra ? 1 : 0 );
+	}
+	//---------------------------------------
+	template< typename TFunc >
+	void ParallelForRange( int begin, int end, int grainSize, const TFunc& fn )
+	{
+		int count = end - begin;
+		int numChunks = ParallelChunkCount( count, grainSize );
+		if ( numChunks <= 1 )
+		{
+			if ( count > 0 )
+				fn( begin, end );
+			return;
+		}
+
+		JobManager* jobManager = JobManager::GetInstance();
+		ParallelRangeJob< TFunc > jobs[ MAX_PARALLEL_CHUNKS ];
+		JobCounter counter;
+
+		for ( int i = 0; i < numChunks; ++i )
+		{
+			int chunkBegin, chunkEnd;
+			ParallelChunkBounds( begin, count, numChunks, i, chunkBegin, chunkEnd );
+			jobs[i].SetRange( &fn, chunkBegin, chunkEnd );
+		}
+
+		// Workers take the rest while we do the first
+		for ( int i = 1; i < numChunks; ++i )
+		{
+			jobs[i].SetCounter( &counter );
+			jobManager->PushJob( &jobs[i] );
+		}
+		jobs[0].OnExecute();
+
+		jobManager->Wait( counter );
+	}
+	//---------------------------------------
+	template< typename TFunc >
+	void ParallelFor( int begin, int end, int grainSize, const TFunc& fn )
+	{
+		ParallelForRange( begin, end, grainSize, [&fn]( int rangeBegin, int rangeEnd )
+		{
+			for ( int i = rangeBegin; i < rangeEnd; ++i )
+			{
+				fn( i );
+			}
+		});
+	}
+	//---------------------------------------
+	template< typename T, typename TRangeFunc, typename TCombine >
+	T ParallelReduce( int begin, int end, int grainSize, const T& identity, const TRangeFunc& rangeFn, const TCombine& combine )
+	{
+		int count = end - begin;
+		int numChunks = ParallelChunkCount( count, grainSize );
+		if ( numChunks <= 1 )
+		{
+			return count > 0 ? combine( identity, rangeFn( begin, end ) ) : identity;
+		}
+
+		// One partial per chunk, each chunk is its own job
+		std::vector< T > partials( numChunks, identity );
+		ParallelForRange( 0, numChunks, 1, [&]( int firstChunk, int lastChunk )
+		{
+			for ( int i = firstChunk; i < lastChunk; ++i )
+			{
+				int chunkBegin, chunkEnd;
+				ParallelChunkBounds( begin, count, numChunks, i, chunkBegin, chunkEnd );
+				partials[i] = rangeFn( chunkBegin, chunkEnd );
+			}
+		});
+
+		T result = identity;
+		for ( int i = 0; i < numChunks; ++i )
+		{
+			result = combine( result, partials[i] );
+		}
+		return result;
+	}
+	//---------------------------------------
+	template< typename T, typename TLess >
+	void ParallelSort( T* first, T* last, const TLess& less )
+	{
+		int count = (int) ( last - first );
+		int numChunks = ParallelChunkCount( count, PARALLEL_SORT_GRAIN );
+		if ( numChunks <= 1 )
+		{
+			std::sort( first, last, less );
+			return;
+		}
+
+		// Chunk boundaries, run i is [ bounds[i], bounds[i+1] )
+		int bounds[ MAX_PARALLEL_CHUNKS + 1 ];
+		for ( int i = 0; i < numChunks; ++i )
+		{
+			ParallelChunkBounds( 0, count, numChunks, i, bounds[i], bounds[i+1] );
+		}
+
+		ParallelForRange( 0, numChunks, 1, [&]( int firstChunk, int lastChunk )
+		{
+			for ( int i = firstChunk; i < lastChunk; ++i )
+			{
+				std::sort( first + bounds[i], first + bounds[i+1], less );
+			}
+		});
+
+		// Merge neighbouring runs, doubling the run length each round. Rounds alternate between the range and buffer.
+		std::vector< T > buffer( count );
+		T* src = first;
+		T* dst = &buffer[0];
+		for ( int width = 1; width < numChunks; width *= 2 )
+		{
+			int numMerges = ( numChunks + 2 * width - 1 ) / ( 2 * width );
+			ParallelForRange( 0, numMerges, 1, [&]( int firstMerge, int lastMerge )
+			{
+				for ( int m = firstMerge; m < lastMerge; ++m )
+				{
+					int lo = m * 2 * width;
+					int mid = Mathi::Min( lo + width, numChunks );
+					int hi = Mathi::Min( lo + 2 * width, numChunks );
+					std::merge( src + bounds[lo], src + bounds[mid], src + bounds[mid], src + bounds[hi], dst + bounds[lo], less );
+				}
+			});
+			std::swap( src, dst );
+		}
+
+		if ( src != first )
+		{
+			std::copy( src, src + count, first );
+		}
+	}
+	//---------------------------------------
+	template< typename T >
+	void ParallelSort( T* first, T* last )
+	{
+		ParallelSort( first, last, std::less< T >() );
+	}
+	//---------------------------------------
+
+}
@@ -0,0 +1,136 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Reader-writer lock. Any number of readers can hold it at once, a writer
+ *   holds it alone. Waiting writers are favoured over new readers so they
+ *   don't starve.
+ *   Not recursive, don't take it again on the thread holding it.
+ */
+
+#pragma once
+
+#define ReadCriticalBlock( LOCK )						\
+	ReadCriticalSection LOCK##rcs( LOCK );
+
+#define WriteCriticalBlock( LOCK )						\
+	WriteCriticalSection LOCK##wcs( LOCK );
+
+namespace mage
+{
+
+	class RWLock
+	{
+	public:
+		RWLock();
+		~RWLock();
+
+		// Lock for reading, shared with other readers
+		inline void ReadLock();
+		// This function is non-blocking
+		inline bool TryReadLock();
+		inline void ReadUnlock();
+
+		// Lock for writing, excluding everyone else
+		inline void WriteLock();
+		// This function is non-blocking
+		inline bool TryWriteLock();
+		inline void WriteUnlock();
+
+	private:
+		class PDIRWLock* mPDIRWLock;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class ReadCriticalSection
+	{
+	public:
+		ReadCriticalSection( RWLock& lock )
+			: mLock( &lock )
+		{
+			mLock->ReadLock();
+		}
+
+		~ReadCriticalSection()
+		{
+			mLock->ReadUnlock();
+		}
+
+	private:
+		RWLock* mLock;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class WriteCriticalSection
+	{
+	public:
+		WriteCriticalSection( RWLock& lock )
+			: mLock( &lock )
+		{
+			mLock->WriteLock();
+		}
+
+		~WriteCriticalSection()
+		{
+			mLock->WriteUnlock();
+		}
+
+	private:
+		RWLock* mLock;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class PDIRWLock
+	{
+	public:
+		virtual ~PDIRWLock() = 0;
+		virtual void ReadLock() = 0;
+		virtual bool TryReadLock() = 0;
+		virtual void ReadUnlock() = 0;
+		virtual void WriteLock() = 0;
+		virtual bool TryWriteLock() = 0;
+		virtual void WriteUnlock() = 0;
+	};
+
+	inline PDIRWLock::~PDIRWLock() {}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	inline void RWLock::ReadLock()
+	{
+		mPDIRWLock->ReadLock();
+	}
+
+	inline bool RWLock::TryReadLock()
+	{
+		return mPDIRWLock->TryReadLock();
+	}
+
+	inline void RWLock::ReadUnlock()
+	{
+		mPDIRWLock->ReadUnlock();
+	}
+
+	inline void RWLock::WriteLock()
+	{
+		mPDIRWLock->WriteLock();
+	}
+
+	inline bool RWLock::TryWriteLock()
+	{
+		return mPDIRWLock->TryWriteLock();
+	}
+
+	inline void RWLock::WriteUnlock()
+	{
+		mPDIRWLock->WriteUnlock();
+	}
+	//---------------------------------------
+}
@@ -0,0 +1,74 @@
+#include "CoreLib.h"
+
+#include <pthread.h>
+
+using namespace mage;
+
+//---------------------------------------
+class RWLockLinux
+	: public PDIRWLock
+{
+public:
+	//---------------------------------------
+	RWLockLinux()
+	{
+		// glibc prefers readers by default, which can starve writers
+		pthread_rwlockattr_t attr;
+		pthread_rwlockattr_init( &attr );
+		pthread_rwlockattr_setkind_np( &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP );
+		pthread_rwlock_init( &mLock, &attr );
+		pthread_rwlockattr_destroy( &attr );
+	}
+	//---------------------------------------
+	virtual ~RWLockLinux()
+	{
+		pthread_rwlock_destroy( &mLock );
+	}
+	//---------------------------------------
+	void ReadLock()
+	{
+		pthread_rwlock_rdlock( &mLock );
+	}
+	//---------------------------------------
+	bool TryReadLock()
+	{
+		return pthread_rwlock_tryrdlock( &mLock ) == 0;
+	}
+	//---------------------------------------
+	void ReadUnlock()
+	{
+		pthread_rwlock_unlock( &mLock );
+	}
+	//---------------------------------------
+	void WriteLock()
+	{
+		pthread_rwlock_wrlock( &mLock );
+	}
+	//---------------------------------------
+	bool TryWriteLock()
+	{
+		return pthread_rwlock_trywrlock( &mLock ) == 0;
+	}
+	//---------------------------------------
+	void WriteUnlock()
+	{
+		pthread_rwlock_unlock( &mLock );
+	}
+	//---------------------------------------
+private:
+	pthread_rwlock_t mLock;
+
+};
+//---------------------------------------
+
+
+//---------------------------------------
+RWLock::RWLock()
+	: mPDIRWLock( new RWLockLinux )
+{}
+//---------------------------------------
+RWLock::~RWLock()
+{
+	delete mPDIRWLock;
+}
+//---------------------------------------
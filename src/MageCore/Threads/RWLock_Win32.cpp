@@ -0,0 +1,67 @@
+#include "CoreLib.h"
+
+#include <Windows.h>
+
+using namespace mage;
+
+//---------------------------------------
+class RWLockWin32
+	: public PDIRWLock
+{
+public:
+	//---------------------------------------
+	RWLockWin32()
+	{
+		InitializeSRWLock( &mLock );
+	}
+	//---------------------------------------
+	virtual ~RWLockWin32()
+	{}
+	//---------------------------------------
+	void ReadLock()
+	{
+		AcquireSRWLockShared( &mLock );
+	}
+	//---------------------------------------
+	bool TryReadLock()
+	{
+		return TryAcquireSRWLockShared( &mLock ) != 0;
+	}
+	//---------------------------------------
+	void ReadUnlock()
+	{
+		ReleaseSRWLockShared( &mLock );
+	}
+	//---------------------------------------
+	void WriteLock()
+	{
+		AcquireSRWLockExclusive( &mLock );
+	}
+	//---------------------------------------
+	bool TryWriteLock()
+	{
+		return TryAcquireSRWLockExclusive( &mLock ) != 0;
+	}
+	//---------------------------------------
+	void WriteUnlock()
+	{
+		ReleaseSRWLockExclusive( &mLock );
+	}
+	//---------------------------------------
+private:
+	SRWLOCK mLock;
+
+};
+//---------------------------------------
+
+
+//---------------------------------------
+RWLock::RWLock()
+	: mPDIRWLock( new RWLockWin32 )
+{}
+//---------------------------------------
+RWLock::~RWLock()
+{
+	delete mPDIRWLock;
+}
+//---------------------------------------
@@ -0,0 +1,65 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Counting semaphore. Threads waiting on it sleep in the OS until signaled.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	class Semaphore
+	{
+	public:
+		Semaphore( int initialCount=0 );
+		~Semaphore();
+
+		// Block until the count is above zero, then decrement it
+		inline void Wait();
+
+		// Decrement the count if it is above zero
+		// This function is non-blocking
+		inline bool TryWait();
+
+		// Add to the count, releasing up to that many waiting threads
+		inline void Signal( int count=1 );
+
+	private:
+		class PDISemaphore* mPDISemaphore;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class PDISemaphore
+	{
+	public:
+		virtual ~PDISemaphore() = 0;
+		virtual void Wait() = 0;
+		virtual bool TryWait() = 0;
+		virtual void Signal( int count ) = 0;
+	};
+
+	inline PDISemaphore::~PDISemaphore() {}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	inline void Semaphore::Wait()
+	{
+		mPDISemaphore->Wait();
+	}
+
+	inline bool Semaphore::TryWait()
+	{
+		return mPDISemaphore->TryWait();
+	}
+
+	inline void Semaphore::Signal( int count )
+	{
+		mPDISemaphore->Signal( count );
+	}
+	//---------------------------------------
+}
\ No newline at end of file
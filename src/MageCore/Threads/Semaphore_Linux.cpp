@@ -0,0 +1,59 @@
+#include "CoreLib.h"
+
+#include <semaphore.h>
+#include <errno.h>
+
+using namespace mage;
+
+//---------------------------------------
+class SemaphoreLinux
+	: public PDISemaphore
+{
+public:
+	//---------------------------------------
+	SemaphoreLinux( int initialCount )
+	{
+		sem_init( &mSem, 0, (unsigned int) initialCount );
+	}
+	//---------------------------------------
+	virtual ~SemaphoreLinux()
+	{
+		sem_destroy( &mSem );
+	}
+	//---------------------------------------
+	void Wait()
+	{
+		// Signals interrupt the wait, they don't signal us
+		while ( sem_wait( &mSem ) != 0 && errno == EINTR ) {}
+	}
+	//---------------------------------------
+	bool TryWait()
+	{
+		return sem_trywait( &mSem ) == 0;
+	}
+	//---------------------------------------
+	void Signal( int count )
+	{
+		for ( int i = 0; i < count; ++i )
+		{
+			sem_post( &mSem );
+		}
+	}
+	//---------------------------------------
+private:
+	sem_t mSem;
+
+};
+//---------------------------------------
+
+
+//---------------------------------------
+Semaphore::Semaphore( int initialCount )
+	: mPDISemaphore( new SemaphoreLinux( initialCount ) )
+{}
+//---------------------------------------
+Semaphore::~Semaphore()
+{
+	delete mPDISemaphore;
+}
+//---------------------------------------
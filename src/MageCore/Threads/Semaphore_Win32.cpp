@@ -0,0 +1,55 @@
+#include "CoreLib.h"
+
+#include <Windows.h>
+#include <climits>
+
+using namespace mage;
+
+//---------------------------------------
+class SemaphoreWin32
+	: public PDISemaphore
+{
+public:
+	//---------------------------------------
+	SemaphoreWin32( int initialCount )
+	{
+		mHandle = CreateSemaphore( NULL, initialCount, LONG_MAX, NULL );
+	}
+	//---------------------------------------
+	virtual ~SemaphoreWin32()
+	{
+		CloseHandle( mHandle );
+	}
+	//---------------------------------------
+	void Wait()
+	{
+		WaitForSingleObject( mHandle, INFINITE );
+	}
+	//---------------------------------------
+	bool TryWait()
+	{
+		return WaitForSingleObject( mHandle, 0 ) == WAIT_OBJECT_0;
+	}
+	//---------------------------------------
+	void Signal( int count )
+	{
+		ReleaseSemaphore( mHandle, count, NULL );
+	}
+	//---------------------------------------
+private:
+	HANDLE mHandle;
+
+};
+//---------------------------------------
+
+
+//---------------------------------------
+Semaphore::Semaphore( int initialCount )
+	: mPDISemaphore( new SemaphoreWin32( initialCount ) )
+{}
+//---------------------------------------
+Semaphore::~Semaphore()
+{
+	delete mPDISemaphore;
+}
+//---------------------------------------
\ No newline at end of file
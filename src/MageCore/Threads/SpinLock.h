@@ -0,0 +1,77 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Lock that busy waits instead of sleeping. Only for critical sections a
+ *   few instructions long that are rarely contended, anything longer should
+ *   use a Mutex, which spins briefly itself before sleeping.
+ *   Not recursive.
+ */
+
+#pragma once
+
+#define SpinCriticalBlock( LOCK )						\
+	SpinCriticalSection LOCK##scs( LOCK );
+
+namespace mage
+{
+
+	class SpinLock
+	{
+	public:
+		SpinLock()
+			: mLocked( 0 )
+		{}
+
+		void Lock()
+		{
+			// Only try to take it when it looks free so waiters don't fight over the cache line
+			while ( AtomicExchange( &mLocked, 1 ) != 0 )
+			{
+				while ( AtomicLoadAcquire( &mLocked ) != 0 )
+				{
+					CpuPause();
+				}
+			}
+		}
+
+		// This function is non-blocking
+		bool TryLock()
+		{
+			return AtomicLoadAcquire( &mLocked ) == 0 && AtomicExchange( &mLocked, 1 ) == 0;
+		}
+
+		void Unlock()
+		{
+			AtomicStoreRelease( &mLocked, 0 );
+		}
+
+	private:
+		SpinLock( const SpinLock& );
+		SpinLock& operator=( const SpinLock& );
+
+		volatile int32 mLocked;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class SpinCriticalSection
+	{
+	public:
+		SpinCriticalSection( SpinLock& lock )
+			: mLock( &lock )
+		{
+			mLock->Lock();
+		}
+
+		~SpinCriticalSection()
+		{
+			mLock->Unlock();
+		}
+
+	private:
+		SpinLock* mLock;
+	};
+	//---------------------------------------
+}
@@ -0,0 +1,65 @@
+#include "CoreLib.h"
+
+using namespace mage;
+
+//---------------------------------------
+Mutex TaskStateBase::msContinuationMutex;
+//---------------------------------------
+TaskStateBase::TaskStateBase()
+	: mRefs( 1 )
+	, mFinished( false )
+{
+	mCounter.Increment();
+}
+//---------------------------------------
+TaskStateBase::~TaskStateBase()
+{}
+//---------------------------------------
+void TaskStateBase::Release()
+{
+	if ( AtomicDecrement( &mRefs ) == 0 )
+	{
+		delete this;
+	}
+}
+//---------------------------------------
+void TaskStateBase::Wait() const
+{
+	JobManager::GetInstance()->Wait( mCounter );
+}
+//---------------------------------------
+void TaskStateBase::Finish()
+{
+	std::vector< Job* > continuations;
+
+	BeginCriticalSection( msContinuationMutex );
+
+	mFinished = true;
+	continuations.swap( mContinuations );
+
+	EndCriticalSection();
+
+	// The result is visible to anyone who sees the counter drop
+	mCounter.Decrement();
+
+	for ( unsigned int i = 0; i < continuations.size(); ++i )
+	{
+		JobManager::GetInstance()->PushJob( continuations[i] );
+	}
+}
+//---------------------------------------
+void TaskStateBase::Continue( Job* job )
+{
+	BeginCriticalSection( msContinuationMutex );
+
+	if ( !mFinished )
+	{
+		mContinuations.push_back( job );
+		return;
+	}
+
+	EndCriticalSection();
+
+	JobManager::GetInstance()->PushJob( job );
+}
+//---------------------------------------
@@ -0,0 +1,414 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Tasks are handles to the result of work running on the JobManager.
+ *   Each step of a multi step operation is a continuation that runs once the
+ *   step before it has a result, so the steps read top to bottom instead of
+ *   being split across Job subclasses:
+ *
+ *   ReadDataFileAsync( "meshes/Ship.mesh" )
+ *       .Then< Mesh* >( []( const DataFile& file ) -> Mesh* { return ParseMesh( file ); } )
+ *       .ThenOnMainThread< void >( []( Mesh* const& mesh ) { UploadMesh( mesh ); } );
+ *
+ *   Continuations take the previous result by const reference, or nothing
+ *   after a Task< void >, and give the type of their result explicitly.
+ *   Non void results must be default constructible and copyable.
+ *   Tasks are reference counted, results live until the last handle and
+ *   pending continuation are gone. Dropping a handle doesn't cancel anything.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename T > class Task;
+	template< typename T > class TaskCompletion;
+
+	//---------------------------------------
+	// Shared by a Task's handles and the jobs producing and waiting on its result
+	class TaskStateBase
+	{
+	public:
+		TaskStateBase();
+		virtual ~TaskStateBase();
+
+		void AddRef()						{ AtomicIncrement( &mRefs ); }
+		void Release();
+
+		bool IsDone() const					{ return mCounter.IsDone(); }
+		// Run other jobs until the result is set
+		void Wait() const;
+
+		// Call once the result is set. Pushes the continuations.
+		void Finish();
+		// Push job once the result is set, right away if it already is
+		void Continue( Job* job );
+
+	private:
+		TaskStateBase( const TaskStateBase& );
+		TaskStateBase& operator=( const TaskStateBase& );
+
+		volatile int32 mRefs;
+		JobCounter mCounter;				// One until finished
+		bool mFinished;
+		std::vector< Job* > mContinuations;
+
+		// Guards mFinished and mContinuations of every task, it is only held to add to or take the list
+		static Mutex msContinuationMutex;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Storage for a result, void results store nothing
+	template< typename T >
+	struct TaskValue
+	{
+		typedef const T& Ref;
+
+		Ref Get() const						{ return Value; }
+		template< typename TFunc >
+		void Run( const TFunc& fn )			{ Value = fn(); }
+		// Call fn with the result
+		template< typename U, typename TFunc >
+		U Pass( const TFunc& fn ) const		{ return fn( Value ); }
+
+		T Value;
+	};
+
+	template<>
+	struct TaskValue< void >
+	{
+		typedef void Ref;
+
+		void Get() const					{}
+		template< typename TFunc >
+		void Run( const TFunc& fn )			{ fn(); }
+		template< typename U, typename TFunc >
+		U Pass( const TFunc& fn ) const		{ return fn(); }
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename T >
+	class TaskState
+		: public TaskStateBase
+	{
+	public:
+		TaskValue< T > Result;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename T >
+	class Task
+	{
+	public:
+		typedef typename TaskValue< T >::Ref ResultRef;
+
+		// An empty handle, IsValid() is false
+		Task();
+		// Takes over the creator's reference to state
+		explicit Task( TaskState< T >* state );
+		Task( const Task& other );
+		~Task();
+		Task& operator=( const Task& other );
+
+		bool IsValid() const				{ return mState != NULL; }
+		// Poll for the result from the main thread
+		bool IsDone() const					{ return mState->IsDone(); }
+		// Run other jobs until the result is set. Don't wait on the main thread for a task
+		// that has a ThenOnMainThread step, OnUpdate runs those.
+		void Wait() const					{ mState->Wait(); }
+		// Waits for and returns the result
+		ResultRef GetResult() const;
+
+		// Run fn( result ) on a worker once the result is set
+		template< typename U, typename TFunc >
+		Task< U > Then( const TFunc& fn, Job::JobType jobType=Job::JOB_GENERIC, Job::JobPriority priority=Job::JP_AVERAGE ) const;
+		// Run fn( result ) on the main thread, from JobManager::OnUpdate, once the result is set
+		template< typename U, typename TFunc >
+		Task< U > ThenOnMainThread( const TFunc& fn ) const;
+		// Run fn( result ), which starts another Task< U >, and finish with that task's result
+		template< typename U, typename TFunc >
+		Task< U > ThenTask( const TFunc& fn, Job::JobType jobType=Job::JOB_GENERIC, Job::JobPriority priority=Job::JP_AVERAGE ) const;
+
+	private:
+		TaskState< T >* mState;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// A Task finished by hand, for results that come from events instead of jobs.
+	// Set the result once, from any thread. Continuations of a task that is never set are never freed.
+	template< typename T >
+	class TaskCompletion
+	{
+	public:
+		TaskCompletion()						: mState( new TaskState< T > ), mTask( mState ) {}
+
+		Task< T > GetTask() const				{ return mTask; }
+		void SetResult( const T& value ) const;
+
+	private:
+		TaskState< T >* mState;
+		Task< T > mTask;
+	};
+
+	template<>
+	class TaskCompletion< void >
+	{
+	public:
+		TaskCompletion()						: mState( new TaskState< void > ), mTask( mState ) {}
+
+		Task< void > GetTask() const			{ return mTask; }
+		void SetResult() const;
+
+	private:
+		TaskState< void >* mState;
+		Task< void > mTask;
+	};
+	//---------------------------------------
+
+
+	// Run fn() on a worker and return a Task for its result:
+	//  Task< int > count = Async< int >( [&]() { return CountVisible( scene ); } );
+	template< typename T, typename TFunc >
+	Task< T > Async( const TFunc& fn, Job::JobType jobType=Job::JOB_GENERIC, Job::JobPriority priority=Job::JP_AVERAGE );
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	// Sets a task's result from fn() on a worker
+	template< typename T, typename TFunc >
+	class TaskJob
+		: public Job
+	{
+	public:
+		TaskJob( TaskState< T >* state, const TFunc& fn, JobType jobType, JobPriority priority )
+			: Job( priority, jobType )
+			, mState( state )
+			, mFunc( fn )
+		{
+			mState->AddRef();
+		}
+
+		~TaskJob()								{ mState->Release(); }
+
+		virtual void OnExecute()
+		{
+			mState->Result.Run( mFunc );
+			mState->Finish();
+		}
+
+		virtual void OnCompletetion()			{}
+
+	private:
+		TaskState< T >* mState;
+		TFunc mFunc;
+	};
+	//---------------------------------------
+	// Sets a task's result from fn() on the main thread. The worker side does nothing,
+	// the job only exists to get its OnCompletetion called from JobManager::OnUpdate.
+	template< typename T, typename TFunc >
+	class MainThreadTaskJob
+		: public Job
+	{
+	public:
+		MainThreadTaskJob( TaskState< T >* state, const TFunc& fn )
+			: Job( JP_HIGHEST, JOB_GENERIC )
+			, mState( state )
+			, mFunc( fn )
+		{
+			mState->AddRef();
+		}
+
+		~MainThreadTaskJob()					{ mState->Release(); }
+
+		virtual void OnExecute()				{}
+
+		virtual void OnCompletetion()
+		{
+			mState->Result.Run( mFunc );
+			mState->Finish();
+		}
+
+	private:
+		TaskState< T >* mState;
+		TFunc mFunc;
+	};
+	//---------------------------------------
+	template< typename T, typename TFunc >
+	Job* NewTaskJob( TaskState< T >* state, const TFunc& fn, Job::JobType jobType, Job::JobPriority priority )
+	{
+		return new TaskJob< T, TFunc >( state, fn, jobType, priority );
+	}
+	//---------------------------------------
+	template< typename T, typename TFunc >
+	Job* NewMainThreadTaskJob( TaskState< T >* state, const TFunc& fn )
+	{
+		return new MainThreadTaskJob< T, TFunc >( state, fn );
+	}
+	//---------------------------------------
+	// Finish source with inner's result
+	template< typename U >
+	struct TaskForward
+	{
+		static void When( const Task< U >& inner, const TaskCompletion< U >& source )
+		{
+			inner.template Then< void >( [source]( const U& value ) { source.SetResult( value ); } );
+		}
+	};
+
+	template<>
+	struct TaskForward< void >
+	{
+		static void When( const Task< void >& inner, const TaskCompletion< void >& source )
+		{
+			inner.Then< void >( [source]() { source.SetResult(); } );
+		}
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename T >
+	Task< T >::Task()
+		: mState( NULL )
+	{}
+	//---------------------------------------
+	template< typename T >
+	Task< T >::Task( TaskState< T >* state )
+		: mState( state )
+	{}
+	//---------------------------------------
+	template< typename T >
+	Task< T >::Task( const Task& other )
+		: mState( other.mState )
+	{
+		if ( mState )
+			mState->AddRef();
+	}
+	//---------------------------------------
+	template< typename T >
+	Task< T >::~Task()
+	{
+		if ( mState )
+			mState->Release();
+	}
+	//---------------------------------------
+	template< typename T >
+	Task< T >& Task< T >::operator=( const Task& other )
+	{
+		if ( other.mState )
+			other.mState->AddRef();
+		if ( mState )
+			mState->Release();
+		mState = other.mState;
+		return *this;
+	}
+	//---------------------------------------
+	template< typename T >
+	typename Task< T >::ResultRef Task< T >::GetResult() const
+	{
+		mState->Wait();
+		return mState->Result.Get();
+	}
+	//---------------------------------------
+	template< typename T >
+	template< typename U, typename TFunc >
+	Task< U > Task< T >::Then( const TFunc& fn, Job::JobType jobType, Job::JobPriority priority ) const
+	{
+		TaskState< U >* next = new TaskState< U >;
+		Task< U > task( next );
+
+		// The job holds on to this task until it has read the result
+		Task< T > prev = *this;
+		mState->Continue( NewTaskJob( next, [prev, fn]() -> U
+		{
+			return prev.mState->Result.template Pass< U >( fn );
+		}, jobType, priority ) );
+
+		return task;
+	}
+	//---------------------------------------
+	template< typename T >
+	template< typename U, typename TFunc >
+	Task< U > Task< T >::ThenOnMainThread( const TFunc& fn ) const
+	{
+		TaskState< U >* next = new TaskState< U >;
+		Task< U > task( next );
+
+		Task< T > prev = *this;
+		mState->Continue( NewMainThreadTaskJob( next, [prev, fn]() -> U
+		{
+			return prev.mState->Result.template Pass< U >( fn );
+		}) );
+
+		return task;
+	}
+	//---------------------------------------
+	template< typename T >
+	template< typename U, typename TFunc >
+	Task< U > Task< T >::ThenTask( const TFunc& fn, Job::JobType jobType, Job::JobPriority priority ) const
+	{
+		TaskCompletion< U > source;
+
+		// Once fn has started the inner task, wait on it without holding a worker
+		Then< Task< U > >( fn, jobType, priority ).template Then< void >( [source]( const Task< U >& inner )
+		{
+			TaskForward< U >::When( inner, source );
+		}, jobType, priority );
+
+		return source.GetTask();
+	}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename T >
+	void TaskCompletion< T >::SetResult( const T& value ) const
+	{
+		if ( mState->IsDone() )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "TaskCompletion : Result already set, ignoring it\n" );
+			return;
+		}
+
+		mState->Result.Value = value;
+		mState->Finish();
+	}
+	//---------------------------------------
+	inline void TaskCompletion< void >::SetResult() const
+	{
+		if ( mState->IsDone() )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "TaskCompletion : Result already set, ignoring it\n" );
+			return;
+		}
+
+		mState->Finish();
+	}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename T, typename TFunc >
+	Task< T > Async( const TFunc& fn, Job::JobType jobType, Job::JobPriority priority )
+	{
+		TaskState< T >* state = new TaskState< T >;
+		Task< T > task( state );
+		JobManager::GetInstance()->PushJob( NewTaskJob( state, fn, jobType, priority ) );
+		return task;
+	}
+	//---------------------------------------
+
+}
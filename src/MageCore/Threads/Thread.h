@@ -7,6 +7,13 @@
  
 #pragma once
 
+// Declare a global or static variable with one copy per thread
+#ifdef _MSC_VER
+#	define THREAD_LOCAL __declspec( thread )
+#else
+#	define THREAD_LOCAL __thread
+#endif
+
 namespace mage
 {
 
@@ -22,6 +29,10 @@ namespace mage
 		void Join();
 		bool Joinable();
 		inline unsigned int GetThreadId() const;
+		// Only run on the CPUs set in cpuMask, bit n for CPU n. Returns false if the system refused.
+		bool SetAffinity( uint64 cpuMask );
+		// Name shown in debuggers and profilers. Linux only keeps the first 15 characters.
+		void SetName( const char* name );
 
 		static void Sleep( unsigned long ms );
 		static unsigned int GetMaxThreadConcurrency();
@@ -41,6 +52,8 @@ namespace mage
 		virtual bool Joinable() const = 0;
 		//virtual void Sleep( unsigned long ms ) = 0;
 		virtual unsigned int GetThreadId() const = 0;
+		virtual bool SetAffinity( uint64 cpuMask ) = 0;
+		virtual void SetName( const char* name ) = 0;
 	};
 
 	inline PDIThread::~PDIThread() {}
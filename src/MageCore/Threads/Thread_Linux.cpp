@@ -0,0 +1,230 @@
+#include "CoreLib.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <cstring>
+#include <exception>
+
+using namespace mage;
+
+//---------------------------------------
+// Info passed to wrapper function
+struct ThreadInfo
+{
+	Thread::Function Function;
+	void *Arg;
+	class ThreadLinux* TheThread;
+};
+//---------------------------------------
+
+
+//---------------------------------------
+class ThreadLinux
+	: public PDIThread
+{
+public:
+	//---------------------------------------
+	ThreadLinux( Thread::Function function, void* userData, unsigned int stackSize=0 )
+		: mThreadId( 0 )
+		, mCreated( false )
+		, mJoined( false )
+	{
+		ThreadInfo* info = new ThreadInfo;
+		info->Function = function;
+		info->Arg = userData;
+		info->TheThread = this;
+
+		mAlive = true;
+
+		pthread_attr_t attr;
+		pthread_attr_init( &attr );
+		if ( stackSize > 0 )
+		{
+			pthread_attr_setstacksize( &attr, stackSize < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : stackSize );
+		}
+
+		mCreated = pthread_create( &mThread, &attr, _thread_wrapper_function, (void*) info ) == 0;
+		pthread_attr_destroy( &attr );
+
+		// Failed to create thread
+		if ( !mCreated )
+		{
+			mAlive = false;
+			delete info;
+		}
+	}
+	//---------------------------------------
+	virtual ~ThreadLinux()
+	{
+		if ( Joinable() )
+		{
+			std::terminate();
+		}
+
+		// Already finished, release it
+		Join();
+	}
+	//---------------------------------------
+	void Join()
+	{
+		if ( mCreated && !mJoined )
+		{
+			pthread_join( mThread, NULL );
+			mJoined = true;
+		}
+	}
+	//---------------------------------------
+	bool Joinable() const
+	{
+		bool joinable;
+
+		mMutex.Lock();
+		joinable = mAlive;
+		mMutex.Unlock();
+
+		return joinable;
+	}
+	//---------------------------------------
+	unsigned int GetThreadId() const
+	{
+		if ( !mCreated )
+		{
+			return 0;
+		}
+
+		// The thread fills this in as soon as it starts
+		int32 id;
+		while ( ( id = AtomicLoadAcquire( &mThreadId ) ) == 0 )
+		{
+			sched_yield();
+		}
+		return (unsigned int) id;
+	}
+	//---------------------------------------
+	bool SetAffinity( uint64 cpuMask )
+	{
+		cpu_set_t cpus;
+		CPU_ZERO( &cpus );
+		for ( int i = 0; i < 64 && i < CPU_SETSIZE; ++i )
+		{
+			if ( cpuMask & ( (uint64) 1 << i ) )
+			{
+				CPU_SET( i, &cpus );
+			}
+		}
+
+		return mCreated && pthread_setaffinity_np( mThread, sizeof( cpus ), &cpus ) == 0;
+	}
+	//---------------------------------------
+	void SetName( const char* name )
+	{
+		if ( !mCreated )
+		{
+			return;
+		}
+
+		// pthread_setname_np rejects names over 15 characters, cut it instead
+		char shortName[ 16 ];
+		strncpy( shortName, name, sizeof( shortName ) - 1 );
+		shortName[ sizeof( shortName ) - 1 ] = '\0';
+		pthread_setname_np( mThread, shortName );
+	}
+	//---------------------------------------
+private:
+	static void* _thread_wrapper_function( void* arg );
+
+	pthread_t mThread;
+	volatile int32 mThreadId;
+	mutable Mutex mMutex;
+	bool mAlive;
+	bool mCreated;
+	bool mJoined;
+};
+
+//---------------------------------------
+// Thread wrapper function
+void* ThreadLinux::_thread_wrapper_function( void* arg )
+{
+	ThreadInfo* info = (ThreadInfo*) arg;
+
+	AtomicStoreRelease( &info->TheThread->mThreadId, (int32) syscall( SYS_gettid ) );
+
+	try
+	{
+		info->Function( info->Arg );
+	}
+	catch ( ... )
+	{
+		std::terminate();
+	}
+
+	FrameAllocator::ReleaseThreadFrames();
+	MemoryPool::ReleaseThreadCache();
+
+	info->TheThread->mMutex.Lock();
+	info->TheThread->mAlive = false;
+	info->TheThread->mMutex.Unlock();
+
+	delete info;
+
+	return NULL;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+Thread::Thread( Function function, void* userData, unsigned int stackSize )
+	: mPDIThread( new ThreadLinux( function, userData, stackSize ) )
+{}
+//---------------------------------------
+Thread::~Thread()
+{
+	delete mPDIThread;
+}
+//---------------------------------------
+void Thread::Join()
+{
+	mPDIThread->Join();
+}
+//---------------------------------------
+bool Thread::Joinable()
+{
+	return mPDIThread->Joinable();
+}
+//---------------------------------------
+bool Thread::SetAffinity( uint64 cpuMask )
+{
+	return mPDIThread->SetAffinity( cpuMask );
+}
+//---------------------------------------
+void Thread::SetName( const char* name )
+{
+	mPDIThread->SetName( name );
+}
+//---------------------------------------
+void Thread::Sleep( unsigned long ms )
+{
+	// Like Sleep( 0 ) on Windows, give up the rest of our time slice
+	if ( ms == 0 )
+	{
+		sched_yield();
+		return;
+	}
+
+	timespec remaining;
+	remaining.tv_sec = ms / 1000;
+	remaining.tv_nsec = ( ms % 1000 ) * 1000000;
+	while ( nanosleep( &remaining, &remaining ) != 0 && errno == EINTR ) {}
+}
+//---------------------------------------
+unsigned int Thread::GetMaxThreadConcurrency()
+{
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? (unsigned int) count : 1;
+}
+//---------------------------------------
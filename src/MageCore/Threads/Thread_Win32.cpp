@@ -81,7 +81,42 @@ public:
 		return mThreadId;
 	}
 	//---------------------------------------
+	bool SetAffinity( uint64 cpuMask )
+	{
+		return SetThreadAffinityMask( mHandle, (DWORD_PTR) cpuMask ) != 0;
+	}
+	//---------------------------------------
+	void SetName( const char* name )
+	{
+		// The Visual Studio debugger names a thread when it sees this exception
+		THREADNAME_INFO info;
+		info.dwType = 0x1000;
+		info.szName = name;
+		info.dwThreadID = mThreadId;
+		info.dwFlags = 0;
+
+		__try
+		{
+			RaiseException( MS_VC_EXCEPTION, 0, sizeof( info ) / sizeof( ULONG_PTR ), (ULONG_PTR*) &info );
+		}
+		__except ( EXCEPTION_EXECUTE_HANDLER )
+		{
+		}
+	}
+	//---------------------------------------
 private:
+	static const DWORD MS_VC_EXCEPTION = 0x406D1388;
+
+#pragma pack( push, 8 )
+	struct THREADNAME_INFO
+	{
+		DWORD dwType;
+		LPCSTR szName;
+		DWORD dwThreadID;
+		DWORD dwFlags;
+	};
+#pragma pack( pop )
+
 	static unsigned int WINAPI _thread_wrapper_function( void* arg );
 
 	HANDLE mHandle;
@@ -105,6 +140,9 @@ unsigned int WINAPI ThreadWin32::_thread_wrapper_function( void* arg )
 		std::terminate();
 	}
 
+	FrameAllocator::ReleaseThreadFrames();
+	MemoryPool::ReleaseThreadCache();
+
 	info->TheThread->mMutex.Lock();
 	info->TheThread->mAlive = false;
 	info->TheThread->mMutex.Unlock();
@@ -136,6 +174,16 @@ bool Thread::Joinable()
 	return mPDIThread->Joinable();
 }
 //---------------------------------------
+bool Thread::SetAffinity( uint64 cpuMask )
+{
+	return mPDIThread->SetAffinity( cpuMask );
+}
+//---------------------------------------
+void Thread::SetName( const char* name )
+{
+	mPDIThread->SetName( name );
+}
+//---------------------------------------
 void Thread::Sleep( unsigned long ms )
 {
 	::Sleep( ms );
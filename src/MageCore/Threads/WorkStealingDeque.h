@@ -0,0 +1,145 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Fixed size lock-free work stealing deque (Chase-Lev).
+ *   One owner thread pushes and pops at the bottom, last in first out, so it
+ *   keeps working on what it just created while that data is still in cache.
+ *   Any other thread can steal from the top, oldest first. Owner operations
+ *   only synchronize with thieves when one item is left.
+ *   T must be a pointer or an integer no larger than a pointer.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename T >
+	class WorkStealingDeque
+	{
+	public:
+		// capacity is rounded up to a power of two
+		WorkStealingDeque( uint32 capacity=1024 );
+		~WorkStealingDeque();
+
+		// Owner only. Returns false if the deque is full.
+		bool Push( T item );
+		// Owner only. Take the newest item.
+		bool Pop( T& item );
+		// Any thread. Take the oldest item. Fails if empty or another thread took it first.
+		bool Steal( T& item );
+
+		// Only a snapshot while other threads are stealing
+		bool IsEmpty() const;
+
+	private:
+		WorkStealingDeque( const WorkStealingDeque& );
+		WorkStealingDeque& operator=( const WorkStealingDeque& );
+
+		// Positions only ever count up, differences are taken unsigned so they survive wrapping
+		static int32 Distance( int32 from, int32 to )	{ return (int32) ( (uint32) to - (uint32) from ); }
+
+		volatile T* mItems;
+		uint32 mMask;
+		uint8 mPad0[ CACHE_LINE_SIZE ];
+		volatile int32 mTop;			// Next to steal
+		uint8 mPad1[ CACHE_LINE_SIZE ];
+		volatile int32 mBottom;			// Next free, owner only writes this
+		uint8 mPad2[ CACHE_LINE_SIZE ];
+	};
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename T >
+	WorkStealingDeque< T >::WorkStealingDeque( uint32 capacity )
+		: mTop( 0 )
+		, mBottom( 0 )
+	{
+		uint32 size = 2;
+		while ( size < capacity )
+			size <<= 1;
+
+		mMask = size - 1;
+		mItems = new T[ size ];
+	}
+	//---------------------------------------
+	template< typename T >
+	WorkStealingDeque< T >::~WorkStealingDeque()
+	{
+		delete[] mItems;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool WorkStealingDeque< T >::Push( T item )
+	{
+		int32 b = mBottom;
+		int32 t = AtomicLoadAcquire( &mTop );
+		if ( Distance( t, b ) > (int32) mMask )
+		{
+			return false;
+		}
+
+		mItems[ b & mMask ] = item;
+		// Publish to thieves
+		AtomicStoreRelease( &mBottom, (int32) ( (uint32) b + 1 ) );
+		return true;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool WorkStealingDeque< T >::Pop( T& item )
+	{
+		// Claim the bottom item before looking at what thieves have taken
+		int32 b = (int32) ( (uint32) mBottom - 1 );
+		AtomicExchange( &mBottom, b );
+		int32 t = AtomicLoadAcquire( &mTop );
+
+		int32 size = Distance( t, b ) + 1;
+		if ( size <= 0 )
+		{
+			// Empty, undo the claim
+			AtomicStoreRelease( &mBottom, t );
+			return false;
+		}
+
+		item = mItems[ b & mMask ];
+		if ( size > 1 )
+		{
+			return true;
+		}
+
+		// Last item, race thieves for it through the top
+		bool won = AtomicCompareExchange( &mTop, (int32) ( (uint32) t + 1 ), t ) == t;
+		AtomicStoreRelease( &mBottom, (int32) ( (uint32) t + 1 ) );
+		return won;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool WorkStealingDeque< T >::Steal( T& item )
+	{
+		int32 t = AtomicLoadAcquire( &mTop );
+		// Read top before bottom, pairs with the exchange in Pop
+		AtomicThreadFence();
+		int32 b = AtomicLoadAcquire( &mBottom );
+
+		if ( Distance( t, b ) <= 0 )
+		{
+			return false;
+		}
+
+		// Read before claiming it, once top moves the owner may reuse the slot
+		item = mItems[ t & mMask ];
+		return AtomicCompareExchange( &mTop, (int32) ( (uint32) t + 1 ), t ) == t;
+	}
+	//---------------------------------------
+	template< typename T >
+	bool WorkStealingDeque< T >::IsEmpty() const
+	{
+		return Distance( AtomicLoadAcquire( &mTop ), AtomicLoadAcquire( &mBottom ) ) <= 0;
+	}
+	//---------------------------------------
+
+}
@@ -7,6 +7,10 @@
  
 #pragma once
 
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif
+
 namespace mage
 {
 
@@ -39,5 +43,29 @@ namespace mage
 		n ^= 1 << bit;
 	}
 	//---------------------------------------
+	// Index of the lowest set bit, n must not be 0
+	inline int LowestBitSet( uint32 n )
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward( &index, n );
+		return (int) index;
+#else
+		return __builtin_ctz( n );
+#endif
+	}
+	//---------------------------------------
+	// Index of the highest set bit, n must not be 0
+	inline int HighestBitSet( uint32 n )
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse( &index, n );
+		return (int) index;
+#else
+		return 31 - __builtin_clz( n );
+#endif
+	}
+	//---------------------------------------
 
 }
\ No newline at end of file
@@ -13,4 +13,139 @@ extern "C" unsigned int GenerateHash( const char* str )
 		++str;
 	}
 	return hash;
-}
\ No newline at end of file
+}
+
+//---------------------------------------
+// CRC-32C
+//---------------------------------------
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#	define MAGE_CRC32C_SSE42
+#	include <nmmintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#		define CRC32C_TARGET
+#	else
+#		include <cpuid.h>
+#		define CRC32C_TARGET __attribute__( ( target( "sse4.2" ) ) )
+#	endif
+#endif
+
+namespace
+{
+	const uint32 CRC32C_POLY = 0x82F63B78;		// Reversed Castagnoli polynomial
+
+	// Slicing-by-8 tables, Table[k][b] is the crc of byte b followed by k zero bytes
+	struct Crc32cTables
+	{
+		uint32 Table[8][256];
+		bool HasSSE42;
+
+		Crc32cTables()
+		{
+			for ( uint32 b = 0; b < 256; ++b )
+			{
+				uint32 crc = b;
+				for ( int i = 0; i < 8; ++i )
+				{
+					crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? CRC32C_POLY : 0 );
+				}
+				Table[0][b] = crc;
+			}
+			for ( uint32 b = 0; b < 256; ++b )
+			{
+				for ( int k = 1; k < 8; ++k )
+				{
+					Table[k][b] = ( Table[k-1][b] >> 8 ) ^ Table[0][ Table[k-1][b] & 0xFF ];
+				}
+			}
+
+			HasSSE42 = false;
+#if defined( MAGE_CRC32C_SSE42 ) && defined( _MSC_VER )
+			int info[4];
+			__cpuid( info, 1 );
+			HasSSE42 = ( info[2] & ( 1 << 20 ) ) != 0;
+#elif defined( MAGE_CRC32C_SSE42 )
+			unsigned int a, b, c, d;
+			HasSSE42 = __get_cpuid( 1, &a, &b, &c, &d ) && ( c & bit_SSE4_2 ) != 0;
+#endif
+		}
+	};
+
+	// Built before main so lookups never race
+	const Crc32cTables gCrc32c;
+
+	//---------------------------------------
+	uint32 Crc32cTable( const uint8* p, int size, uint32 crc )
+	{
+		const uint32 (*t)[256] = gCrc32c.Table;
+
+		while ( size >= 8 )
+		{
+			uint32 lo = crc ^ ( p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32) p[3] << 24 ) );
+			uint32 hi = p[4] | ( p[5] << 8 ) | ( p[6] << 16 ) | ( (uint32) p[7] << 24 );
+			crc = t[7][ lo & 0xFF ] ^ t[6][ ( lo >> 8 ) & 0xFF ] ^ t[5][ ( lo >> 16 ) & 0xFF ] ^ t[4][ lo >> 24 ]
+				^ t[3][ hi & 0xFF ] ^ t[2][ ( hi >> 8 ) & 0xFF ] ^ t[1][ ( hi >> 16 ) & 0xFF ] ^ t[0][ hi >> 24 ];
+			p += 8;
+			size -= 8;
+		}
+		while ( size-- > 0 )
+		{
+			crc = ( crc >> 8 ) ^ t[0][ ( crc ^ *p++ ) & 0xFF ];
+		}
+		return crc;
+	}
+	//---------------------------------------
+#ifdef MAGE_CRC32C_SSE42
+	CRC32C_TARGET uint32 Crc32cSSE42( const uint8* p, int size, uint32 crc )
+	{
+		// Bytes up to alignment, then whole words
+		while ( size > 0 && ( (size_t) p & 3 ) != 0 )
+		{
+			crc = _mm_crc32_u8( crc, *p++ );
+			--size;
+		}
+#	if defined( _M_X64 ) || defined( __x86_64__ )
+		uint64 crc64 = crc;
+		while ( size >= 8 )
+		{
+			crc64 = _mm_crc32_u64( crc64, *(const uint64*) p );
+			p += 8;
+			size -= 8;
+		}
+		crc = (uint32) crc64;
+#	endif
+		while ( size >= 4 )
+		{
+			crc = _mm_crc32_u32( crc, *(const uint32*) p );
+			p += 4;
+			size -= 4;
+		}
+		while ( size-- > 0 )
+		{
+			crc = _mm_crc32_u8( crc, *p++ );
+		}
+		return crc;
+	}
+#endif
+	//---------------------------------------
+}
+
+//---------------------------------------
+uint32 mage::Crc32c( const void* data, int size, uint32 crc )
+{
+	const uint8* p = (const uint8*) data;
+	crc = ~crc;
+#ifdef MAGE_CRC32C_SSE42
+	if ( gCrc32c.HasSSE42 )
+	{
+		return ~Crc32cSSE42( p, size, crc );
+	}
+#endif
+	return ~Crc32cTable( p, size, crc );
+}
+//---------------------------------------
+bool mage::Crc32cIsHardwareAccelerated()
+{
+	return gCrc32c.HasSSE42;
+}
+//---------------------------------------
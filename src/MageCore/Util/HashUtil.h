@@ -10,4 +10,9 @@
 namespace mage
 {
 	extern "C" unsigned int GenerateHash( const char* str );
+
+	// CRC-32C (Castagnoli) of size bytes. Pass a previous result as crc to continue it over more data.
+	// Uses the SSE4.2 crc32 instruction when the CPU has it.
+	uint32 Crc32c( const void* data, int size, uint32 crc=0 );
+	bool Crc32cIsHardwareAccelerated();
 }
\ No newline at end of file
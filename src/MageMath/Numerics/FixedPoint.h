@@ -500,31 +500,76 @@ namespace mage
 			return (bool) mValue;
 		}
 
-		template<
-			typename base_type,
-			unsigned char ibits,
-			unsigned char fbits >
-		friend FixedPoint< base_type, ibits, fbits > sin( const FixedPoint< base_type, ibits, fbits >& angle )
-		{
-			//float x = (float) angle;
-			//x = std::fmod( x + Mathf::PI, Mathf::TWO_PI ) - Mathf::PI;
-			//static const float B = 4.0f / Mathf::PI;
-			//static const float C = -4.0f / ( Mathf::PI * Mathf::PI );
-			//float y = B * x + C * x * std::abs( x );
-			//static const float P = 0.255f;
-			//return FixedPoint< base_type, ibits, fbits >( P * ( y * std::abs( y ) - y ) + y );
-			// shits fast as hell yo
-			return std::sin( (float) angle );
+		// Raw bits (ie. for hashing or sending over the network)
+		base_type GetRaw() const { return mValue; }
+		static FixedPoint FromRaw( base_type raw ) { return FixedPoint( _INTERNAL_, raw ); }
+
+		//---------------------------------------
+		// Math functions below only use integer ops so results are bit identical
+		// on every compiler and CPU, which lockstep simulations depend on.
+		// sin/cos need enough integer bits to hold 2 PI.
+		//---------------------------------------
+		friend FixedPoint abs( const FixedPoint& x )
+		{
+			return x.mValue < 0 ? -x : x;
 		}
 
-		template<
-			typename base_type,
-			unsigned char ibits,
-			unsigned char fbits >
-			friend FixedPoint< base_type, ibits, fbits > cos( const FixedPoint< base_type, ibits, fbits >& angle )
+		friend FixedPoint sin( const FixedPoint& angle )
 		{
-			// Not even gonna try after failing at sin
-			return std::cos( (float) angle );
+			static const FixedPoint PI( 3.14159265358979 );
+			static const FixedPoint TWO_PI( 6.28318530717959 );
+			static const FixedPoint B( 1.27323954473516 );		// 4 / PI
+			static const FixedPoint C( -0.405284734569351 );	// -4 / PI^2
+			static const FixedPoint P( 0.225 );
+
+			// Wrap to [-PI, PI)
+			base_type wrapped = ( angle.mValue + PI.mValue ) % TWO_PI.mValue;
+			if ( wrapped < 0 )
+				wrapped += TWO_PI.mValue;
+			FixedPoint x = FromRaw( wrapped ) - PI;
+
+			// Parabola through the peaks and zeros, then a correction pass (max error ~0.001)
+			FixedPoint y = B * x + C * x * abs( x );
+			return P * ( y * abs( y ) - y ) + y;
+		}
+
+		friend FixedPoint cos( const FixedPoint& angle )
+		{
+			static const FixedPoint HALF_PI( 1.57079632679490 );
+			return sin( angle + HALF_PI );
+		}
+
+		// 0 for negative values
+		friend FixedPoint sqrt( const FixedPoint& x )
+		{
+			typedef typename TypePromotion< base_type >::type promoted_type;
+
+			// Before the shift, shifting a negative value is undefined
+			if ( x.mValue <= 0 )
+				return FixedPoint();
+
+			// sqrt( v / 2^f ) * 2^f = sqrt( v * 2^f )
+			promoted_type n = PromoteType( x.mValue ) << fbits;
+			promoted_type result = 0;
+			promoted_type bit = (promoted_type) 1 << ( sizeof( promoted_type ) * 8 - 2 );
+
+			// Digit by digit integer square root
+			while ( bit > n )
+				bit >>= 2;
+			while ( bit )
+			{
+				if ( n >= result + bit )
+				{
+					n -= result + bit;
+					result = ( result >> 1 ) + bit;
+				}
+				else
+				{
+					result >>= 1;
+				}
+				bit >>= 2;
+			}
+			return FromRaw( (base_type) result );
 		}
 
 	private:
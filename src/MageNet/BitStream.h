@@ -0,0 +1,211 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Bit level writer/reader over a fixed size byte buffer.
+ *   Bits are packed LSB first through a 64 bit scratch word.
+ *   Writing or reading past the end of the buffer sets an overflow flag
+ *   instead of touching memory.
+ *   Also byte aligned varint helpers for headers and file formats.
+ */
+ 
+#pragma once
+
+namespace mage
+{
+
+	//---------------------------------------
+	// Compile time number of bits needed to store values in [0,N]
+	//---------------------------------------
+	template< uint32 N >
+	struct BitsRequired
+	{
+		enum { VALUE = BitsRequired< ( N >> 1 ) >::VALUE + 1 };
+	};
+	template<>
+	struct BitsRequired< 0 >
+	{
+		enum { VALUE = 0 };
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Byte aligned varints (little endian base 128)
+	//---------------------------------------
+
+	// Returns bytes written (1-5)
+	inline int WriteVarUInt( uint8* dest, uint32 value );
+	// Returns bytes read or 0 if src ends before the varint does
+	inline int ReadVarUInt( const uint8* src, int size, uint32& value );
+
+	// Map signed to unsigned so small negative numbers stay small
+	inline uint32 ZigZagEncode( int32 value )		{ return ( (uint32) value << 1 ) ^ (uint32) ( value >> 31 ); }
+	inline int32 ZigZagDecode( uint32 value )		{ return (int32) ( value >> 1 ) ^ -(int32) ( value & 1 ); }
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class BitWriter
+	{
+	public:
+		BitWriter( uint8* buffer, int sizeBytes );
+
+		// Write the low bits of value (0-32 bits)
+		inline void WriteBits( uint32 value, int bits );
+		// Write out any partial byte. Call once when done writing.
+		inline void Flush();
+
+		int GetBitsWritten() const						{ return mBitsWritten; }
+		int GetBytesWritten() const						{ return ( mBitsWritten + 7 ) / 8; }
+		bool IsOverflow() const							{ return mOverflow; }
+
+	private:
+		uint8* mBuffer;
+		int mSizeBits;
+		int mBytePos;
+		int mBitsWritten;
+		uint64 mScratch;
+		int mScratchBits;
+		bool mOverflow;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class BitReader
+	{
+	public:
+		BitReader( const uint8* data, int sizeBytes );
+
+		// Read bits (0-32) into value. Returns false if there is not enough data.
+		inline bool ReadBits( uint32& value, int bits );
+
+		int GetBitsRead() const							{ return mBitsRead; }
+		int GetBytesRead() const						{ return ( mBitsRead + 7 ) / 8; }
+		bool IsOverflow() const							{ return mOverflow; }
+
+	private:
+		const uint8* mData;
+		int mSizeBits;
+		int mBytePos;
+		int mBitsRead;
+		uint64 mScratch;
+		int mScratchBits;
+		bool mOverflow;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	inline int WriteVarUInt( uint8* dest, uint32 value )
+	{
+		int n = 0;
+		while ( value >= 0x80 )
+		{
+			dest[ n++ ] = (uint8) ( value | 0x80 );
+			value >>= 7;
+		}
+		dest[ n++ ] = (uint8) value;
+		return n;
+	}
+	//---------------------------------------
+	inline int ReadVarUInt( const uint8* src, int size, uint32& value )
+	{
+		value = 0;
+		for ( int n = 0; n < size && n < 5; ++n )
+		{
+			value |= (uint32) ( src[n] & 0x7F ) << ( 7 * n );
+			if ( ( src[n] & 0x80 ) == 0 )
+				return n + 1;
+		}
+		return 0;
+	}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	inline BitWriter::BitWriter( uint8* buffer, int sizeBytes )
+		: mBuffer( buffer )
+		, mSizeBits( sizeBytes * 8 )
+		, mBytePos( 0 )
+		, mBitsWritten( 0 )
+		, mScratch( 0 )
+		, mScratchBits( 0 )
+		, mOverflow( false )
+	{}
+	//---------------------------------------
+	inline void BitWriter::WriteBits( uint32 value, int bits )
+	{
+		if ( mOverflow || mBitsWritten + bits > mSizeBits )
+		{
+			mOverflow = true;
+			return;
+		}
+
+		uint64 mask = ( (uint64) 1 << bits ) - 1;
+		mScratch |= ( value & mask ) << mScratchBits;
+		mScratchBits += bits;
+		mBitsWritten += bits;
+
+		while ( mScratchBits >= 8 )
+		{
+			mBuffer[ mBytePos++ ] = (uint8) mScratch;
+			mScratch >>= 8;
+			mScratchBits -= 8;
+		}
+	}
+	//---------------------------------------
+	inline void BitWriter::Flush()
+	{
+		if ( mScratchBits > 0 )
+		{
+			mBuffer[ mBytePos++ ] = (uint8) mScratch;
+			mScratch = 0;
+			mScratchBits = 0;
+		}
+	}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	inline BitReader::BitReader( const uint8* data, int sizeBytes )
+		: mData( data )
+		, mSizeBits( sizeBytes * 8 )
+		, mBytePos( 0 )
+		, mBitsRead( 0 )
+		, mScratch( 0 )
+		, mScratchBits( 0 )
+		, mOverflow( false )
+	{}
+	//---------------------------------------
+	inline bool BitReader::ReadBits( uint32& value, int bits )
+	{
+		if ( mOverflow || mBitsRead + bits > mSizeBits )
+		{
+			mOverflow = true;
+			value = 0;
+			return false;
+		}
+
+		while ( mScratchBits < bits )
+		{
+			mScratch |= (uint64) mData[ mBytePos++ ] << mScratchBits;
+			mScratchBits += 8;
+		}
+
+		uint64 mask = ( (uint64) 1 << bits ) - 1;
+		value = (uint32) ( mScratch & mask );
+		mScratch >>= bits;
+		mScratchBits -= bits;
+		mBitsRead += bits;
+
+		return true;
+	}
+	//---------------------------------------
+
+}
\ No newline at end of file
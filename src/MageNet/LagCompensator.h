@@ -0,0 +1,174 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Server side lag compensation.
+ *   Keeps a fixed length ring of past entity positions, one frame per tick,
+ *   so hit tests can be evaluated as of the time a client saw the world.
+ *   Positions for a tick are stored contiguously and all memory is
+ *   allocated up front.
+ *   TPosition needs +, - and * float (ie. Vec2f, Vec3f).
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename TPosition >
+	class LagCompensator
+	{
+	public:
+		LagCompensator( int maxEntities, int historyLength=64 );
+		~LagCompensator();
+
+		// Start a new tick at time (sec). All entities start out as not present.
+		void BeginTick( double time );
+		// Record an entity's position for the current tick
+		void Record( int entity, const TPosition& position );
+		// Forget all history
+		void Clear();
+
+		// Position of entity as of time, interpolated between recorded ticks.
+		// Times outside the history are clamped to the oldest/newest tick.
+		// Returns false if the entity was not present.
+		bool GetPositionAt( int entity, double time, TPosition& out ) const;
+
+		double GetOldestTime() const;
+		double GetNewestTime() const;
+		int GetNumTicks() const								{ return mNumTicks; }
+
+	private:
+		int Slot( int tick ) const							{ return ( mFirstTick + tick ) % mHistoryLength; }
+		int Index( int tick, int entity ) const				{ return Slot( tick ) * mMaxEntities + entity; }
+
+		int mMaxEntities;
+		int mHistoryLength;
+		int mFirstTick;							// Slot of the oldest tick
+		int mNumTicks;
+
+		std::vector< double > mTimes;			// Time of each slot
+		std::vector< TPosition > mPositions;	// [slot][entity]
+		std::vector< uint8 > mPresent;			// [slot][entity]
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename TPosition >
+	LagCompensator< TPosition >::LagCompensator( int maxEntities, int historyLength )
+		: mMaxEntities( maxEntities )
+		, mHistoryLength( historyLength )
+		, mFirstTick( 0 )
+		, mNumTicks( 0 )
+		, mTimes( historyLength )
+		, mPositions( historyLength * maxEntities )
+		, mPresent( historyLength * maxEntities )
+	{}
+	//---------------------------------------
+	template< typename TPosition >
+	LagCompensator< TPosition >::~LagCompensator()
+	{}
+	//---------------------------------------
+	template< typename TPosition >
+	void LagCompensator< TPosition >::BeginTick( double time )
+	{
+		// Full, drop the oldest tick
+		if ( mNumTicks == mHistoryLength )
+		{
+			mFirstTick = ( mFirstTick + 1 ) % mHistoryLength;
+			--mNumTicks;
+		}
+
+		int slot = Slot( mNumTicks++ );
+		mTimes[ slot ] = time;
+		memset( &mPresent[ slot * mMaxEntities ], 0, mMaxEntities );
+	}
+	//---------------------------------------
+	template< typename TPosition >
+	void LagCompensator< TPosition >::Record( int entity, const TPosition& position )
+	{
+		int index = Index( mNumTicks - 1, entity );
+		mPositions[ index ] = position;
+		mPresent[ index ] = 1;
+	}
+	//---------------------------------------
+	template< typename TPosition >
+	void LagCompensator< TPosition >::Clear()
+	{
+		mFirstTick = 0;
+		mNumTicks = 0;
+	}
+	//---------------------------------------
+	template< typename TPosition >
+	bool LagCompensator< TPosition >::GetPositionAt( int entity, double time, TPosition& out ) const
+	{
+		if ( mNumTicks == 0 )
+		{
+			return false;
+		}
+
+		// Clamp to the history we have
+		int tick = -1;
+		if ( time >= mTimes[ Slot( mNumTicks - 1 ) ] )
+		{
+			tick = mNumTicks - 1;
+		}
+		else if ( time <= mTimes[ Slot( 0 ) ] )
+		{
+			tick = 0;
+		}
+		if ( tick >= 0 )
+		{
+			int index = Index( tick, entity );
+			out = mPositions[ index ];
+			return mPresent[ index ] != 0;
+		}
+
+		// Binary search for the ticks a, a+1 bracketing time
+		int lo = 0;
+		int hi = mNumTicks - 1;
+		while ( hi - lo > 1 )
+		{
+			int mid = ( lo + hi ) / 2;
+			if ( mTimes[ Slot( mid ) ] <= time )
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		int a = Index( lo, entity );
+		int b = Index( hi, entity );
+
+		// Entity joined or left between the ticks, use whichever side has it
+		if ( !mPresent[ a ] || !mPresent[ b ] )
+		{
+			out = mPresent[ a ] ? mPositions[ a ] : mPositions[ b ];
+			return mPresent[ a ] || mPresent[ b ];
+		}
+
+		double timeA = mTimes[ Slot( lo ) ];
+		double timeB = mTimes[ Slot( hi ) ];
+		float t = (float) ( ( time - timeA ) / ( timeB - timeA ) );
+		out = mPositions[ a ] + ( mPositions[ b ] - mPositions[ a ] ) * t;
+		return true;
+	}
+	//---------------------------------------
+	template< typename TPosition >
+	double LagCompensator< TPosition >::GetOldestTime() const
+	{
+		return mNumTicks ? mTimes[ Slot( 0 ) ] : 0.0;
+	}
+	//---------------------------------------
+	template< typename TPosition >
+	double LagCompensator< TPosition >::GetNewestTime() const
+	{
+		return mNumTicks ? mTimes[ Slot( mNumTicks - 1 ) ] : 0.0;
+	}
+	//---------------------------------------
+
+}
@@ -2,6 +2,31 @@
 
 using namespace mage;
 
+//---------------------------------------
+namespace mage
+{
+
+	struct PendingConnect
+	{
+		NetSession* Session;
+		NetManager::ResolveHostCB Callback;
+		void* UserData;
+	};
+
+	static void OnConnectHostResolved( bool success, IPaddress address, void* userData )
+	{
+		PendingConnect* pending = (PendingConnect*) userData;
+		if ( success )
+		{
+			pending->Session->SendConnectMessage( address );
+		}
+		pending->Callback( success, address, pending->UserData );
+		delete pending;
+	}
+
+}
+//---------------------------------------
+
 //---------------------------------------
 LocalClient::LocalClient()
 {}
@@ -24,9 +49,9 @@ void LocalClient::SendData( PacketWriter& writer, SendDataOpts opts )
 	mSession->SendData( writer, opts );
 }
 //---------------------------------------
-void LocalClient::SendData( PacketWriter& writer, IPaddress& to, SendDataOpts opts )
+void LocalClient::SendData( PacketWriter& writer, IPaddress& to, SendDataOpts opts, bool clearOnSend )
 {
-	mSession->SendData( writer, to, opts );
+	mSession->SendData( writer, to, opts, clearOnSend );
 }
 //---------------------------------------
 IPaddress LocalClient::ConnectTo( const char* ip, uint16 port )
@@ -40,6 +65,18 @@ IPaddress LocalClient::ConnectTo( const char* ip, uint16 port )
 	return addr;
 }
 //---------------------------------------
+void LocalClient::ConnectToAsync( const char* host, uint16 port, NetManager::ResolveHostCB callback, void* userData )
+{
+	// Listen on any port
+	mSession->OpenPort( 0 );
+
+	PendingConnect* pending = new PendingConnect;
+	pending->Session = mSession;
+	pending->Callback = callback;
+	pending->UserData = userData;
+	NetManager::ResolveHostAsync( host, port, OnConnectHostResolved, pending );
+}
+//---------------------------------------
 void LocalClient::Disconnect()
 {
 	mSession->DropAllClients();
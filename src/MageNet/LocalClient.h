@@ -21,10 +21,13 @@ namespace mage
 		void ReceiveData( PacketReader& reader, NetClient& sender );
 		// Send data to all netclients
 		void SendData( PacketWriter& writer, SendDataOpts opts=SENDOPT_NONE );
-		// Send data to specific netclient
-		void SendData( PacketWriter& writer, IPaddress& to, SendDataOpts opts=SENDOPT_NONE );
+		// Send data to specific netclient. Keep the data to send it to more clients with clearOnSend=false.
+		void SendData( PacketWriter& writer, IPaddress& to, SendDataOpts opts=SENDOPT_NONE, bool clearOnSend=true );
 		// Establish a connection to a server
 		IPaddress ConnectTo( const char* ip, uint16 port );
+		// Establish a connection to a server without blocking on the host lookup.
+		// callback is fired once the connect message is sent or the lookup failed.
+		void ConnectToAsync( const char* host, uint16 port, NetManager::ResolveHostCB callback, void* userData=NULL );
 		// Disconnect if connected to server
 		void Disconnect();
 
@@ -0,0 +1,475 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Deterministic lockstep simulation with rollback.
+ *   Peers only exchange per-tick input. Every peer runs the same simulation
+ *   on the same inputs, so the state never has to be sent. This only works
+ *   if the simulate function is bit for bit deterministic, so use FixedPoint
+ *   (not float) for anything that feeds back into the state.
+ *   Remote input that hasn't arrived is predicted by repeating the player's
+ *   last input. When the real input turns out different, the state is
+ *   restored to that tick and the ticks since are simulated again.
+ *   State is saved every tick by copying it, so TState and TInput must be
+ *   POD and fully initialized, padding included (memset them before use).
+ *   A checksum of each final state is sent along with the input so peers can
+ *   detect a desync.
+ *
+ *   Input wire format:
+ *     uint8  Player
+ *     int32  First tick
+ *     uint8  Count
+ *     TInput Inputs[ Count ]
+ *     int32  Tick input is known up to for each player (acks)
+ *     int32  Checksum tick, -1 for none
+ *     uint32 Checksum
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename TInput, typename TState >
+	class LockstepSimulation
+	{
+	public:
+		// Advance state by one tick. inputs has one input per player.
+		typedef void(*SimulateFn)( TState& state, const TInput* inputs, int numPlayers );
+
+		enum { MAX_PLAYERS = 32 };
+
+		// All peers must use the same initial state and input delay.
+		// inputDelay gives remote input time to arrive before it's needed, maxPrediction is how
+		// many ticks we can run ahead of the slowest player before stalling.
+		LockstepSimulation( SimulateFn simulate, int numPlayers, int localPlayer, const TState& initialState,
+			int inputDelay=2, int maxPrediction=8 );
+		~LockstepSimulation();
+
+		// Set the local player's input. Call once per tick before Advance.
+		// It's applied inputDelay ticks from now.
+		void AddLocalInput( const TInput& input );
+		// Input from a remote player. Returns false if the tick is outside the window we keep.
+		bool AddRemoteInput( int player, int32 tick, const TInput& input );
+		// Simulate one tick, rolling back first if remote input changed the past.
+		// Returns false without simulating if we are too far ahead of the slowest player.
+		bool Advance();
+
+		// Local inputs not acked by every peer, plus acks and our newest checksum.
+		// Send this to every other peer each tick.
+		void WriteInputs( PacketWriter& writer ) const;
+		// Inputs written by another peer with WriteInputs
+		bool ReadInputs( PacketReader& reader );
+
+		const TState& GetState() const						{ return mState; }
+		// Next tick to simulate
+		int32 GetCurrentTick() const						{ return mCurrentTick; }
+		// Newest tick with input from every player
+		int32 GetConfirmedTick() const;
+		int GetNumPlayers() const							{ return mNumPlayers; }
+		int GetLocalPlayer() const							{ return mLocalPlayer; }
+		int GetNumRollbacks() const							{ return mNumRollbacks; }
+		int GetNumResimulatedTicks() const					{ return mNumResimulated; }
+		// A peer's state checksum didn't match ours. The simulation is not deterministic.
+		bool IsDesynced() const								{ return mDesyncTick >= 0; }
+		int32 GetDesyncTick() const							{ return mDesyncTick; }
+
+		// Checksum of a state, the one peers compare to detect a desync
+		static uint32 HashState( const TState& state );
+
+	private:
+		enum
+		{
+			HISTORY = 128,					// Ticks kept for rollback and early input, power of 2
+			MAX_INPUTS_PER_MESSAGE = 64,
+			NO_ROLLBACK = 0x7FFFFFFF,
+		};
+
+		struct Frame
+		{
+			int32 Tick;
+			uint32 Confirmed;				// Players whose input for the tick is known
+			uint32 Checksum;				// Of State, valid once Tick <= mChecksumTick
+			TState State;					// State at the start of the tick
+		};
+
+		int Slot( int32 tick ) const						{ return tick & ( HISTORY - 1 ); }
+		// Frame for tick, reset if the slot holds an older tick
+		Frame& GetFrame( int32 tick );
+		TInput& GetInput( int32 tick, int player )			{ return mInputs[ Slot( tick ) * mNumPlayers + player ]; }
+		const TInput& GetInput( int32 tick, int player ) const	{ return mInputs[ Slot( tick ) * mNumPlayers + player ]; }
+		bool SetInput( int player, int32 tick, const TInput& input );
+		void SimulateTick();
+		// Checksum states that can no longer change and compare them to the remote checksums
+		void UpdateChecksums();
+
+		SimulateFn mSimulate;
+		int mNumPlayers;
+		int mLocalPlayer;
+		int mInputDelay;
+		int mMaxPrediction;
+
+		TState mState;						// State at the start of mCurrentTick
+		int32 mCurrentTick;
+		int32 mRollbackTick;				// Oldest tick simulated with a wrong prediction
+		int32 mLastLocalTick;				// Tick of the newest local input
+		int32 mChecksumTick;				// Newest tick with a final checksum
+
+		std::vector< Frame > mFrames;
+		std::vector< TInput > mInputs;		// [slot][player]
+		TInput mNoInput;					// Zeroed
+
+		std::vector< int32 > mPlayerConfirmed;		// Each player's input is known up to this tick
+		std::vector< int32 > mAckedLocal;			// Each player has our input up to this tick
+		std::vector< int32 > mRemoteChecksumTick;	// Checksums waiting for us to reach their tick
+		std::vector< uint32 > mRemoteChecksum;
+
+		int32 mDesyncTick;
+		int mNumRollbacks;
+		int mNumResimulated;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	LockstepSimulation< TInput, TState >::LockstepSimulation( SimulateFn simulate, int numPlayers, int localPlayer,
+		const TState& initialState, int inputDelay, int maxPrediction )
+		: mSimulate( simulate )
+		, mNumPlayers( Mathi::Clamp( numPlayers, 1, MAX_PLAYERS ) )
+		, mLocalPlayer( localPlayer )
+		, mInputDelay( Mathi::Clamp( inputDelay, 0, HISTORY / 4 ) )
+		, mMaxPrediction( Mathi::Clamp( maxPrediction, 0, HISTORY / 4 ) )
+		, mCurrentTick( 0 )
+		, mRollbackTick( NO_ROLLBACK )
+		, mChecksumTick( -1 )
+		, mFrames( HISTORY )
+		, mInputs( HISTORY * mNumPlayers )
+		, mPlayerConfirmed( mNumPlayers )
+		, mAckedLocal( mNumPlayers )
+		, mRemoteChecksumTick( mNumPlayers, -1 )
+		, mRemoteChecksum( mNumPlayers )
+		, mDesyncTick( -1 )
+		, mNumRollbacks( 0 )
+		, mNumResimulated( 0 )
+	{
+		memcpy( &mState, &initialState, sizeof( TState ) );
+		memset( &mNoInput, 0, sizeof( TInput ) );
+
+		for ( int i = 0; i < HISTORY; ++i )
+		{
+			mFrames[i].Tick = -1;
+		}
+
+		// Nobody has input for the first inputDelay ticks, they are empty for everyone
+		uint32 allPlayers = mNumPlayers == 32 ? 0xFFFFFFFF : ( 1u << mNumPlayers ) - 1;
+		for ( int32 tick = 0; tick < mInputDelay; ++tick )
+		{
+			GetFrame( tick ).Confirmed = allPlayers;
+			for ( int p = 0; p < mNumPlayers; ++p )
+			{
+				memcpy( &GetInput( tick, p ), &mNoInput, sizeof( TInput ) );
+			}
+		}
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			mPlayerConfirmed[p] = mInputDelay - 1;
+			mAckedLocal[p] = mInputDelay - 1;
+		}
+		mLastLocalTick = mInputDelay - 1;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	LockstepSimulation< TInput, TState >::~LockstepSimulation()
+	{}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	void LockstepSimulation< TInput, TState >::AddLocalInput( const TInput& input )
+	{
+		// Already have input this far ahead (ie. called while stalled)
+		if ( mLastLocalTick >= mCurrentTick + mInputDelay )
+		{
+			return;
+		}
+
+		// Always the next tick so a missed call doesn't leave a hole peers would wait on forever
+		if ( SetInput( mLocalPlayer, mLastLocalTick + 1, input ) )
+		{
+			++mLastLocalTick;
+		}
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool LockstepSimulation< TInput, TState >::AddRemoteInput( int player, int32 tick, const TInput& input )
+	{
+		if ( player < 0 || player >= mNumPlayers || player == mLocalPlayer )
+		{
+			return false;
+		}
+		return SetInput( player, tick, input );
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool LockstepSimulation< TInput, TState >::Advance()
+	{
+		// Replay from the oldest mispredicted tick with the input we have now
+		if ( mRollbackTick < mCurrentTick )
+		{
+			int32 target = mCurrentTick;
+			++mNumRollbacks;
+			mNumResimulated += target - mRollbackTick;
+
+			memcpy( &mState, &mFrames[ Slot( mRollbackTick ) ].State, sizeof( TState ) );
+			mCurrentTick = mRollbackTick;
+			while ( mCurrentTick < target )
+			{
+				SimulateTick();
+			}
+		}
+		mRollbackTick = NO_ROLLBACK;
+
+		UpdateChecksums();
+
+		// Too far ahead, wait for the slowest player to catch up
+		if ( mCurrentTick - GetConfirmedTick() > mMaxPrediction )
+		{
+			return false;
+		}
+
+		SimulateTick();
+		return true;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	void LockstepSimulation< TInput, TState >::WriteInputs( PacketWriter& writer ) const
+	{
+		// Resend everything a peer hasn't acked yet
+		int32 first = mLastLocalTick + 1;
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			if ( p != mLocalPlayer )
+			{
+				first = Mathi::Min( first, mAckedLocal[p] + 1 );
+			}
+		}
+		first = Mathi::Max( first, Mathi::Max( mCurrentTick - HISTORY / 2 + 1, 0 ) );
+		int count = Mathi::Min( mLastLocalTick - first + 1, (int32) MAX_INPUTS_PER_MESSAGE );
+		count = Mathi::Max( count, 0 );
+
+		writer.Write( (uint8) mLocalPlayer );
+		writer.Write( first );
+		writer.Write( (uint8) count );
+		for ( int i = 0; i < count; ++i )
+		{
+			writer.WriteRaw( (const uint8*) &GetInput( first + i, mLocalPlayer ), sizeof( TInput ) );
+		}
+
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			writer.Write( mPlayerConfirmed[p] );
+		}
+
+		writer.Write( mChecksumTick );
+		writer.Write( mChecksumTick >= 0 ? mFrames[ Slot( mChecksumTick ) ].Checksum : 0 );
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool LockstepSimulation< TInput, TState >::ReadInputs( PacketReader& reader )
+	{
+		uint8 player;
+		int32 first;
+		uint8 count;
+		TInput input;
+
+		if ( !reader.ReadRaw( &player, 1 ) ||
+			 !reader.ReadRaw( (uint8*) &first, sizeof( first ) ) ||
+			 !reader.ReadRaw( &count, 1 ) )
+		{
+			return false;
+		}
+		if ( player >= mNumPlayers || player == mLocalPlayer )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "Lockstep : Input from invalid player %d\n", player );
+			return false;
+		}
+
+		for ( int i = 0; i < count; ++i )
+		{
+			if ( !reader.ReadRaw( (uint8*) &input, sizeof( TInput ) ) )
+			{
+				return false;
+			}
+			SetInput( player, first + i, input );
+		}
+
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			int32 ack;
+			if ( !reader.ReadRaw( (uint8*) &ack, sizeof( ack ) ) )
+			{
+				return false;
+			}
+			if ( p == mLocalPlayer )
+			{
+				mAckedLocal[ player ] = Mathi::Max( mAckedLocal[ player ], Mathi::Min( ack, mLastLocalTick ) );
+			}
+		}
+
+		int32 checksumTick;
+		uint32 checksum;
+		if ( !reader.ReadRaw( (uint8*) &checksumTick, sizeof( checksumTick ) ) ||
+			 !reader.ReadRaw( (uint8*) &checksum, sizeof( checksum ) ) )
+		{
+			return false;
+		}
+		if ( checksumTick > mRemoteChecksumTick[ player ] )
+		{
+			mRemoteChecksumTick[ player ] = checksumTick;
+			mRemoteChecksum[ player ] = checksum;
+		}
+
+		return true;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	int32 LockstepSimulation< TInput, TState >::GetConfirmedTick() const
+	{
+		int32 confirmed = mPlayerConfirmed[0];
+		for ( int p = 1; p < mNumPlayers; ++p )
+		{
+			confirmed = Mathi::Min( confirmed, mPlayerConfirmed[p] );
+		}
+		return confirmed;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	uint32 LockstepSimulation< TInput, TState >::HashState( const TState& state )
+	{
+		// FNV-1a
+		const uint8* bytes = (const uint8*) &state;
+		uint32 hash = 2166136261u;
+		for ( size_t i = 0; i < sizeof( TState ); ++i )
+		{
+			hash = ( hash ^ bytes[i] ) * 16777619u;
+		}
+		return hash;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	typename LockstepSimulation< TInput, TState >::Frame& LockstepSimulation< TInput, TState >::GetFrame( int32 tick )
+	{
+		Frame& frame = mFrames[ Slot( tick ) ];
+		if ( frame.Tick != tick )
+		{
+			frame.Tick = tick;
+			frame.Confirmed = 0;
+		}
+		return frame;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool LockstepSimulation< TInput, TState >::SetInput( int player, int32 tick, const TInput& input )
+	{
+		// Already have it
+		if ( tick <= mPlayerConfirmed[ player ] )
+		{
+			return true;
+		}
+		// Rollback can't reach past ticks outside the window, and future ones would overwrite them
+		if ( tick <= mCurrentTick - HISTORY / 2 || tick >= mCurrentTick + HISTORY / 2 )
+		{
+			return false;
+		}
+
+		uint32 bit = 1u << player;
+		Frame& frame = GetFrame( tick );
+		if ( frame.Confirmed & bit )
+		{
+			return true;
+		}
+
+		// Already simulated with a prediction, roll back if it was wrong
+		TInput& slot = GetInput( tick, player );
+		if ( tick < mCurrentTick && memcmp( &slot, &input, sizeof( TInput ) ) != 0 )
+		{
+			mRollbackTick = Mathi::Min( mRollbackTick, tick );
+		}
+		memcpy( &slot, &input, sizeof( TInput ) );
+		frame.Confirmed |= bit;
+
+		// Input can arrive out of order, confirmed only counts up to the first gap
+		for ( ;; )
+		{
+			int32 next = mPlayerConfirmed[ player ] + 1;
+			const Frame& nextFrame = mFrames[ Slot( next ) ];
+			if ( nextFrame.Tick != next || !( nextFrame.Confirmed & bit ) )
+			{
+				break;
+			}
+			mPlayerConfirmed[ player ] = next;
+		}
+
+		return true;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	void LockstepSimulation< TInput, TState >::SimulateTick()
+	{
+		int32 tick = mCurrentTick;
+		Frame& frame = GetFrame( tick );
+
+		// Predict missing input by repeating the previous tick's input
+		bool hasPrevious = mFrames[ Slot( tick - 1 ) ].Tick == tick - 1;
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			if ( !( frame.Confirmed & ( 1u << p ) ) )
+			{
+				memcpy( &GetInput( tick, p ), hasPrevious ? &GetInput( tick - 1, p ) : &mNoInput, sizeof( TInput ) );
+			}
+		}
+
+		// Save state so we can come back to this tick
+		memcpy( &frame.State, &mState, sizeof( TState ) );
+
+		mSimulate( mState, &GetInput( tick, 0 ), mNumPlayers );
+		++mCurrentTick;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	void LockstepSimulation< TInput, TState >::UpdateChecksums()
+	{
+		// The state at the start of a tick is final once input for every tick before it is known.
+		// Frames only hold states of ticks already simulated.
+		int32 finalTick = Mathi::Min( GetConfirmedTick() + 1, mCurrentTick - 1 );
+		while ( mChecksumTick < finalTick )
+		{
+			++mChecksumTick;
+			Frame& frame = mFrames[ Slot( mChecksumTick ) ];
+			frame.Checksum = HashState( frame.State );
+		}
+
+		for ( int p = 0; p < mNumPlayers; ++p )
+		{
+			int32 tick = mRemoteChecksumTick[p];
+			if ( tick < 0 || tick > mChecksumTick )
+			{
+				continue;
+			}
+
+			// Compare if we still have the tick
+			const Frame& frame = mFrames[ Slot( tick ) ];
+			if ( frame.Tick == tick && frame.Checksum != mRemoteChecksum[p] && mDesyncTick < 0 )
+			{
+				mDesyncTick = tick;
+				ConsolePrintf( CONSOLE_ERROR, "Lockstep : Desync with player %d at tick %d\n", p, tick );
+			}
+			mRemoteChecksumTick[p] = -1;
+		}
+	}
+	//---------------------------------------
+
+}
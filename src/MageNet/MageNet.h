@@ -6,7 +6,18 @@
 #include "ByteBuffer.h"
 #include "PacketWriter.h"
 #include "PacketReader.h"
+#include "BitStream.h"
+#include "MessageSchema.h"
+
+#include "NetCapture.h"
 
 #include "NetClient.h"
 #include "LocalClient.h"
-#include "NetSession.h"
\ No newline at end of file
+#include "NetSession.h"
+
+#include "Prediction.h"
+#include "SnapshotInterpolator.h"
+#include "LagCompensator.h"
+#include "ReplicationManager.h"
+#include "Lockstep.h"
+#include "TickScheduler.h"
\ No newline at end of file
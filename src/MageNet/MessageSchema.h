@@ -0,0 +1,418 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Compile time message schemas.
+ *   A message is a plain struct with an ID and a Schema typedef listing its
+ *   fields and the codec used for each one. Codecs carry the value range and
+ *   precision as template arguments so the bit count of every field, and the
+ *   max size of the whole message, are known at compile time.
+ *   Encoding is fully inlined bit packing with no virtual calls. Decoding is
+ *   bounds checked and fails on truncated data, out of range values or a
+ *   different message's ID.
+ *
+ *   struct LocationMsg
+ *   {
+ *       enum { ID = 1 };
+ *       int index;
+ *       Vec2f pos;
+ *       typedef MessageSchema<
+ *           MessageField< LocationMsg, int, &LocationMsg::index, IntCodec< 0, 15 > >,
+ *           MessageField< LocationMsg, Vec2f, &LocationMsg::pos, Vec2Codec< FloatCodec< 0, 800, 8 >, FloatCodec< 0, 600, 8 > > >
+ *       > Schema;
+ *   };
+ *
+ *   writer.WriteMessage( msg );  reader.ReadMessage( msg );
+ *
+ *   List the messages that share a stream in MessageIDs to check their IDs
+ *   are unique, and use MessageInfo< LocationMsg >::MAX_BYTES for the most
+ *   WriteMessage can write.
+ */
+ 
+#pragma once
+
+namespace mage
+{
+
+	//---------------------------------------
+	// Codecs
+	//---------------------------------------
+
+	// Integer in [MIN,MAX]. Values outside the range are clamped when encoding.
+	template< int MIN, int MAX >
+	struct IntCodec
+	{
+		static_assert( MAX >= MIN, "IntCodec: MAX must be >= MIN" );
+		enum { RANGE = MAX - MIN, BITS = BitsRequired< RANGE >::VALUE };
+
+		template< typename T >
+		static void Encode( BitWriter& writer, T value )
+		{
+			int v = (int) value;
+			v = v < MIN ? MIN : ( v > MAX ? MAX : v );
+			writer.WriteBits( (uint32) ( v - MIN ), BITS );
+		}
+
+		template< typename T >
+		static bool Decode( BitReader& reader, T& value )
+		{
+			uint32 raw;
+			if ( !reader.ReadBits( raw, BITS ) || raw > (uint32) RANGE )
+				return false;
+			value = (T) ( MIN + (int) raw );
+			return true;
+		}
+	};
+	//---------------------------------------
+	// Low NUM_BITS bits of an unsigned integer, ie. wrapping sequence numbers
+	template< int NUM_BITS >
+	struct UIntCodec
+	{
+		static_assert( NUM_BITS > 0 && NUM_BITS <= 32, "UIntCodec: 1-32 bits" );
+		enum { BITS = NUM_BITS };
+
+		template< typename T >
+		static void Encode( BitWriter& writer, T value )
+		{
+			writer.WriteBits( (uint32) value, BITS );
+		}
+
+		template< typename T >
+		static bool Decode( BitReader& reader, T& value )
+		{
+			uint32 raw;
+			if ( !reader.ReadBits( raw, BITS ) )
+				return false;
+			value = (T) raw;
+			return true;
+		}
+	};
+	//---------------------------------------
+	struct BoolCodec
+	{
+		enum { BITS = 1 };
+
+		template< typename T >
+		static void Encode( BitWriter& writer, T value )
+		{
+			writer.WriteBits( value ? 1 : 0, 1 );
+		}
+
+		template< typename T >
+		static bool Decode( BitReader& reader, T& value )
+		{
+			uint32 raw;
+			if ( !reader.ReadBits( raw, 1 ) )
+				return false;
+			value = (T) raw;
+			return true;
+		}
+	};
+	//---------------------------------------
+	// Float in [MIN,MAX] quantized to 1/STEPS_PER_UNIT
+	template< int MIN, int MAX, int STEPS_PER_UNIT >
+	struct FloatCodec
+	{
+		static_assert( MAX > MIN && STEPS_PER_UNIT > 0, "FloatCodec: bad range" );
+		enum { RANGE = ( MAX - MIN ) * STEPS_PER_UNIT, BITS = BitsRequired< RANGE >::VALUE };
+
+		static void Encode( BitWriter& writer, float value )
+		{
+			float q = ( value - (float) MIN ) * (float) STEPS_PER_UNIT + 0.5f;
+			uint32 raw = q <= 0.0f ? 0 : ( q >= (float) RANGE ? (uint32) RANGE : (uint32) q );
+			writer.WriteBits( raw, BITS );
+		}
+
+		static bool Decode( BitReader& reader, float& value )
+		{
+			uint32 raw;
+			if ( !reader.ReadBits( raw, BITS ) || raw > (uint32) RANGE )
+				return false;
+			value = (float) MIN + (float) raw * ( 1.0f / (float) STEPS_PER_UNIT );
+			return true;
+		}
+	};
+	//---------------------------------------
+	// Angle in radians wrapped to [0,2pi) and quantized to 2^NUM_BITS steps
+	template< int NUM_BITS >
+	struct AngleCodec
+	{
+		static_assert( NUM_BITS > 0 && NUM_BITS <= 16, "AngleCodec: 1-16 bits" );
+		enum { BITS = NUM_BITS, STEPS = 1 << NUM_BITS };
+
+		static void Encode( BitWriter& writer, float value )
+		{
+			float turns = value * ( 1.0f / Mathf::TWO_PI );
+			turns -= std::floor( turns );
+			writer.WriteBits( (uint32) ( turns * STEPS + 0.5f ) & ( STEPS - 1 ), BITS );
+		}
+
+		static bool Decode( BitReader& reader, float& value )
+		{
+			uint32 raw;
+			if ( !reader.ReadBits( raw, BITS ) )
+				return false;
+			value = (float) raw * ( Mathf::TWO_PI / STEPS );
+			return true;
+		}
+	};
+	//---------------------------------------
+	// Exact copy of any 4 byte aligned POD (float, int, Vec2f...)
+	template< typename T >
+	struct RawCodec
+	{
+		static_assert( sizeof( T ) % 4 == 0, "RawCodec: size must be a multiple of 4 bytes" );
+		enum { WORDS = sizeof( T ) / 4, BITS = WORDS * 32 };
+
+		static void Encode( BitWriter& writer, const T& value )
+		{
+			uint32 words[ WORDS ];
+			memcpy( words, &value, sizeof( T ) );
+			for ( int i = 0; i < WORDS; ++i )
+				writer.WriteBits( words[i], 32 );
+		}
+
+		static bool Decode( BitReader& reader, T& value )
+		{
+			uint32 words[ WORDS ];
+			for ( int i = 0; i < WORDS; ++i )
+			{
+				if ( !reader.ReadBits( words[i], 32 ) )
+					return false;
+			}
+			memcpy( &value, words, sizeof( T ) );
+			return true;
+		}
+	};
+	//---------------------------------------
+	// 2D vector with a codec per axis
+	template< typename TCodecX, typename TCodecY >
+	struct Vec2Codec
+	{
+		enum { BITS = TCodecX::BITS + TCodecY::BITS };
+
+		template< typename TVec >
+		static void Encode( BitWriter& writer, const TVec& value )
+		{
+			TCodecX::Encode( writer, value.x );
+			TCodecY::Encode( writer, value.y );
+		}
+
+		template< typename TVec >
+		static bool Decode( BitReader& reader, TVec& value )
+		{
+			return TCodecX::Decode( reader, value.x )
+				&& TCodecY::Decode( reader, value.y );
+		}
+	};
+	//---------------------------------------
+	// Null terminated string in a char array, up to MAX_LEN chars
+	template< int MAX_LEN >
+	struct StringCodec
+	{
+		enum { LEN_BITS = BitsRequired< MAX_LEN >::VALUE, BITS = LEN_BITS + 8 * MAX_LEN };
+
+		template< int N >
+		static void Encode( BitWriter& writer, const char (&value)[N] )
+		{
+			int len = 0;
+			while ( len < MAX_LEN && len < N && value[ len ] )
+				++len;
+			writer.WriteBits( len, LEN_BITS );
+			for ( int i = 0; i < len; ++i )
+				writer.WriteBits( (uint8) value[i], 8 );
+		}
+
+		template< int N >
+		static bool Decode( BitReader& reader, char (&value)[N] )
+		{
+			uint32 len;
+			if ( !reader.ReadBits( len, LEN_BITS ) || len > MAX_LEN || len >= N )
+				return false;
+			for ( uint32 i = 0; i < len; ++i )
+			{
+				uint32 c;
+				if ( !reader.ReadBits( c, 8 ) )
+					return false;
+				value[i] = (char) c;
+			}
+			value[ len ] = 0;
+			return true;
+		}
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Fields
+	//---------------------------------------
+
+	// Binds a message member to the codec used to send it
+	template< typename TMessage, typename TValue, TValue TMessage::*MEMBER, typename TCodec >
+	struct MessageField
+	{
+		enum { MAX_BITS = TCodec::BITS };
+
+		static void Encode( BitWriter& writer, const TMessage& message )
+		{
+			TCodec::Encode( writer, message.*MEMBER );
+		}
+
+		static bool Decode( BitReader& reader, TMessage& message )
+		{
+			return TCodec::Decode( reader, message.*MEMBER );
+		}
+	};
+	//---------------------------------------
+	// Unused schema slot
+	struct NoField
+	{
+		enum { MAX_BITS = 0 };
+
+		template< typename TMessage >
+		static void Encode( BitWriter&, const TMessage& ) {}
+
+		template< typename TMessage >
+		static bool Decode( BitReader&, TMessage& ) { return true; }
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Schema (up to 8 fields, in wire order)
+	//---------------------------------------
+	template< typename F1, typename F2=NoField, typename F3=NoField, typename F4=NoField,
+			  typename F5=NoField, typename F6=NoField, typename F7=NoField, typename F8=NoField >
+	struct MessageSchema
+	{
+		enum
+		{
+			MAX_BITS = F1::MAX_BITS + F2::MAX_BITS + F3::MAX_BITS + F4::MAX_BITS
+					 + F5::MAX_BITS + F6::MAX_BITS + F7::MAX_BITS + F8::MAX_BITS,
+			MAX_BYTES = ( MAX_BITS + 7 ) / 8
+		};
+
+		template< typename TMessage >
+		static void Encode( BitWriter& writer, const TMessage& message )
+		{
+			F1::Encode( writer, message );
+			F2::Encode( writer, message );
+			F3::Encode( writer, message );
+			F4::Encode( writer, message );
+			F5::Encode( writer, message );
+			F6::Encode( writer, message );
+			F7::Encode( writer, message );
+			F8::Encode( writer, message );
+		}
+
+		template< typename TMessage >
+		static bool Decode( BitReader& reader, TMessage& message )
+		{
+			return F1::Decode( reader, message )
+				&& F2::Decode( reader, message )
+				&& F3::Decode( reader, message )
+				&& F4::Decode( reader, message )
+				&& F5::Decode( reader, message )
+				&& F6::Decode( reader, message )
+				&& F7::Decode( reader, message )
+				&& F8::Decode( reader, message );
+		}
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Message IDs
+	//---------------------------------------
+
+	// Every message starts with its ID so a reader can tell it got a different message than it expected
+	enum
+	{
+		MESSAGE_ID_BITS = 8,
+		MAX_MESSAGE_ID = ( 1 << MESSAGE_ID_BITS ) - 1
+	};
+	//---------------------------------------
+	// Wire facts about a message. MAX_BYTES is the most WriteMessage writes for it, ID included.
+	template< typename TMessage >
+	struct MessageInfo
+	{
+		static_assert( (int) TMessage::ID >= 0 && (int) TMessage::ID <= MAX_MESSAGE_ID, "MessageInfo: ID must be 0-255" );
+		enum
+		{
+			ID = TMessage::ID,
+			MAX_BITS = MESSAGE_ID_BITS + TMessage::Schema::MAX_BITS,
+			MAX_BYTES = ( MAX_BITS + 7 ) / 8
+		};
+	};
+	//---------------------------------------
+	// Unused MessageIDs slot
+	struct NoMessage
+	{
+		enum { ID = -1 };
+	};
+	//---------------------------------------
+	// Doesn't compile if two of the messages (up to 8) share an ID:
+	//  static_assert( MessageIDs< PlayerMsg, StateMsg, KillMsg >::UNIQUE, "Game message IDs" );
+	template< typename M1, typename M2=NoMessage, typename M3=NoMessage, typename M4=NoMessage,
+			  typename M5=NoMessage, typename M6=NoMessage, typename M7=NoMessage, typename M8=NoMessage >
+	struct MessageIDs
+	{
+		static_assert( (int) M1::ID != (int) M2::ID && (int) M1::ID != (int) M3::ID && (int) M1::ID != (int) M4::ID
+					&& (int) M1::ID != (int) M5::ID && (int) M1::ID != (int) M6::ID && (int) M1::ID != (int) M7::ID
+					&& (int) M1::ID != (int) M8::ID, "MessageIDs: two messages share an ID" );
+
+		// Check the rest of the list against each other
+		enum { UNIQUE = MessageIDs< M2, M3, M4, M5, M6, M7, M8, NoMessage >::UNIQUE };
+	};
+
+	template<>
+	struct MessageIDs< NoMessage, NoMessage, NoMessage, NoMessage, NoMessage, NoMessage, NoMessage, NoMessage >
+	{
+		enum { UNIQUE = 1 };
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// PacketWriter/PacketReader message support
+	//---------------------------------------
+	template< typename TMessage >
+	void PacketWriter::WriteMessage( const TMessage& message )
+	{
+		typedef MessageInfo< TMessage > Info;
+		uint8 bytes[ Info::MAX_BYTES + 1 ];
+		BitWriter writer( bytes, Info::MAX_BYTES );
+
+		writer.WriteBits( (uint32) Info::ID, MESSAGE_ID_BITS );
+		TMessage::Schema::Encode( writer, message );
+		writer.Flush();
+
+		WriteBytes( bytes, writer.GetBytesWritten() );
+	}
+	//---------------------------------------
+	template< typename TMessage >
+	bool PacketReader::ReadMessage( TMessage& message )
+	{
+		typedef MessageInfo< TMessage > Info;
+		int available = (int) mBuffer.size() - mPos;
+		BitReader reader( available > 0 ? &mBuffer[ mPos ] : 0, available );
+
+		uint32 id;
+		if ( !reader.ReadBits( id, MESSAGE_ID_BITS ) || id != (uint32) Info::ID )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "Message read fail: expected message %d!\n", (int) Info::ID );
+			return false;
+		}
+
+		if ( !TMessage::Schema::Decode( reader, message ) )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "Message read fail: truncated or out of range data!\n" );
+			return false;
+		}
+
+		mPos += reader.GetBytesRead();
+		return true;
+	}
+	//---------------------------------------
+
+}
\ No newline at end of file
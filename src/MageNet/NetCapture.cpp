@@ -0,0 +1,230 @@
+#include "NetLib.h"
+
+using namespace mage;
+
+//---------------------------------------
+static const char CAPTURE_MAGIC[4] = { 'M', 'N', 'C', 'P' };
+static const uint8 CAPTURE_VERSION = 1;
+static const int CAPTURE_HEADER_SIZE = 6;
+static const int MAX_RECORD_HEADER_SIZE = 1 + 5 + 4 + 2 + 5;
+//---------------------------------------
+
+
+//---------------------------------------
+// Writer
+//---------------------------------------
+NetCaptureWriter::NetCaptureWriter()
+	: mFile( 0 )
+	, mLastTimeUS( 0 )
+	, mLastFlushTimeUS( 0 )
+	, mNumRecords( 0 )
+{}
+//---------------------------------------
+NetCaptureWriter::~NetCaptureWriter()
+{
+	Close();
+}
+//---------------------------------------
+bool NetCaptureWriter::Open( const char* filename )
+{
+	Close();
+
+	fopen_s( &mFile, filename, "wb" );
+	if ( !mFile )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "NetCapture : Failed to open '%s' for writing\n", filename );
+		return false;
+	}
+
+	mBuffer.reserve( FLUSH_SIZE + MAX_RECORD_HEADER_SIZE );
+	mBuffer.insert( mBuffer.end(), CAPTURE_MAGIC, CAPTURE_MAGIC + 4 );
+	mBuffer.push_back( CAPTURE_VERSION );
+	mBuffer.push_back( (uint8) NET_PROTOCOL_VERSION );
+	mLastTimeUS = 0;
+	mLastFlushTimeUS = 0;
+	mNumRecords = 0;
+
+	return true;
+}
+//---------------------------------------
+void NetCaptureWriter::Close()
+{
+	if ( mFile )
+	{
+		Flush();
+		fclose( mFile );
+		mFile = 0;
+	}
+}
+//---------------------------------------
+void NetCaptureWriter::Write( NetCaptureDirection direction, double netTimeMS, const IPaddress& address, const uint8* data, int length )
+{
+	if ( !mFile )
+		return;
+
+	uint8 header[ MAX_RECORD_HEADER_SIZE ];
+	uint8* p = header;
+
+	// Time as a delta from the last record, it can go backwards when the session syncs its clock
+	int64 timeUS = (int64) ( netTimeMS * 1000.0 );
+	int64 delta = timeUS - mLastTimeUS;
+	if ( delta > Mathi::MAX_REAL )  delta = Mathi::MAX_REAL;
+	if ( delta < -Mathi::MAX_REAL ) delta = -Mathi::MAX_REAL;
+	mLastTimeUS += delta;
+
+	*p++ = (uint8) direction;
+	p += WriteVarUInt( p, ZigZagEncode( (int32) delta ) );
+	memcpy( p, &address.Host, 4 );
+	p += 4;
+	memcpy( p, &address.Port, 2 );
+	p += 2;
+	p += WriteVarUInt( p, (uint32) length );
+
+	mBuffer.insert( mBuffer.end(), header, p );
+	mBuffer.insert( mBuffer.end(), data, data + length );
+	++mNumRecords;
+
+	// Flush in big chunks, but at least every second so little is lost if the process is killed
+	int64 sinceFlush = mLastTimeUS - mLastFlushTimeUS;
+	if ( (int) mBuffer.size() >= FLUSH_SIZE || sinceFlush > 1000000 || sinceFlush < 0 )
+	{
+		Flush();
+		mLastFlushTimeUS = mLastTimeUS;
+	}
+}
+//---------------------------------------
+void NetCaptureWriter::Flush()
+{
+	if ( mFile && !mBuffer.empty() )
+	{
+		fwrite( &mBuffer[0], 1, mBuffer.size(), mFile );
+		fflush( mFile );
+		mBuffer.clear();
+	}
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Reader
+//---------------------------------------
+NetCaptureReader::NetCaptureReader()
+	: mFile( 0 )
+	, mPos( 0 )
+	, mLastTimeUS( 0 )
+	, mProtocolVersion( 0 )
+{}
+//---------------------------------------
+NetCaptureReader::~NetCaptureReader()
+{
+	Close();
+}
+//---------------------------------------
+bool NetCaptureReader::Open( const char* filename )
+{
+	Close();
+
+	fopen_s( &mFile, filename, "rb" );
+	if ( !mFile )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "NetCapture : Failed to open '%s'\n", filename );
+		return false;
+	}
+
+	if ( !Fill( CAPTURE_HEADER_SIZE ) || memcmp( &mBuffer[ mPos ], CAPTURE_MAGIC, 4 ) != 0 || mBuffer[ mPos + 4 ] != CAPTURE_VERSION )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "NetCapture : '%s' is not a capture file\n", filename );
+		Close();
+		return false;
+	}
+
+	mProtocolVersion = mBuffer[ mPos + 5 ];
+	mPos += CAPTURE_HEADER_SIZE;
+	mLastTimeUS = 0;
+
+	if ( mProtocolVersion != NET_PROTOCOL_VERSION )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "NetCapture : '%s' was recorded with protocol version %d (current %d)\n"
+			, filename, mProtocolVersion, NET_PROTOCOL_VERSION );
+	}
+
+	return true;
+}
+//---------------------------------------
+void NetCaptureReader::Close()
+{
+	if ( mFile )
+	{
+		fclose( mFile );
+		mFile = 0;
+	}
+	mBuffer.clear();
+	mPos = 0;
+}
+//---------------------------------------
+bool NetCaptureReader::Read( NetCaptureRecord& record )
+{
+	if ( !mFile )
+		return false;
+
+	// The last record in the file may have a shorter header than the max
+	Fill( MAX_RECORD_HEADER_SIZE );
+
+	const uint8* p = mBuffer.empty() ? 0 : &mBuffer[ mPos ];
+	int available = (int) mBuffer.size() - mPos;
+	uint32 value;
+	int n = 0;
+
+	if ( available < 1 )
+		return false;
+
+	record.Direction = (NetCaptureDirection) p[n++];
+
+	int read = ReadVarUInt( p + n, available - n, value );
+	if ( read == 0 || available - n - read < 6 )
+		return false;
+	n += read;
+	mLastTimeUS += ZigZagDecode( value );
+	record.NetTimeMS = mLastTimeUS / 1000.0;
+
+	memcpy( &record.Address.Host, p + n, 4 );
+	n += 4;
+	memcpy( &record.Address.Port, p + n, 2 );
+	n += 2;
+
+	read = ReadVarUInt( p + n, available - n, value );
+	if ( read == 0 )
+		return false;
+	n += read;
+	mPos += n;
+
+	if ( !Fill( (int) value ) )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "NetCapture : Truncated record\n" );
+		return false;
+	}
+
+	record.Data.assign( mBuffer.begin() + mPos, mBuffer.begin() + mPos + value );
+	mPos += value;
+
+	return true;
+}
+//---------------------------------------
+bool NetCaptureReader::Fill( int bytes )
+{
+	int available = (int) mBuffer.size() - mPos;
+	if ( available >= bytes )
+		return true;
+
+	// Drop what has been consumed and read the next chunk
+	mBuffer.erase( mBuffer.begin(), mBuffer.begin() + mPos );
+	mPos = 0;
+
+	int want = Mathi::Max( bytes - available, READ_SIZE );
+	mBuffer.resize( available + want );
+	size_t got = fread( &mBuffer[ available ], 1, want, mFile );
+	mBuffer.resize( available + got );
+
+	return (int) mBuffer.size() >= bytes;
+}
+//---------------------------------------
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Binary capture of the datagrams a NetSession sends and receives, and a
+ *   streaming reader to replay them.
+ *
+ *   File layout:
+ *     char[4] "MNCP"
+ *     uint8   Capture format version
+ *     uint8   NET_PROTOCOL_VERSION of the recording session
+ *     Records:
+ *       uint8  Direction
+ *       varint Net time delta from the previous record (zigzag, microseconds)
+ *       uint32 Host
+ *       uint16 Port
+ *       varint Length
+ *       uint8  Data[ Length ]
+ */
+ 
+#pragma once
+
+namespace mage
+{
+
+	enum NetCaptureDirection
+	{
+		NET_CAPTURE_RECV,
+		NET_CAPTURE_SEND,
+	};
+
+	struct NetCaptureRecord
+	{
+		NetCaptureDirection Direction;
+		double NetTimeMS;				// Session net time when the datagram was sent/received
+		IPaddress Address;				// Sender for received, destination for sent
+		std::vector< uint8 > Data;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class NetCaptureWriter
+	{
+	public:
+		NetCaptureWriter();
+		~NetCaptureWriter();
+
+		bool Open( const char* filename );
+		void Close();
+		bool IsOpen() const								{ return mFile != 0; }
+
+		// Append a datagram. Records are buffered and written out in large chunks.
+		void Write( NetCaptureDirection direction, double netTimeMS, const IPaddress& address, const uint8* data, int length );
+
+		uint32 GetNumRecords() const					{ return mNumRecords; }
+
+	private:
+		void Flush();
+
+		FILE* mFile;
+		std::vector< uint8 > mBuffer;
+		int64 mLastTimeUS;
+		int64 mLastFlushTimeUS;
+		uint32 mNumRecords;
+
+		static const int FLUSH_SIZE = 64 * 1024;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	class NetCaptureReader
+	{
+	public:
+		NetCaptureReader();
+		~NetCaptureReader();
+
+		bool Open( const char* filename );
+		void Close();
+
+		// Read the next record. Returns false at the end of the capture or on a corrupt record.
+		bool Read( NetCaptureRecord& record );
+
+		// NET_PROTOCOL_VERSION the capture was recorded with
+		int GetProtocolVersion() const					{ return mProtocolVersion; }
+
+	private:
+		// Make sure at least bytes are buffered past mPos. Returns false if the file ends first.
+		bool Fill( int bytes );
+
+		FILE* mFile;
+		std::vector< uint8 > mBuffer;
+		int mPos;
+		int64 mLastTimeUS;
+		int mProtocolVersion;
+
+		static const int READ_SIZE = 64 * 1024;
+	};
+	//---------------------------------------
+
+}
\ No newline at end of file
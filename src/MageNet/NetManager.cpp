@@ -35,6 +35,143 @@ namespace mage
 	{
 		SOCKET Sock;
 		IPaddress Address;
+		int Offloads;						// UdpOffloadFlags enabled
+
+		// Receive coalescing. Datagrams left from the last receive are handed out first.
+		LPFN_WSARECVMSG RecvMsg;
+		uint8* Coalesced;
+		int CoalescedSize;
+		int CoalescedPos;
+		int CoalescedSegment;
+		IPaddress CoalescedFrom;
+	};
+
+	// Largest coalesced send/receive. Kernels cap segments per send at 64.
+	static const int MAX_COALESCED_SIZE = 65535;
+	static const int MAX_SEGMENTS = 64;
+
+	bool HasCoalescedPacket( udpSocket* sock )
+	{
+		return sock->CoalescedPos < sock->CoalescedSize;
+	}
+
+	// Copy the next datagram of a coalesced receive into packet
+	int NextCoalescedPacket( udpSocket* sock, udpPacket& packet )
+	{
+		int size = Mathi::Min( sock->CoalescedSegment, sock->CoalescedSize - sock->CoalescedPos );
+		const uint8* data = sock->Coalesced + sock->CoalescedPos;
+		sock->CoalescedPos += size;
+
+		// Too big, same as recvfrom failing on it
+		if ( size > packet.MaxDataLength )
+		{
+			packet.Status = -1;
+			packet.DataLength = 0;
+			return 0;
+		}
+
+		memcpy( packet.Data, data, size );
+		packet.Status = size;
+		packet.DataLength = size;
+		packet.Address = sock->CoalescedFrom;
+		return 1;
+	}
+
+	int RecvCoalesced( udpSocket* sock, udpPacket& packet )
+	{
+		sockaddr_in sock_addr;
+		WSABUF buffer;
+		char control[ WSA_CMSG_SPACE( sizeof( DWORD ) ) ];
+		WSAMSG msg;
+		DWORD received = 0;
+
+		buffer.buf = (CHAR*) sock->Coalesced;
+		buffer.len = MAX_COALESCED_SIZE;
+
+		memset( &msg, 0, sizeof( msg ) );
+		msg.name = (LPSOCKADDR) &sock_addr;
+		msg.namelen = sizeof( sock_addr );
+		msg.lpBuffers = &buffer;
+		msg.dwBufferCount = 1;
+		msg.Control.buf = control;
+		msg.Control.len = sizeof( control );
+
+		if ( sock->RecvMsg( sock->Sock, &msg, &received, NULL, NULL ) == SOCKET_ERROR )
+		{
+			packet.Status = -1;
+			packet.DataLength = 0;
+			return 0;
+		}
+
+		// No coalesced info means a single datagram
+		int segment = (int) received;
+		for ( WSACMSGHDR* cmsg = WSA_CMSG_FIRSTHDR( &msg ); cmsg; cmsg = WSA_CMSG_NXTHDR( &msg, cmsg ) )
+		{
+			if ( cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_COALESCED_INFO )
+			{
+				segment = (int) *(DWORD*) WSA_CMSG_DATA( cmsg );
+			}
+		}
+
+		sock->CoalescedSize = (int) received;
+		sock->CoalescedPos = 0;
+		sock->CoalescedSegment = segment > 0 ? segment : (int) received;
+		sock->CoalescedFrom.Host = sock_addr.sin_addr.s_addr;
+		sock->CoalescedFrom.Port = sock_addr.sin_port;
+
+		// Empty datagram
+		if ( received == 0 )
+		{
+			packet.Status = 0;
+			packet.DataLength = 0;
+			packet.Address = sock->CoalescedFrom;
+			return 1;
+		}
+
+		return NextCoalescedPacket( sock, packet );
+	}
+
+	// Looks up a host name on a worker for NetManager::ResolveHostAsync
+	class ResolveHostJob
+		: public Job
+	{
+	public:
+		ResolveHostJob( const char* host, uint16 port, NetManager::ResolveHostCB callback, void* userData )
+			// Lookups block on the network, keep them off the generic workers
+			: Job( JP_AVERAGE, JOB_FILE_IO )
+			, mHostName( host )
+			, mCallback( callback )
+			, mUserData( userData )
+			, mSuccess( false )
+		{
+			mAddress.Host = INADDR_NONE;
+			mAddress.Port = port;
+		}
+
+		void OnExecute()
+		{
+			mSuccess = NetManager::LookupHost( mHostName.c_str(), mAddress.Host );
+		}
+
+		void OnCompletetion()
+		{
+			if ( mSuccess )
+			{
+				NetManager::CacheHost( mHostName.c_str(), mAddress.Host );
+			}
+			else
+			{
+				ConsolePrintf( CONSOLE_ERROR, "Failed to resolve host '%s:%u'\n", mHostName.c_str(), mAddress.Port );
+			}
+			mCallback( mSuccess, mAddress, mUserData );
+		}
+
+	private:
+		std::string mHostName;
+		NetManager::ResolveHostCB mCallback;
+		void* mUserData;
+		IPaddress mAddress;
+		bool mSuccess;
 	};
 
 	bool SocketIsReady( SOCKET sock )
@@ -65,6 +202,9 @@ namespace mage
 
 //---------------------------------------
 int NetManager::mNetInit = 0;
+std::map< std::string, NetManager::CachedHost > NetManager::mHostCache;
+Mutex NetManager::mHostCacheMutex;
+double NetManager::mHostCacheTTL = 300.0;		// 5 min
 //---------------------------------------
 
 
@@ -107,33 +247,118 @@ bool NetManager::Quit()
 //---------------------------------------
 bool NetManager::ResolveHost( IPaddress& address, const char* host, uint16 port )
 {
+	address.Port = port;
+
 	if ( host == 0 )
 	{
 		address.Host = INADDR_ANY;
+		return true;
 	}
-	else
+
+	if ( GetCachedHost( host, address.Host ) )
 	{
-		address.Host = inet_addr( host );
-		if ( address.Host == INADDR_NONE )
-		{
-			hostent* h;
+		return true;
+	}
 
-			h = gethostbyname( host );
-			if ( h )
-			{
-				memcpy( &address.Host, h->h_addr, h->h_length );
-			}
-			else
-			{
-				ConsolePrintf( CONSOLE_ERROR, "Failed to resolve host '%s:%u'\n", host, port );
-				return false;
-			}
-		}
+	if ( !LookupHost( host, address.Host ) )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "Failed to resolve host '%s:%u'\n", host, port );
+		return false;
 	}
+
+	CacheHost( host, address.Host );
+	return true;
+}
+//---------------------------------------
+void NetManager::ResolveHostAsync( const char* host, uint16 port, ResolveHostCB callback, void* userData )
+{
+	IPaddress address;
 	address.Port = port;
+
+	// Nothing to look up
+	if ( host == 0 )
+	{
+		address.Host = INADDR_ANY;
+		callback( true, address, userData );
+		return;
+	}
+
+	address.Host = inet_addr( host );
+	if ( address.Host != INADDR_NONE || GetCachedHost( host, address.Host ) )
+	{
+		callback( true, address, userData );
+		return;
+	}
+
+	JobManager::GetInstance()->PushJob( new ResolveHostJob( host, port, callback, userData ) );
+}
+//---------------------------------------
+void NetManager::ClearHostCache()
+{
+	CriticalBlock( mHostCacheMutex );
+	mHostCache.clear();
+}
+//---------------------------------------
+bool NetManager::LookupHost( const char* host, uint32& outHost )
+{
+	outHost = inet_addr( host );
+	if ( outHost != INADDR_NONE )
+	{
+		return true;
+	}
+
+	// getaddrinfo is reentrant unlike gethostbyname, so this is safe on any thread
+	addrinfo hints;
+	addrinfo* result = 0;
+	memset( &hints, 0, sizeof( hints ) );
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	if ( getaddrinfo( host, NULL, &hints, &result ) != 0 || !result )
+	{
+		return false;
+	}
+
+	outHost = ( (sockaddr_in*) result->ai_addr )->sin_addr.s_addr;
+	freeaddrinfo( result );
+	return true;
+}
+//---------------------------------------
+bool NetManager::GetCachedHost( const char* host, uint32& outHost )
+{
+	CriticalBlock( mHostCacheMutex );
+
+	auto itr = mHostCache.find( host );
+	if ( itr == mHostCache.end() )
+	{
+		return false;
+	}
+
+	// Expired, look it up again
+	if ( Clock::QueryTime() > itr->second.ExpireTime )
+	{
+		mHostCache.erase( itr );
+		return false;
+	}
+
+	outHost = itr->second.Host;
 	return true;
 }
 //---------------------------------------
+void NetManager::CacheHost( const char* host, uint32 resolved )
+{
+	if ( mHostCacheTTL <= 0 )
+	{
+		return;
+	}
+
+	CriticalBlock( mHostCacheMutex );
+
+	CachedHost& entry = mHostCache[ host ];
+	entry.Host = resolved;
+	entry.ExpireTime = Clock::QueryTime() + mHostCacheTTL;
+}
+//---------------------------------------
 int NetManager::CheckSockets( SocketArray sockets, uint32 timeoutMS )
 {
 	SOCKET maxSock = 0;
@@ -251,6 +476,8 @@ void NetManager::udpCloseSocket( udpSocket_t& sock )
 	{
 		if ( sock->Sock != INVALID_SOCKET )
 			closesocket( sock->Sock );
+		if ( sock->Coalesced )
+			delete[] sock->Coalesced;
 		Delete0( sock );
 	}
 }
@@ -285,8 +512,19 @@ int NetManager::udpRecvPacket( udpSocket_t sock, udpPacket& packet )
 	socklen_t sock_len;
 	int numrecv = 0;
 
+	// Finish handing out the last coalesced receive
+	if ( HasCoalescedPacket( sock ) )
+	{
+		return NextCoalescedPacket( sock, packet );
+	}
+
 	if ( SocketIsReady( sock->Sock ) )
 	{
+		if ( sock->Offloads & UDPOFFLOAD_RECV_COALESCE )
+		{
+			return RecvCoalesced( sock, packet );
+		}
+
 		sock_len = sizeof( sock_addr );
 		packet.Status = recvfrom( sock->Sock, (char*) packet.Data, packet.MaxDataLength, 0,
 			                       (sockaddr*)&sock_addr, &sock_len );
@@ -305,4 +543,134 @@ int NetManager::udpRecvPacket( udpSocket_t sock, udpPacket& packet )
 
 	return numrecv;
 }
+//---------------------------------------
+bool NetManager::udpWaitForPacket( udpSocket_t sock, uint32 timeoutUS )
+{
+	if ( HasCoalescedPacket( sock ) )
+	{
+		return true;
+	}
+
+	return WaitForSocket( (socketHandle_t) sock->Sock, timeoutUS );
+}
+//---------------------------------------
+bool NetManager::udpHasBufferedPacket( udpSocket_t sock )
+{
+	return HasCoalescedPacket( sock );
+}
+//---------------------------------------
+socketHandle_t NetManager::udpGetSocketHandle( udpSocket_t sock )
+{
+	return (socketHandle_t) sock->Sock;
+}
+//---------------------------------------
+bool NetManager::WaitForSocket( socketHandle_t handle, uint32 timeoutUS )
+{
+	SOCKET sock = (SOCKET) handle;
+	timeval tv;
+	fd_set mask;
+	int _ret;
+
+	do 
+	{
+		Net_SetLastError( 0 );
+
+		FD_ZERO( &mask );
+		FD_SET( sock, &mask );
+
+		tv.tv_sec  = timeoutUS / 1000000;
+		tv.tv_usec = timeoutUS % 1000000;
+
+		_ret = select( sock + 1, &mask, NULL, NULL, &tv );
+	} while ( Net_GetLastError() == EINTR );
+
+	return _ret == 1;
+}
+//---------------------------------------
+int NetManager::udpEnableOffload( udpSocket_t sock, int offloads )
+{
+	int enabled = UDPOFFLOAD_NONE;
+	DWORD size;
+
+	// Size 0 turns segmentation off, it's set per batch in udpSendSegments.
+	// Fails on systems without support.
+	size = 0;
+	if ( ( offloads & UDPOFFLOAD_SEND_SEGMENTS ) &&
+		setsockopt( sock->Sock, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (char*) &size, sizeof( size ) ) == 0 )
+	{
+		enabled |= UDPOFFLOAD_SEND_SEGMENTS;
+	}
+
+	// Coalesced receives need WSARecvMsg to get the datagram size
+	size = ( offloads & UDPOFFLOAD_RECV_COALESCE ) ? MAX_COALESCED_SIZE : 0;
+	if ( size )
+	{
+		GUID guid = WSAID_WSARECVMSG;
+		DWORD bytes = 0;
+		if ( WSAIoctl( sock->Sock, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof( guid ),
+					   &sock->RecvMsg, sizeof( sock->RecvMsg ), &bytes, NULL, NULL ) == 0 &&
+			setsockopt( sock->Sock, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (char*) &size, sizeof( size ) ) == 0 )
+		{
+			if ( !sock->Coalesced )
+			{
+				sock->Coalesced = new uint8[ MAX_COALESCED_SIZE ];
+			}
+			enabled |= UDPOFFLOAD_RECV_COALESCE;
+		}
+	}
+	else if ( sock->Offloads & UDPOFFLOAD_RECV_COALESCE )
+	{
+		setsockopt( sock->Sock, IPPROTO_UDP, UDP_RECV_MAX_COALESCED_SIZE, (char*) &size, sizeof( size ) );
+	}
+
+	sock->Offloads = enabled;
+	return enabled;
+}
+//---------------------------------------
+int NetManager::udpSendSegments( udpSocket_t sock, const IPaddress& to, const uint8* data, int segmentSize, int totalSize )
+{
+	sockaddr_in sock_addr;
+	socklen_t sock_len;
+	int numSegments = ( totalSize + segmentSize - 1 ) / segmentSize;
+	int sent = 0;
+
+	sock_addr.sin_addr.s_addr = to.Host;
+	sock_addr.sin_port        = to.Port;
+	sock_addr.sin_family      = AF_INET;
+	sock_len = sizeof( sock_addr );
+
+	if ( ( sock->Offloads & UDPOFFLOAD_SEND_SEGMENTS ) && numSegments > 1 &&
+		numSegments <= MAX_SEGMENTS && totalSize <= MAX_COALESCED_SIZE )
+	{
+		DWORD size = segmentSize;
+		if ( setsockopt( sock->Sock, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (char*) &size, sizeof( size ) ) == 0 )
+		{
+			int status = sendto( sock->Sock, (const char*) data, totalSize, 0, (sockaddr*)&sock_addr, sock_len );
+
+			// Back off so single sends aren't split
+			size = 0;
+			setsockopt( sock->Sock, IPPROTO_UDP, UDP_SEND_MSG_SIZE, (char*) &size, sizeof( size ) );
+
+			if ( status == totalSize )
+			{
+				return numSegments;
+			}
+		}
+
+		// Supported by the stack but not this route/adapter, don't keep trying
+		ConsolePrintf( CONSOLE_WARNING, "UDP send offload failed, falling back to one send per datagram\n" );
+		sock->Offloads &= ~UDPOFFLOAD_SEND_SEGMENTS;
+	}
+
+	for ( int offset = 0; offset < totalSize; offset += segmentSize )
+	{
+		int size = Mathi::Min( segmentSize, totalSize - offset );
+		if ( sendto( sock->Sock, (const char*) data + offset, size, 0, (sockaddr*)&sock_addr, sock_len ) >= 0 )
+		{
+			++sent;
+		}
+	}
+
+	return sent;
+}
 //---------------------------------------
\ No newline at end of file
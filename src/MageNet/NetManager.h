@@ -12,6 +12,10 @@ namespace mage
 
 	class NetManager
 	{
+	public:
+		// Result of ResolveHostAsync. On failure address is not valid.
+		typedef void(*ResolveHostCB)( bool success, IPaddress address, void* userData );
+
 	private:
 		NetManager();
 		~NetManager();
@@ -26,9 +30,19 @@ namespace mage
 		// General Network
 		//---------------------------------------
 
-		// Resolve name/port to IPaddress
+		// Resolve name/port to IPaddress. Blocks until the lookup is done.
 		static bool ResolveHost( IPaddress& address, const char* host, uint16 port );
 
+		/**Resolve name/port to IPaddress without blocking.
+		 * The lookup runs as a JobManager job and callback is fired from JobManager::OnUpdate().
+		 * Numeric and cached addresses don't need a lookup and fire callback before returning.
+		 */
+		static void ResolveHostAsync( const char* host, uint16 port, ResolveHostCB callback, void* userData=NULL );
+
+		// How long resolved names are cached (sec). 0 disables the cache.
+		static void SetHostCacheTTL( double seconds )		{ mHostCacheTTL = seconds; }
+		static void ClearHostCache();
+
 		/**Get local addresses up to max.
 		 * If max < 0 get all local addresses
 		 * Returns number address found
@@ -42,6 +56,12 @@ namespace mage
 		 */
 		static int CheckSockets( SocketArray sockets, uint32 timeoutMS );
 
+		/**Block until the OS socket has data or timeoutUS (microseconds) passes. Returns true if data is ready.
+		 * Touches nothing but the OS socket, so it can run on another thread while the socket is used
+		 * as long as it isn't closed. Doesn't see datagrams buffered by a coalesced UDP receive.
+		 */
+		static bool WaitForSocket( socketHandle_t handle, uint32 timeoutUS );
+
 		// Returns true if the socket is valid and has data waiting
 #define IsSocketReady( sock ) _IsSocketReady( (genericSocket_t) sock )
 		static inline bool _IsSocketReady( genericSocket_t sock )
@@ -62,9 +82,40 @@ namespace mage
 		static int udpSendPacket( udpSocket_t sock, const udpPacket& packet );
 		// Receive a udpPacket over the given socket. Returns the number of packets received.
 		static int udpRecvPacket( udpSocket_t sock, udpPacket& packet );
+		// Block until the socket has data or timeoutUS (microseconds) passes. Returns true if data is ready.
+		static bool udpWaitForPacket( udpSocket_t sock, uint32 timeoutUS );
+		// True if datagrams from the last coalesced receive are waiting, udpRecvPacket returns them without the OS
+		static bool udpHasBufferedPacket( udpSocket_t sock );
+		// OS socket under sock for WaitForSocket, valid until sock is closed
+		static socketHandle_t udpGetSocketHandle( udpSocket_t sock );
+		// Turn on the UdpOffloadFlags the system supports and off the rest. Returns the offloads enabled.
+		// Winsock only (UDP_SEND_MSG_SIZE/UDP_RECV_MAX_COALESCED_SIZE), Linux's UDP_SEGMENT/UDP_GRO
+		// need a Linux socket layer first. Neither path has been checked over loopback yet.
+		static int udpEnableOffload( udpSocket_t sock, int offloads );
+		/**Send totalSize bytes of data to 'to' as datagrams of segmentSize bytes, the last one may be shorter.
+		 * With UDPOFFLOAD_SEND_SEGMENTS this is a single send call, otherwise one sendto per datagram.
+		 * Returns the number of datagrams sent.
+		 */
+		static int udpSendSegments( udpSocket_t sock, const IPaddress& to, const uint8* data, int segmentSize, int totalSize );
 
 	private:
+		// Thread safe lookup without the cache
+		static bool LookupHost( const char* host, uint32& outHost );
+		static bool GetCachedHost( const char* host, uint32& outHost );
+		static void CacheHost( const char* host, uint32 resolved );
+
+		struct CachedHost
+		{
+			uint32 Host;
+			double ExpireTime;
+		};
+
 		static int mNetInit;
+		static std::map< std::string, CachedHost > mHostCache;
+		static Mutex mHostCacheMutex;
+		static double mHostCacheTTL;
+
+		friend class ResolveHostJob;
 	};
 
 }
\ No newline at end of file
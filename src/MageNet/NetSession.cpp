@@ -2,6 +2,28 @@
 
 using namespace mage;
 
+//---------------------------------------
+namespace mage
+{
+
+	// Expand a wrapped 16 bit value to the 32 bit value nearest reference
+	static uint32 Unwrap16( uint16 value, uint32 reference )
+	{
+		return reference + (int16) ( value - (uint16) reference );
+	}
+
+}
+//---------------------------------------
+const double NetSession::MAX_BURST_TIME = 0.02;
+const double NetSession::MIN_BURST_BYTES = 1500;
+const double NetSession::MAX_LOW_PRIORITY_AGE = 0.25;
+const double NetSession::MIN_BANDWIDTH = 4 * 1024;
+const double NetSession::BANDWIDTH_GROWTH = 0.05;
+const double NetSession::BANDWIDTH_BACKOFF = 0.75;
+const double NetSession::BACKOFF_INTERVAL = 0.25;
+const double NetSession::RTT_SLACK_MS = 50;
+//---------------------------------------
+
 clientID_t NetSession::IdFromAddress( const IPaddress& addr )
 {
 	std::stringstream ss;
@@ -18,6 +40,24 @@ NetSession::NetSession()
 	, VerboseDebugMsg( false )
 	, mTotalPacketsSent( 0 )
 	, mTotalPacketsRecv( 0 )
+	, mTotalBytesSent( 0 )
+	, mTotalHeaderBytesSent( 0 )
+	, mTotalPacketsDropped( 0 )
+	, mTotalPacketsBatched( 0 )
+	, mTotalPacketsCorrupt( 0 )
+	, mDefaultBandwidth( 0 )
+	, mAdaptiveBandwidth( false )
+	, mOffloads( UDPOFFLOAD_NONE )
+	, mEnabledOffloads( UDPOFFLOAD_NONE )
+	, mSendBatchDepth( 0 )
+	, mSendBatchSegmentSize( 0 )
+	, mSendBatchCount( 0 )
+	, mPostMessages( 0 )
+	, mPostData( 0 )
+	, mMaxPostSize( 0 )
+	, mPostFree( 0 )
+	, mPostQueue( 0 )
+	, mTotalPostsDropped( 0 )
 	, mReliableResendTimeout( 1000 )		// 1 sec
 	, mClientConnectCB( 0 )
 	, mClientDisconnectCB( 0 )
@@ -29,13 +69,23 @@ NetSession::NetSession()
 	}
 
 	mNetClock = Clock::CreateClock( &Clock::Initialize() );
+
+	// Checksums start from the protocol ID
+	const uint8 protocolID[4] = { (uint8) NET_PROTOCOL_ID, (uint8) ( NET_PROTOCOL_ID >> 8 ), (uint8) ( NET_PROTOCOL_ID >> 16 ), (uint8) ( NET_PROTOCOL_ID >> 24 ) };
+	mCrcSeed = Crc32c( protocolID, sizeof( protocolID ) );
 }
 //---------------------------------------
 NetSession::~NetSession()
 {
+	FinishWaitTask();
 	NetManager::udpCloseSocket( mSock );
 	NetManager::Quit();
 	Clock::DestroyClock( mNetClock );
+
+	Delete0( mPostFree );
+	Delete0( mPostQueue );
+	delete[] mPostMessages;
+	delete[] mPostData;
 }
 //--------------------------------------
 void NetSession::OpenPort( uint16 port )
@@ -43,193 +93,116 @@ void NetSession::OpenPort( uint16 port )
 	if ( !mSock )
 		//NetManager::udpCloseSocket( mSock );
 	mSock = NetManager::udpOpenPort( port );
+
+	if ( mSock && mOffloads )
+	{
+		EnableOffload( mOffloads );
+	}
 }
 //--------------------------------------
-void NetSession::OnUpdate( /*float dt*/ )
+int NetSession::EnableOffload( int offloads )
 {
-	// don't call this since we are parented to the main clock which is advanced by the app
-	//mNetClock->AdvanceTime( dt );
+	mOffloads = offloads;
+	if ( !mSock )
+	{
+		return UDPOFFLOAD_NONE;
+	}
 
+	FinishWaitTask();
+	mEnabledOffloads = NetManager::udpEnableOffload( mSock, offloads );
+	if ( mEnabledOffloads != offloads )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "NetSession : UDP offload 0x%x requested, 0x%x supported\n", offloads, mEnabledOffloads );
+	}
+	return mEnabledOffloads;
+}
+//--------------------------------------
+bool NetSession::WaitForPacket( uint32 timeoutUS )
+{
 	if ( mSock == 0 )
-		return;
+		return false;
 
-	while ( NetManager::udpRecvPacket( mSock, mRecvPacket ) )
+	return NetManager::udpWaitForPacket( mSock, timeoutUS );
+}
+//--------------------------------------
+Task< bool > NetSession::WaitForPacketAsync( uint32 timeoutUS )
+{
+	if ( mWaitTask.IsValid() && !mWaitTask.IsDone() )
 	{
-		clientID_t senderID = IdFromAddress( mRecvPacket.Address );
-
-		++mTotalPacketsRecv;
+		return mWaitTask;
+	}
 
-		PacketHeader header;
-		ClientInfo& info = mClientInfos[ senderID ];
-		info.Address = mRecvPacket.Address;
+	// Datagrams left from a coalesced receive are ready now, the job couldn't see them anyway
+	if ( mSock == 0 || NetManager::udpHasBufferedPacket( mSock ) )
+	{
+		TaskCompletion< bool > ready;
+		ready.SetResult( mSock != 0 );
+		return ready.GetTask();
+	}
 
-		// @TODO it might be better to check the 'request' and 'accept' flags on the packet header.
-	//	if ( info.LastRecvPacketID == 0 )
-	//	{
-	//		// Mark new clients so we can notify client code of new connections
-	//		// I don't call the callback here b/c client code might try to
-	//		// modify the session state causing bad stuff to happen.
-	//		mNewClients.push_back( senderID );
-	//	}
+	// The job only selects on the OS socket, so receiving on the main thread doesn't wait for it.
+	// select blocks the worker for up to timeoutUS, only the file I/O worker takes these.
+	socketHandle_t handle = NetManager::udpGetSocketHandle( mSock );
+	mWaitTask = Async< bool >( [handle, timeoutUS]() -> bool
+	{
+		return NetManager::WaitForSocket( handle, timeoutUS );
+	}, Job::JOB_FILE_IO );
+	return mWaitTask;
+}
+//--------------------------------------
+void NetSession::FinishWaitTask()
+{
+	// Closing the socket frees the handle the job selects on
+	if ( mWaitTask.IsValid() )
+	{
+		mWaitTask.Wait();
+		mWaitTask = Task< bool >();
+	}
+}
+//--------------------------------------
+void NetSession::OnUpdate( /*float dt*/ )
+{
+	// don't call this since we are parented to the main clock which is advanced by the app
+	//mNetClock->AdvanceTime( dt );
 
-		// Skip packets that are empty
-		if ( mRecvPacket.DataLength > 0 )
+	if ( mSock )
+	{
+		while ( NetManager::udpRecvPacket( mSock, mRecvPacket ) )
 		{
-			if ( mRecvPacket.DataLength > mLargestPacketRcv )
+			if ( mCapture.IsOpen() )
 			{
-				mLargestPacketRcv = mRecvPacket.DataLength;
+				mCapture.Write( NET_CAPTURE_RECV, mNetClock->GetElapsedTime( Clock::TIME_MILLI ), mRecvPacket.Address, mRecvPacket.Data, mRecvPacket.DataLength );
 			}
-
-			// Read header
-			int headerSize = sizeof( PacketHeader );
-			memcpy( &header, mRecvPacket.Data, headerSize );
-
-			if ( VerboseDebugMsg )
-			{
-				ConsolePrintf( C_FG_LIGHT_GREEN, ">>>>> " );
-				ConsolePrintf( "Recv packet: id=%u size=%s\n", header.PacketID, ByteDisplay( mRecvPacket.DataLength ).ToString() );
-			}
-
-			// Check acknowledgments received
-			uint32 numAcks = header.PacketAcks;
-			if ( numAcks > 0 && info.PacketsNeedingAck.size() > 0 )
-			{
-				for ( uint32 i = 0; i < numAcks; ++i )
-				{
-					// Acknowledge packet
-					packetID_t ackID;
-					memcpy( &ackID, mRecvPacket.Data + headerSize + i * sizeof( packetID_t ), sizeof( packetID_t ) );
-
-					// Remove packet from list
-					info.PacketsNeedingAck.erase( 
-						std::remove_if( info.PacketsNeedingAck.begin(), info.PacketsNeedingAck.end(), [&]( AckInfo*& ackInfo ) -> bool
-						{
-							bool _ret = ackInfo->PacketID == ackID;
-							if ( _ret )
-							{
-								if ( VerboseDebugMsg )
-								{
-									ConsolePrintf( C_FG_GREEN, ">>>>> " );
-									ConsolePrintf( "ACK recv for packet %u from %u\n", ackID, senderID );
-								}
-								delete ackInfo;
-							}
-							return _ret;
-						}),
-						info.PacketsNeedingAck.end() );
-				}
-			}
-
-			// Add packet to packets needing acknowledged list
-			bool firstTimeAck = true;
-			if ( IsBitSet( header.Flags, 1 ) )
-			{
-				info.PacketsToAck.push_back( header.PacketID );
-
-				// Check if we have acknowledged this packet before
-				if ( info.PacketsAcked[ header.PacketID ] )
-				{
-					firstTimeAck = false;
-				}
-				// Mark the packet as acknowledge so we can ignore others that may arrive late
-				info.PacketsAcked[ header.PacketID ] = true;
-			}
-
-			// Do not evaluate packet further - it's a duplicate reliable packet
-			if ( !firstTimeAck )
-			{
-				if ( VerboseDebugMsg )
-				{
-					ConsolePrintf( C_FG_RED, ">>>>> " );
-					ConsolePrintf( "Ignoring packet %u (already received)\n", header.PacketID );
-				}
-				continue;
-			}
-
-			// Check order - receive if new
-			bool inOrder = IsBitSet( header.Flags, 0 );
-			bool packetIsNew = header.PacketID > info.LastRecvPacketID;
-			if ( ( inOrder && packetIsNew ) || ( !inOrder ) )
-			{
-				// Update average RTT
-				double now = mNetClock->GetElapsedTime( Clock::TIME_MILLI );
-				double diff = now - header.Timestamp;
-				info.AverageRTTSeconds = ( 0.9 * info.AverageRTTSeconds ) + ( 0.1 * diff );
-
-				if ( packetIsNew )
-					info.LastRecvPacketID = header.PacketID;
-
-				// Packet was requesting connection
-				if ( IsBitSet( header.Flags, 2 ) )
-				{
-					SendAcceptMessage( mRecvPacket.Address );
-					mNewClients.push_back( senderID );
-				}
-
-				// Packet was response to requesting connection
-				if ( IsBitSet( header.Flags, 3 ) )
-				{
-					ConsolePrintf( C_FG_GREEN, ">>>>> " );
-					ConsolePrintf( "Connection Accepted\n" );
-					mNewClients.push_back( senderID );
-				}
-
-				// Packet was informing disconnect
-				if ( IsBitSet( header.Flags, 4 ) )
-				{
-					ConsolePrintf( C_FG_YELLOW, ">>>>> " );
-					ConsolePrintf( "Removing client (disconnected) %u\n", senderID );
-					mClientInfos.erase( mClientInfos.find( senderID ) );
-					mDeadClients.push_back( senderID );
-					continue;
-				}
-
-				// Packet is informing timesync
-				if ( IsBitSet( header.Flags, 5 ) )
-				{
-					ConsolePrintf( C_FG_WHITE, ">>>>> " );
-					ConsolePrintf( "Syncing client time to server %f\n", header.Timestamp );
-					info.AverageRTTSeconds = 0.0;
-					mNetClock->SetTime( header.Timestamp / 1000.0 );
-				}
-
-				// If there is user data copy it over to the client
-				int clientDataSize = mRecvPacket.DataLength - headerSize - numAcks * sizeof( packetID_t );
-				if ( clientDataSize > 0 )
-				{
-					udpPacket* packet = new udpPacket( mRecvPacket.DataLength );
-
-					// Copy user data - stripping header and acks
-					packet->DataLength = mRecvPacket.DataLength - headerSize - numAcks * sizeof( packetID_t );
-					memcpy( packet->Data, mRecvPacket.Data + headerSize + numAcks * sizeof( packetID_t ), packet->DataLength );
-					packet->Timestamp = header.Timestamp;
-					info.PacketQueue.push( packet );
-				}
-			}
-			else
-			{
-				ConsolePrintf( "Ignoring out-of-order packet : %d\n", header.PacketID );
-			}
-		}
-		else
-		{
-			ConsolePrintf( "Received empty packet... ignoring\n" );
+			ProcessRecvPacket();
 		}
 	}
 
 
+	// Data posted by other threads since the last update
+	FlushPostedData();
+
+	double realNow = Clock::QueryTime();
+
 	// @TODO THIS CODE FEELS MESSY AND INEFFCIENT SHOULD REFACTOR WHEN HAVE TIME
 	// might want to use clock callback to fire this instead of checking every time??
 	// Check if we need to resend any ack packets
+	BeginSendBatch();
 	for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
 	{
 		ClientInfo& info = itr->second;
-		PacketWriter writer;
+
+		if ( mAdaptiveBandwidth )
+		{
+			AdaptBandwidth( info, realNow );
+		}
+
+		// Queued data goes first, acks ride along with it
+		FlushSendQueue( info, realNow );
 
 		// Send packet with acknowledgment info to let client know we got the packet
 		if ( info.PacketsToAck.size() )
 		{
-			SendData( writer, info.Address, SENDOPT_NONE );
+			SendNow( info, 0, 0, SENDOPT_NONE );
 		}
 
 		for ( auto jtr = itr->second.PacketsNeedingAck.begin(); jtr != itr->second.PacketsNeedingAck.end(); ++jtr )
@@ -239,12 +212,19 @@ void NetSession::OnUpdate( /*float dt*/ )
 			double diff = now - (*jtr)->TimeLastSent;
 			if ( diff > mReliableResendTimeout )
 			{
+				// Resends compete for the same budget, retry next update if it's spent
+				if ( !HasBandwidthFor( info, (*jtr)->Packet.DataLength + MAX_HEADER_SIZE, realNow ) )
+				{
+					break;
+				}
+				// However many packets were resent it is one loss event until the limit adapts
+				info.LostPacket = true;
+
 				if ( VerboseDebugMsg )
 				{
 					ConsolePrintf( C_FG_LIGHT_BLUE, "<<<<< " );
 					ConsolePrintf( "Resending packet %u to %u\n", (*jtr)->PacketID, itr->first );
 				}
-				int requiredSize = (*jtr)->Packet.DataLength + sizeof( PacketHeader );
 				ClientInfo& info = itr->second;
 				// Fill in header
 				PacketHeader header;
@@ -256,28 +236,40 @@ void NetSession::OnUpdate( /*float dt*/ )
 				header.PacketAcks = 0;
 
 				// Write header
-				memcpy( mSendPacket.Data, &header, sizeof( PacketHeader ) );
+				int headerSize = WriteHeader( mSendPacket.Data, header, 0 );
 				// Write user data
-				memcpy( mSendPacket.Data + sizeof( PacketHeader ), (*jtr)->Packet.Data, (*jtr)->Packet.DataLength );
+				memcpy( mSendPacket.Data + headerSize, (*jtr)->Packet.Data, (*jtr)->Packet.DataLength );
 
-				mSendPacket.DataLength = requiredSize;
+				mSendPacket.DataLength = headerSize + (*jtr)->Packet.DataLength;
 				mSendPacket.Address = info.Address;
+				SealPacket();
 
 				// Send packet
-				NetManager::udpSendPacket( mSock, mSendPacket );
+				SendPacket();
 				++mTotalPacketsSent;
+				mTotalBytesSent += mSendPacket.DataLength;
+				mTotalHeaderBytesSent += headerSize + CRC_SIZE;
+				(*jtr)->TimeLastSent = now;
+				if ( info.BytesPerSecond > 0 )
+				{
+					info.Tokens -= mSendPacket.DataLength;
+				}
 			}
 		}
 	}
+	EndSendBatch();
 
 	// Call callbacks for new connections
 	if ( mClientConnectCB )
 	{
 		for ( uint32 i = 0; i < mNewClients.size(); ++i )
 		{
-			ClientInfo& info = mClientInfos[ mNewClients[i] ];
+			// May have disconnected again already
+			auto itr = mClientInfos.find( mNewClients[i] );
+			if ( itr == mClientInfos.end() ) continue;
+
 			// Notify new connection to client code
-			mClientConnectCB( mNewClients[i], info.Address );
+			mClientConnectCB( mNewClients[i], itr->second.Address );
 		}
 	}
 	mNewClients.clear();
@@ -287,14 +279,322 @@ void NetSession::OnUpdate( /*float dt*/ )
 	{
 		for ( uint32 i = 0; i < mDeadClients.size(); ++i )
 		{
-			ClientInfo& info = mClientInfos[ mDeadClients[i] ];
-			// Notify lost connection to client code		
-			mClientDisconnectCB( mDeadClients[i], info.Address );
+			// Notify lost connection to client code
+			mClientDisconnectCB( mDeadClients[i].ID, mDeadClients[i].Address );
 		}
 	}
 	mDeadClients.clear();
 }
 //---------------------------------------
+void NetSession::InjectPacket( const IPaddress& from, const uint8* data, int length, double netTimeMS )
+{
+	if ( length > mRecvPacket.MaxDataLength )
+	{
+		mRecvPacket.Resize( length );
+	}
+
+	// Run at the time the packet was captured so timestamps unwrap the same way
+	mNetClock->SetTime( netTimeMS / 1000.0 );
+
+	memcpy( mRecvPacket.Data, data, length );
+	mRecvPacket.DataLength = length;
+	mRecvPacket.Address = from;
+
+	ProcessRecvPacket();
+}
+//---------------------------------------
+bool NetSession::StartCapture( const char* filename )
+{
+	return mCapture.Open( filename );
+}
+//---------------------------------------
+void NetSession::StopCapture()
+{
+	mCapture.Close();
+}
+//---------------------------------------
+void NetSession::SealPacket()
+{
+	uint32 crc = Crc32c( mSendPacket.Data, mSendPacket.DataLength, mCrcSeed );
+
+	uint8* p = mSendPacket.Data + mSendPacket.DataLength;
+	*p++ = (uint8) crc;
+	*p++ = (uint8) ( crc >> 8 );
+	*p++ = (uint8) ( crc >> 16 );
+	*p++ = (uint8) ( crc >> 24 );
+	mSendPacket.DataLength += CRC_SIZE;
+}
+//---------------------------------------
+bool NetSession::UnsealPacket()
+{
+	// Smallest header plus the checksum
+	int size = mRecvPacket.DataLength - CRC_SIZE;
+	if ( size < 4 )
+	{
+		return false;
+	}
+
+	uint32 crc = Crc32c( mRecvPacket.Data, size, mCrcSeed );
+
+	const uint8* p = mRecvPacket.Data + size;
+	uint32 sent = p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32) p[3] << 24 );
+	if ( crc != sent )
+	{
+		return false;
+	}
+
+	mRecvPacket.DataLength = size;
+	return true;
+}
+//---------------------------------------
+void NetSession::SendPacket()
+{
+	if ( mCapture.IsOpen() )
+	{
+		mCapture.Write( NET_CAPTURE_SEND, mNetClock->GetElapsedTime( Clock::TIME_MILLI ), mSendPacket.Address, mSendPacket.Data, mSendPacket.DataLength );
+	}
+
+	// Sessions without a port (ie. replaying a capture) just drop outgoing packets
+	if ( !mSock )
+	{
+		return;
+	}
+
+	if ( mSendBatchDepth == 0 || !( mEnabledOffloads & UDPOFFLOAD_SEND_SEGMENTS ) )
+	{
+		NetManager::udpSendPacket( mSock, mSendPacket );
+		return;
+	}
+
+	// A batch is a run of equal sized datagrams to one address
+	int size = mSendPacket.DataLength;
+	if ( mSendBatchCount > 0 &&
+		( mSendBatchAddress.Host != mSendPacket.Address.Host || mSendBatchAddress.Port != mSendPacket.Address.Port ||
+		  size > mSendBatchSegmentSize || mSendBatchCount == MAX_SEND_BATCH_COUNT ||
+		  (int) mSendBatch.size() + size > MAX_SEND_BATCH_BYTES ) )
+	{
+		FlushSendBatch();
+	}
+
+	if ( mSendBatchCount == 0 )
+	{
+		mSendBatchAddress = mSendPacket.Address;
+		mSendBatchSegmentSize = size;
+	}
+	mSendBatch.insert( mSendBatch.end(), mSendPacket.Data, mSendPacket.Data + size );
+	++mSendBatchCount;
+
+	// Only the last datagram of a batch can be shorter
+	if ( size < mSendBatchSegmentSize )
+	{
+		FlushSendBatch();
+	}
+}
+//---------------------------------------
+void NetSession::FlushSendBatch()
+{
+	if ( mSendBatchCount == 0 )
+	{
+		return;
+	}
+
+	int sent = NetManager::udpSendSegments( mSock, mSendBatchAddress, &mSendBatch[0], mSendBatchSegmentSize, (int) mSendBatch.size() );
+	if ( mSendBatchCount > 1 )
+	{
+		mTotalPacketsBatched += sent;
+	}
+
+	mSendBatch.clear();
+	mSendBatchCount = 0;
+}
+//---------------------------------------
+void NetSession::EndSendBatch()
+{
+	if ( mSendBatchDepth > 0 && --mSendBatchDepth == 0 )
+	{
+		FlushSendBatch();
+	}
+}
+//---------------------------------------
+void NetSession::ProcessRecvPacket()
+{
+	clientID_t senderID = IdFromAddress( mRecvPacket.Address );
+
+	++mTotalPacketsRecv;
+
+	// Drop damaged and foreign datagrams before they can create a client
+	if ( mRecvPacket.DataLength > 0 && !UnsealPacket() )
+	{
+		++mTotalPacketsCorrupt;
+		if ( VerboseDebugMsg )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "Dropping corrupt packet from %u (%d bytes)\n", senderID, mRecvPacket.DataLength );
+		}
+		return;
+	}
+
+	PacketHeader header;
+	ClientInfo& info = GetClientInfo( senderID );
+	info.Address = mRecvPacket.Address;
+
+	// @TODO it might be better to check the 'request' and 'accept' flags on the packet header.
+//	if ( info.LastRecvPacketID == 0 )
+//	{
+//		// Mark new clients so we can notify client code of new connections
+//		// I don't call the callback here b/c client code might try to
+//		// modify the session state causing bad stuff to happen.
+//		mNewClients.push_back( senderID );
+//	}
+
+	// Skip packets that are empty
+	if ( mRecvPacket.DataLength > 0 )
+	{
+		if ( mRecvPacket.DataLength > mLargestPacketRcv )
+		{
+			mLargestPacketRcv = mRecvPacket.DataLength;
+		}
+
+		// Read header
+		int headerSize = ReadHeader( mRecvPacket.Data, mRecvPacket.DataLength, info, header, mRecvAcks );
+		if ( headerSize == 0 )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "Dropping malformed packet from %u (or protocol version != %d)\n", senderID, NET_PROTOCOL_VERSION );
+			return;
+		}
+
+		if ( VerboseDebugMsg )
+		{
+			ConsolePrintf( C_FG_LIGHT_GREEN, ">>>>> " );
+			ConsolePrintf( "Recv packet: id=%u size=%s\n", header.PacketID, ByteDisplay( mRecvPacket.DataLength ).ToString() );
+		}
+
+		// Check acknowledgments received
+		uint32 numAcks = header.PacketAcks;
+		if ( numAcks > 0 && info.PacketsNeedingAck.size() > 0 )
+		{
+			for ( uint32 i = 0; i < numAcks; ++i )
+			{
+				// Acknowledge packet
+				packetID_t ackID = mRecvAcks[i];
+
+				// Remove packet from list
+				info.PacketsNeedingAck.erase( 
+					std::remove_if( info.PacketsNeedingAck.begin(), info.PacketsNeedingAck.end(), [&]( AckInfo*& ackInfo ) -> bool
+					{
+						bool _ret = ackInfo->PacketID == ackID;
+						if ( _ret )
+						{
+							if ( VerboseDebugMsg )
+							{
+								ConsolePrintf( C_FG_GREEN, ">>>>> " );
+								ConsolePrintf( "ACK recv for packet %u from %u\n", ackID, senderID );
+							}
+							mAckInfoPool.Destroy( ackInfo );
+						}
+						return _ret;
+					}),
+					info.PacketsNeedingAck.end() );
+			}
+		}
+
+		// Add packet to packets needing acknowledged list
+		bool firstTimeAck = true;
+		if ( IsBitSet( header.Flags, 1 ) )
+		{
+			info.PacketsToAck.push_back( header.PacketID );
+
+			// Check if we have acknowledged this packet before
+			if ( info.PacketsAcked[ header.PacketID ] )
+			{
+				firstTimeAck = false;
+			}
+			// Mark the packet as acknowledge so we can ignore others that may arrive late
+			info.PacketsAcked[ header.PacketID ] = true;
+		}
+
+		// Do not evaluate packet further - it's a duplicate reliable packet
+		if ( !firstTimeAck )
+		{
+			if ( VerboseDebugMsg )
+			{
+				ConsolePrintf( C_FG_RED, ">>>>> " );
+				ConsolePrintf( "Ignoring packet %u (already received)\n", header.PacketID );
+			}
+			return;
+		}
+
+		// Check order - receive if new
+		bool inOrder = IsBitSet( header.Flags, 0 );
+		bool packetIsNew = header.PacketID > info.LastRecvPacketID;
+		if ( ( inOrder && packetIsNew ) || ( !inOrder ) )
+		{
+			// Update average RTT
+			double now = mNetClock->GetElapsedTime( Clock::TIME_MILLI );
+			double diff = now - header.Timestamp;
+			info.AverageRTTMS = ( 0.9 * info.AverageRTTMS ) + ( 0.1 * diff );
+
+			if ( packetIsNew )
+				info.LastRecvPacketID = header.PacketID;
+
+			// Packet was requesting connection
+			if ( IsBitSet( header.Flags, 2 ) )
+			{
+				SendAcceptMessage( mRecvPacket.Address );
+				mNewClients.push_back( senderID );
+			}
+
+			// Packet was response to requesting connection
+			if ( IsBitSet( header.Flags, 3 ) )
+			{
+				ConsolePrintf( C_FG_GREEN, ">>>>> " );
+				ConsolePrintf( "Connection Accepted\n" );
+				mNewClients.push_back( senderID );
+			}
+
+			// Packet was informing disconnect
+			if ( IsBitSet( header.Flags, 4 ) )
+			{
+				ConsolePrintf( C_FG_YELLOW, ">>>>> " );
+				ConsolePrintf( "Removing client (disconnected) %u\n", senderID );
+				AddDeadClient( info );
+				RemoveClientInfo( mClientInfos.find( senderID ) );
+				return;
+			}
+
+			// Packet is informing timesync
+			if ( IsBitSet( header.Flags, 5 ) )
+			{
+				ConsolePrintf( C_FG_WHITE, ">>>>> " );
+				ConsolePrintf( "Syncing client time to server %f\n", header.Timestamp );
+				info.AverageRTTMS = 0.0;
+				mNetClock->SetTime( header.Timestamp / 1000.0 );
+			}
+
+			// If there is user data copy it over to the client (headerSize includes the acks)
+			int clientDataSize = mRecvPacket.DataLength - headerSize;
+			if ( clientDataSize > 0 )
+			{
+				udpPacket* packet = new udpPacket( mRecvPacket.DataLength );
+
+				// Copy user data - stripping header and acks
+				packet->DataLength = clientDataSize;
+				memcpy( packet->Data, mRecvPacket.Data + headerSize, packet->DataLength );
+				packet->Timestamp = header.Timestamp;
+				info.PacketQueue.push( packet );
+				mReadyClients.push_back( &info );
+			}
+		}
+		else
+		{
+			ConsolePrintf( "Ignoring out-of-order packet : %d\n", header.PacketID );
+		}
+	}
+	else
+	{
+		ConsolePrintf( "Received empty packet... ignoring\n" );
+	}
+}
+//---------------------------------------
 LocalClient& NetSession::CreateLocalClient()
 {
 	mLocalClient.SetSession( this );
@@ -304,36 +604,44 @@ LocalClient& NetSession::CreateLocalClient()
 //---------------------------------------
 bool NetSession::PacketIsReady()
 {
-	for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
-	{
-		if ( itr->second.IsPacketReady() )
-			return true;
-	}
-	return false;
+	return GetNextReadyClient() != NULL;
 }
 //---------------------------------------
 bool NetSession::PacketIsReady( clientID_t clientID )
 {
-	return mClientInfos[ clientID ].IsPacketReady();
+	return GetClientInfo( clientID ).IsPacketReady();
 }
 //---------------------------------------
 void NetSession::ReceiveData( PacketReader& reader, NetClient& sender )
 {
-	for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
+	ClientInfo* info = GetNextReadyClient();
+	if ( info )
 	{
-		if ( itr->second.IsPacketReady() )
-		{
-			ReceiveData( reader, itr->first );
-			sender.mID = itr->first;
-			sender.Address = itr->second.Address;
-			break;
-		}
+		mReadyClients.pop_front();
+		PopPacket( reader, *info );
+		sender.mID = info->ID;
+		sender.Address = info->Address;
 	}
 }
 //---------------------------------------
 void NetSession::ReceiveData( PacketReader& reader, clientID_t clientID )
 {
-	ClientInfo& info = mClientInfos[ clientID ];
+	auto itr = mClientInfos.find( clientID );
+	if ( itr == mClientInfos.end() || !itr->second.IsPacketReady() )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "NetSession : No packet ready from client %u\n", clientID );
+		return;
+	}
+
+	// The packet's entry is the client's first, take it out so the others stay in arrival order
+	ClientInfo* info = &itr->second;
+	mReadyClients.erase( std::find( mReadyClients.begin(), mReadyClients.end(), info ) );
+	PopPacket( reader, *info );
+}
+//---------------------------------------
+void NetSession::PopPacket( PacketReader& reader, ClientInfo& info )
+{
+	assertion( !info.PacketQueue.empty(), "NetSession : Reading from client %u with no packets\n", info.ID );
 	udpPacket* packet = info.PacketQueue.front();
 
 	// Give user data to client
@@ -346,21 +654,62 @@ void NetSession::ReceiveData( PacketReader& reader, clientID_t clientID )
 }
 //---------------------------------------
 void NetSession::SendData( PacketWriter& data, IPaddress& addr, int opts, bool clearOnSend )
+{
+	SendRaw( data.Data(), data.Size(), addr, opts );
+
+	// Clear writer after send
+	if ( clearOnSend )
+	{
+		data.Clear();
+	}
+}
+//---------------------------------------
+void NetSession::SendRaw( const uint8* data, int size, const IPaddress& addr, int opts )
+{
+	ClientInfo& info = GetClientInfo( IdFromAddress( addr ) );
+
+	// In case address is not current (like on first sendto)
+	info.Address = addr;
+
+	int priority = SENDPRI_NORMAL;
+	if ( opts & ( SENDOPT_CONNECT_REQUEST | SENDOPT_CONNECT_ACCEPT | SENDOP_DISCONNECT ) )
+		priority = SENDPRI_CONTROL;
+	else if ( opts & SENDOPT_RELIABLE )
+		priority = SENDPRI_RELIABLE;
+	else if ( opts & SENDOPT_LOW_PRIORITY )
+		priority = SENDPRI_LOW;
+
+	// Unlimited clients and connection control go straight out
+	if ( info.BytesPerSecond <= 0 || priority == SENDPRI_CONTROL )
+	{
+		SendNow( info, data, size, opts );
+	}
+	else
+	{
+		QueuedPacket* packet = new QueuedPacket();
+		packet->Data.assign( data, data + size );
+		packet->Opts = opts;
+		packet->TimeQueued = Clock::QueryTime();
+
+		info.SendQueue[ priority ].push_back( packet );
+		info.QueuedBytes += size;
+
+		FlushSendQueue( info, packet->TimeQueued );
+	}
+}
+//---------------------------------------
+void NetSession::SendNow( ClientInfo& info, const uint8* data, int size, int opts )
 {
 
 	/* Packet Structure
 	 * [Header][Acks][UserData]
 	 */
-	ClientInfo& info = mClientInfos[ IdFromAddress( addr ) ];
 	PacketHeader header;
 
-	// In case address is not current (like on first sendto)
-	info.Address = addr;
-
 	++mTotalPacketsSent;
 
 	// Resize if needed
-	int requiredSize = data.Size() + sizeof( PacketHeader ) + info.PacketsToAck.size() * sizeof( packetID_t );
+	int requiredSize = size + MAX_HEADER_SIZE + info.PacketsToAck.size() * ACK_SIZE + CRC_SIZE;
 	if ( mSendPacket.MaxDataLength < requiredSize )
 	{
 		ConsolePrintf( C_FG_AQUA, ">>>>> " );
@@ -403,24 +752,30 @@ void NetSession::SendData( PacketWriter& data, IPaddress& addr, int opts, bool c
 	if ( IsBitSet( opts, 4 ) )
 		SetBit( header.Flags, 4 );	// Packet is informing disconnect
 	*/
-	header.Flags = opts;
+	header.Flags = opts & SENDOPT_HEADER_FLAGS;
 
 	// Record last time we sent a packet
 	info.LastSendTime = header.Timestamp;
 
 	// If this packet is to be acknowledge, we need to record the data
 	//  in case we need to resend it
-	if ( opts & SENDOPT_RELIABLE )
+	AckInfo* ackInfo = ( opts & SENDOPT_RELIABLE ) ? mAckInfoPool.Create() : NULL;
+	if ( ( opts & SENDOPT_RELIABLE ) && !ackInfo )
+	{
+		// Still worth sending once, it just won't be resent if it's lost
+		ConsolePrintf( CONSOLE_ERROR, "NetSession : Out of memory tracking packet %u, sending it unreliably\n", header.PacketID );
+		header.Flags &= ~SENDOPT_RELIABLE;
+	}
+
+	if ( ackInfo )
 	{
 //		ConsolePrintf( "Packet %u is RELIABLE. Coping data...\n", header.PacketID );
 
-		AckInfo* ackInfo = new AckInfo();
-		
 		// Store data in case we need to resend it
 		ackInfo->PacketID = header.PacketID;
-		ackInfo->Packet.Resize( data.Size() );
-		memcpy( ackInfo->Packet.Data, data.Data(), data.Size() );
-		ackInfo->Packet.DataLength = data.Size();
+		ackInfo->Packet.Resize( size );
+		memcpy( ackInfo->Packet.Data, data, size );
+		ackInfo->Packet.DataLength = size;
 		ackInfo->TimeLastSent = header.Timestamp;
 		ackInfo->Flags = header.Flags;
 		info.PacketsAcked[ header.PacketID ] = false;
@@ -431,27 +786,32 @@ void NetSession::SendData( PacketWriter& data, IPaddress& addr, int opts, bool c
 	// Packets we received but need to acknowledge
 	header.PacketAcks = info.PacketsToAck.size();
 
-	// Write header
-	memcpy( mSendPacket.Data, &header, sizeof( PacketHeader ) );
+	// Write header and acknowledgments (if any)
+	int headerSize = WriteHeader( mSendPacket.Data, header, info.PacketsToAck.data() );
+	info.PacketsToAck.clear();
 
-	// Write acknowledgments (if any)
-	if ( header.PacketAcks > 0 )
+	// Write user data
+	if ( size > 0 )
 	{
-		memcpy( mSendPacket.Data + sizeof( PacketHeader ), info.PacketsToAck.data(), header.PacketAcks * sizeof( packetID_t ) );
-		info.PacketsToAck.clear();
+		memcpy( mSendPacket.Data + headerSize, data, size );
 	}
 
-	// Write user data
-	memcpy( mSendPacket.Data + sizeof( PacketHeader ) + header.PacketAcks * sizeof( packetID_t ), data.Data(), data.Size() );
-
 	//mSendPacket.Data = (uint8*)data.Data();
-	mSendPacket.DataLength = requiredSize;
-	mSendPacket.Address = addr;
+	mSendPacket.DataLength = headerSize + size;
+	mSendPacket.Address = info.Address;
+	SealPacket();
+
+	mTotalBytesSent += mSendPacket.DataLength;
+	mTotalHeaderBytesSent += headerSize + CRC_SIZE;
+	if ( info.BytesPerSecond > 0 )
+	{
+		info.Tokens -= mSendPacket.DataLength;
+	}
 
 	// Simulated packet loss
 	if ( mPacketLoss && ( rand() % 100 ) <= mPacketLoss )
 	{
-		mSendPacket.Status = data.Size();
+		mSendPacket.Status = size;
 		if ( VerboseDebugMsg )
 		{
 			ConsolePrintf( C_FG_LIGHT_YELLOW, ">>>>> " );
@@ -466,13 +826,7 @@ void NetSession::SendData( PacketWriter& data, IPaddress& addr, int opts, bool c
 			ConsolePrintf( C_FG_GREEN, "<<<<< " );
 			ConsolePrintf( "Sent packet %u\n", header.PacketID );
 		}
-		NetManager::udpSendPacket( mSock, mSendPacket );
-	}
-
-	// Clear writer after send
-	if ( clearOnSend )
-	{
-		data.Clear();
+		SendPacket();
 	}
 }
 //---------------------------------------
@@ -485,6 +839,168 @@ void NetSession::SendData( PacketWriter& data, int opts )
 	data.Clear();
 }
 //---------------------------------------
+void NetSession::EnablePostQueue( int maxMessages, int maxMessageSize )
+{
+	if ( mPostQueue )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "NetSession : Post queue already enabled\n" );
+		return;
+	}
+
+	mMaxPostSize = maxMessageSize;
+	mPostMessages = new PostedMessage[ maxMessages ];
+	mPostData = new uint8[ maxMessages * maxMessageSize ];
+	mPostFree = new LockFreeQueue< PostedMessage* >( maxMessages );
+	mPostQueue = new LockFreeQueue< PostedMessage* >( maxMessages );
+
+	for ( int i = 0; i < maxMessages; ++i )
+	{
+		mPostMessages[i].Data = mPostData + i * maxMessageSize;
+		mPostFree->TryPush( &mPostMessages[i] );
+	}
+}
+//---------------------------------------
+bool NetSession::PostData( const uint8* data, int size, const IPaddress& addr, int opts )
+{
+	PostedMessage* message;
+	if ( !mPostQueue || size > mMaxPostSize || !mPostFree->TryPop( message ) )
+	{
+		AtomicIncrement( &mTotalPostsDropped );
+		return false;
+	}
+
+	memcpy( message->Data, data, size );
+	message->Size = size;
+	message->Address = addr;
+	message->Opts = opts;
+	message->Broadcast = false;
+
+	// Can't fail, there are only as many messages as the queue holds
+	mPostQueue->TryPush( message );
+	return true;
+}
+//---------------------------------------
+bool NetSession::PostData( PacketWriter& data, const IPaddress& addr, int opts )
+{
+	return PostData( data.Data(), data.Size(), addr, opts );
+}
+//---------------------------------------
+bool NetSession::PostData( PacketWriter& data, int opts )
+{
+	PostedMessage* message;
+	if ( !mPostQueue || data.Size() > mMaxPostSize || !mPostFree->TryPop( message ) )
+	{
+		AtomicIncrement( &mTotalPostsDropped );
+		return false;
+	}
+
+	memcpy( message->Data, data.Data(), data.Size() );
+	message->Size = data.Size();
+	message->Opts = opts;
+	message->Broadcast = true;
+
+	mPostQueue->TryPush( message );
+	return true;
+}
+//---------------------------------------
+void NetSession::FlushPostedData()
+{
+	if ( !mPostQueue )
+		return;
+
+	PostedMessage* message;
+	BeginSendBatch();
+	while ( mPostQueue->TryPop( message ) )
+	{
+		if ( message->Broadcast )
+		{
+			for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
+			{
+				SendRaw( message->Data, message->Size, itr->second.Address, message->Opts );
+			}
+		}
+		else
+		{
+			SendRaw( message->Data, message->Size, message->Address, message->Opts );
+		}
+		mPostFree->TryPush( message );
+	}
+	EndSendBatch();
+}
+//---------------------------------------
+void NetSession::SetClientBandwidth( clientID_t clientID, uint32 bytesPerSecond )
+{
+	ClientInfo& info = GetClientInfo( clientID );
+	info.BytesPerSecond = bytesPerSecond;
+	info.MaxBytesPerSecond = bytesPerSecond;
+	info.Tokens = GetBurstBytes( info );
+	info.LastRefillTime = Clock::QueryTime();
+
+	// Going unlimited, nothing to wait on anymore
+	if ( bytesPerSecond == 0 )
+	{
+		FlushSendQueue( info, info.LastRefillTime );
+	}
+}
+//---------------------------------------
+uint32 NetSession::GetClientBandwidth( clientID_t clientID ) const
+{
+	auto itr = mClientInfos.find( clientID );
+	return itr != mClientInfos.end() ? (uint32) itr->second.BytesPerSecond : 0;
+}
+//---------------------------------------
+int NetSession::GetQueuedBytes( clientID_t clientID ) const
+{
+	auto itr = mClientInfos.find( clientID );
+	return itr != mClientInfos.end() ? itr->second.QueuedBytes : 0;
+}
+//---------------------------------------
+void NetSession::FlushSendQueues()
+{
+	double now = Clock::QueryTime();
+	BeginSendBatch();
+	for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
+	{
+		FlushSendQueue( itr->second, now );
+	}
+	EndSendBatch();
+}
+//---------------------------------------
+double NetSession::GetTimeUntilNextSend() const
+{
+	double now = Clock::QueryTime();
+	double wait = -1;
+
+	for ( auto itr = mClientInfos.begin(); itr != mClientInfos.end(); ++itr )
+	{
+		const ClientInfo& info = itr->second;
+
+		// Next packet out is the front of the highest priority queue
+		const QueuedPacket* packet = 0;
+		for ( int i = 0; i < SENDPRI_COUNT && !packet; ++i )
+		{
+			if ( !info.SendQueue[i].empty() )
+				packet = info.SendQueue[i].front();
+		}
+		if ( !packet )
+		{
+			continue;
+		}
+
+		double burst = GetBurstBytes( info );
+		double tokens = Mathd::Min( info.Tokens + ( now - info.LastRefillTime ) * info.BytesPerSecond, burst );
+		double needed = Mathd::Min( (double) ( packet->Data.size() + MAX_HEADER_SIZE ), burst );
+		double clientWait = info.BytesPerSecond > 0 ? Mathd::Max( needed - tokens, 0.0 ) / info.BytesPerSecond : 0.0;
+
+		if ( wait < 0 || clientWait < wait )
+		{
+			wait = clientWait;
+		}
+	}
+
+	return wait;
+}
+//---------------------------------------
 void NetSession::SendConnectMessage( IPaddress& addr )
 {
 	PacketWriter _empty;
@@ -505,8 +1021,8 @@ void NetSession::DropClient( clientID_t clientID )
 		ConsolePrintf( ">>>>> Removed client %u\n", itr->first );
 		PacketWriter _empty;
 		SendData( _empty, itr->second.Address, SENDOP_DISCONNECT );
-		mDeadClients.push_back( clientID );
-		mClientInfos.erase( itr );
+		AddDeadClient( itr->second );
+		RemoveClientInfo( itr );
 	}
 }
 //---------------------------------------
@@ -517,8 +1033,241 @@ void NetSession::DropAllClients()
 	{
 		ConsolePrintf( ">>>>> Removed client %u\n", itr->first );
 		SendData( _empty, itr->second.Address, SENDOP_DISCONNECT );
-		mDeadClients.push_back( itr->first );
+		AddDeadClient( itr->second );
+		DestroyPacketsNeedingAck( itr->second );
 	}
 	mClientInfos.clear();
+	mReadyClients.clear();
+}
+//---------------------------------------
+int NetSession::WriteHeader( uint8* dest, const PacketHeader& header, const packetID_t* acks )
+{
+	uint8* p = dest;
+	uint32 timeMS = (uint32) header.Timestamp;
+
+	*p++ = (uint8) NET_PROTOCOL_VERSION;
+	*p++ = (uint8) header.Flags;
+	*p++ = (uint8) header.PacketID;
+	*p++ = (uint8) ( header.PacketID >> 8 );
+
+	// Timesync packets carry the full time, everything else just enough for a synced peer to recover it
+	if ( header.Flags & SENDOP_TIMESYNC )
+	{
+		p += WriteVarUInt( p, timeMS );
+	}
+	else
+	{
+		*p++ = (uint8) timeMS;
+		*p++ = (uint8) ( timeMS >> 8 );
+	}
+
+	p += WriteVarUInt( p, header.PacketAcks );
+	for ( uint32 i = 0; i < header.PacketAcks; ++i )
+	{
+		*p++ = (uint8) acks[i];
+		*p++ = (uint8) ( acks[i] >> 8 );
+	}
+
+	return (int) ( p - dest );
+}
+//---------------------------------------
+int NetSession::ReadHeader( const uint8* src, int size, const ClientInfo& info, PacketHeader& header, std::vector< packetID_t >& acks )
+{
+	const uint8* p = src;
+	const uint8* end = src + size;
+	uint32 value;
+	int n;
+
+	// Version and the unused flag bits must match
+	if ( size < 4 || p[0] != NET_PROTOCOL_VERSION || ( p[1] & 0xC0 ) != 0 )
+	{
+		return 0;
+	}
+
+	header.Flags = p[1];
+	header.PacketID = Unwrap16( (uint16) ( p[2] | ( p[3] << 8 ) ), info.LastRecvPacketID );
+	p += 4;
+
+	if ( header.Flags & SENDOP_TIMESYNC )
+	{
+		if ( ( n = ReadVarUInt( p, (int) ( end - p ), value ) ) == 0 )
+			return 0;
+		header.Timestamp = value;
+		p += n;
+	}
+	else
+	{
+		if ( end - p < 2 )
+			return 0;
+		uint32 now = (uint32) mNetClock->GetElapsedTime( Clock::TIME_MILLI );
+		header.Timestamp = Unwrap16( (uint16) ( p[0] | ( p[1] << 8 ) ), now );
+		p += 2;
+	}
+
+	if ( ( n = ReadVarUInt( p, (int) ( end - p ), value ) ) == 0 )
+		return 0;
+	p += n;
+	if ( value > (uint32) ( end - p ) / ACK_SIZE )
+		return 0;
+	header.PacketAcks = value;
+
+	// Acks are for packets we sent this client
+	acks.resize( header.PacketAcks );
+	for ( uint32 i = 0; i < header.PacketAcks; ++i, p += ACK_SIZE )
+	{
+		acks[i] = Unwrap16( (uint16) ( p[0] | ( p[1] << 8 ) ), info.LastSendPacketID );
+	}
+
+	return (int) ( p - src );
+}
+//---------------------------------------
+NetSession::ClientInfo& NetSession::GetClientInfo( clientID_t clientID )
+{
+	auto itr = mClientInfos.find( clientID );
+	if ( itr != mClientInfos.end() )
+	{
+		return itr->second;
+	}
+
+	ClientInfo& info = mClientInfos[ clientID ];
+	info.ID = clientID;
+	info.BytesPerSecond = mDefaultBandwidth;
+	info.MaxBytesPerSecond = mDefaultBandwidth;
+	info.Tokens = GetBurstBytes( info );
+	info.LastRefillTime = Clock::QueryTime();
+	info.LastAdaptTime = info.LastRefillTime;
+	return info;
+}
+//---------------------------------------
+void NetSession::AddDeadClient( const ClientInfo& info )
+{
+	DeadClient dead;
+	dead.ID = info.ID;
+	dead.Address = info.Address;
+	mDeadClients.push_back( dead );
+}
+//---------------------------------------
+double NetSession::GetAverageRTT( clientID_t clientID ) const
+{
+	auto itr = mClientInfos.find( clientID );
+	return itr != mClientInfos.end() ? itr->second.AverageRTTMS : 0.0;
+}
+//---------------------------------------
+void NetSession::RemoveClientInfo( std::map< clientID_t, ClientInfo >::iterator itr )
+{
+	// Only happens on disconnect so the scan is fine
+	ClientInfo* info = &itr->second;
+	mReadyClients.erase( std::remove( mReadyClients.begin(), mReadyClients.end(), info ), mReadyClients.end() );
+	DestroyPacketsNeedingAck( *info );
+	mClientInfos.erase( itr );
+}
+//---------------------------------------
+void NetSession::DestroyPacketsNeedingAck( ClientInfo& info )
+{
+	for ( auto itr = info.PacketsNeedingAck.begin(); itr != info.PacketsNeedingAck.end(); ++itr )
+	{
+		mAckInfoPool.Destroy( *itr );
+	}
+	info.PacketsNeedingAck.clear();
+}
+//---------------------------------------
+NetSession::ClientInfo* NetSession::GetNextReadyClient()
+{
+	if ( mReadyClients.empty() )
+	{
+		return NULL;
+	}
+
+	ClientInfo* info = mReadyClients.front();
+	DebugAsssertion( info->IsPacketReady(), "NetSession : Ready entry for client %u with no packets\n", info->ID );
+	return info;
+}
+//---------------------------------------
+bool NetSession::HasBandwidthFor( ClientInfo& info, int bytes, double now )
+{
+	if ( info.BytesPerSecond <= 0 )
+	{
+		return true;
+	}
+
+	double burst = GetBurstBytes( info );
+	info.Tokens = Mathd::Min( info.Tokens + ( now - info.LastRefillTime ) * info.BytesPerSecond, burst );
+	info.LastRefillTime = now;
+
+	// Datagrams bigger than the bucket go when it's full and leave it in debt
+	return info.Tokens >= Mathd::Min( (double) bytes, burst );
+}
+//---------------------------------------
+double NetSession::GetBurstBytes( const ClientInfo& info ) const
+{
+	return Mathd::Max( info.BytesPerSecond * MAX_BURST_TIME, MIN_BURST_BYTES );
+}
+//---------------------------------------
+void NetSession::FlushSendQueue( ClientInfo& info, double now )
+{
+	int priority = SENDPRI_RELIABLE;
+	while ( priority < SENDPRI_COUNT )
+	{
+		std::deque< QueuedPacket* >& queue = info.SendQueue[ priority ];
+		if ( queue.empty() )
+		{
+			++priority;
+			continue;
+		}
+
+		QueuedPacket* packet = queue.front();
+		int size = (int) packet->Data.size();
+
+		// Stale state isn't worth the bandwidth, newer state will follow
+		if ( priority == SENDPRI_LOW && now - packet->TimeQueued > MAX_LOW_PRIORITY_AGE )
+		{
+			++mTotalPacketsDropped;
+		}
+		else if ( HasBandwidthFor( info, size + MAX_HEADER_SIZE, now ) )
+		{
+			SendNow( info, size ? &packet->Data[0] : 0, size, packet->Opts );
+		}
+		else
+		{
+			break;
+		}
+
+		queue.pop_front();
+		info.QueuedBytes -= size;
+		delete packet;
+	}
+}
+//---------------------------------------
+void NetSession::AdaptBandwidth( ClientInfo& info, double now )
+{
+	if ( info.MaxBytesPerSecond <= 0 )
+	{
+		return;
+	}
+
+	double dt = now - info.LastAdaptTime;
+	info.LastAdaptTime = now;
+
+	// Latency climbing well above its floor means queues are building somewhere on the path
+	if ( info.AverageRTTMS > 0 && ( info.MinRTT == 0 || info.AverageRTTMS < info.MinRTT ) )
+	{
+		info.MinRTT = info.AverageRTTMS;
+	}
+	bool congested = info.LostPacket || ( info.MinRTT > 0 && info.AverageRTTMS > info.MinRTT * 2.0 + RTT_SLACK_MS );
+	info.LostPacket = false;
+
+	// Multiplicative decrease, additive increase
+	if ( congested )
+	{
+		if ( now - info.LastDecreaseTime > BACKOFF_INTERVAL )
+		{
+			info.BytesPerSecond = Mathd::Max( info.BytesPerSecond * BANDWIDTH_BACKOFF, Mathd::Min( MIN_BANDWIDTH, info.MaxBytesPerSecond ) );
+			info.LastDecreaseTime = now;
+		}
+	}
+	else
+	{
+		info.BytesPerSecond = Mathd::Min( info.BytesPerSecond + info.MaxBytesPerSecond * BANDWIDTH_GROWTH * dt, info.MaxBytesPerSecond );
+	}
 }
 //---------------------------------------
\ No newline at end of file
@@ -24,20 +24,50 @@ namespace mage
 		void SetMaxPacketSize( int size )				{ mRecvPacket.Resize( size ); }
 
 		void OpenPort( uint16 port );
+		// Use the UdpOffloadFlags the system supports on the session port. Applies to ports opened later too.
+		// Returns the offloads enabled, 0 if the port isn't open yet.
+		int EnableOffload( int offloads );
 		void OnUpdate( /*float dt*/ );
+		// Block until a packet arrives on the session port or timeoutUS (microseconds) passes
+		bool WaitForPacket( uint32 timeoutUS );
+		// WaitForPacket on the file I/O worker, true if a packet is ready. Receive it on the main thread,
+		// from OnUpdate or a ThenOnMainThread step. Only one wait runs at a time, calling this again
+		// before it is done returns the same task. The wait holds the file I/O worker, keep timeoutUS short.
+		Task< bool > WaitForPacketAsync( uint32 timeoutUS );
+
+		// Record every datagram sent and received to a capture file (see NetCapture.h)
+		bool StartCapture( const char* filename );
+		void StopCapture();
+		bool IsCapturing() const						{ return mCapture.IsOpen(); }
+		// Process a datagram as if it was received from address at the given net time (ms).
+		// Used to replay captures, call OnUpdate() after to dispatch callbacks.
+		void InjectPacket( const IPaddress& from, const uint8* data, int length, double netTimeMS );
 
 		LocalClient& CreateLocalClient();
 
-		// Poll if a packet is ready to be read
+		// Poll if a packet is ready to be read, from any client
 		bool PacketIsReady();
 		bool PacketIsReady( clientID_t clientID );
-		// Read last received data into a PacketReader
+		// Read the oldest received data from any client into a PacketReader
 		void ReceiveData( PacketReader& reader, NetClient& sender );
 		void ReceiveData( PacketReader& reader, clientID_t clientID );
+		// Packets received and not read yet, from all clients
+		int GetNumPacketsReady() const					{ return (int) mReadyClients.size(); }
 		// Send data to address. data will be cleared out if sent
 		void SendData( PacketWriter& data, IPaddress& addr, int opts, bool clearOnSend=true );
 		// Send data to all NetClients
 		void SendData( PacketWriter& data, int opts );
+		// Thread safe sending for worker threads. Posted data is copied into a preallocated buffer and sent
+		// on the session's thread by the next OnUpdate. Call once, before any thread posts.
+		void EnablePostQueue( int maxMessages=256, int maxMessageSize=1400 );
+		// Queue data to send to addr from any thread. Never blocks or allocates.
+		// Returns false and drops the data if the queue is full, too large, or not enabled.
+		bool PostData( const uint8* data, int size, const IPaddress& addr, int opts );
+		bool PostData( PacketWriter& data, const IPaddress& addr, int opts );
+		// Queue data to send to all NetClients from any thread
+		bool PostData( PacketWriter& data, int opts );
+		// Send everything posted so far. OnUpdate does this.
+		void FlushPostedData();
 		// Send a connection request message
 		void SendConnectMessage( IPaddress& addr );
 		// Send a connection accept message
@@ -50,14 +80,45 @@ namespace mage
 		void RegisterClientConnectCallback( ClientConnectCB cb ) { mClientConnectCB = cb; }
 		void RegisterClientDisconnectCallback( ClientConnectCB cb ) { mClientDisconnectCB = cb; }
 
+		// Limit bytes/sec sent to a client, 0 for unlimited. Data over the limit is queued by
+		// priority (control, reliable, normal, SENDOPT_LOW_PRIORITY) and paced out as the budget refills.
+		void SetClientBandwidth( clientID_t clientID, uint32 bytesPerSecond );
+		// Limit given to clients as they connect. default=0 (unlimited)
+		void SetDefaultBandwidth( uint32 bytesPerSecond )	{ mDefaultBandwidth = bytesPerSecond; }
+		// Back off a client's limit on resends and rising latency, then grow it back to the configured limit
+		void SetAdaptiveBandwidth( bool adaptive )			{ mAdaptiveBandwidth = adaptive; }
+		// Send queued data the budget allows. OnUpdate does this, call it more often to spread sends over a tick.
+		void FlushSendQueues();
+		// Seconds until queued data can go out, or -1 if nothing is queued
+		double GetTimeUntilNextSend() const;
+		// Between these, datagrams of the same size in a row to one address are sent with a single
+		// segmented send when UDPOFFLOAD_SEND_SEGMENTS is on. OnUpdate batches its own sends.
+		void BeginSendBatch()								{ ++mSendBatchDepth; }
+		void EndSendBatch();
+
 		void SetPacketLoss( int packetLoss )				{ mPacketLoss = packetLoss; }
-		double GetAverageRTT( clientID_t clientID )			{ return mClientInfos[clientID].AverageRTTSeconds; }
+		// Smoothed round trip time (ms)
+		double GetAverageRTT( clientID_t clientID ) const;
 		int GetMaxSentPacketSize() const					{ return mSendPacket.MaxDataLength; }
 		int GetMaxRecvPacketSize() const					{ return mLargestPacketRcv; }
 		int GetLastSentPacketSize() const					{ return mSendPacket.DataLength; }
 		int GetLastRecvPacketSize() const					{ return mRecvPacket.DataLength; }
 		int GetTotalPacketsSent() const						{ return mTotalPacketsSent; }
 		int GetTotalPacketsRecv() const						{ return mTotalPacketsRecv; }
+		// Bytes sent including headers, and the part of that spent on headers and acks
+		uint32 GetTotalBytesSent() const					{ return mTotalBytesSent; }
+		uint32 GetTotalHeaderBytesSent() const				{ return mTotalHeaderBytesSent; }
+		// Current bandwidth limit (0 if unlimited) and data waiting on it
+		uint32 GetClientBandwidth( clientID_t clientID ) const;
+		int GetQueuedBytes( clientID_t clientID ) const;
+		// Low priority packets dropped after waiting too long for bandwidth
+		uint32 GetTotalPacketsDropped() const				{ return mTotalPacketsDropped; }
+		// Datagrams dropped for failing the checksum or being too short
+		uint32 GetTotalPacketsCorrupt() const				{ return mTotalPacketsCorrupt; }
+		// Posts that didn't fit in the post queue
+		uint32 GetTotalPostsDropped() const					{ return (uint32) mTotalPostsDropped; }
+		// Datagrams sent in runs of more than one by a send batch
+		uint32 GetTotalPacketsBatched() const				{ return mTotalPacketsBatched; }
 		double GetNetTimeSeconds() const					{ return mNetClock->GetElapsedTime( Clock::TIME_SEC ); }
 
 		bool VerboseDebugMsg;
@@ -66,18 +127,60 @@ namespace mage
 		int mLargestPacketRcv;
 		int mTotalPacketsSent;
 		int mTotalPacketsRecv;
+		uint32 mTotalBytesSent;
+		uint32 mTotalHeaderBytesSent;
+		uint32 mTotalPacketsDropped;
+		uint32 mTotalPacketsBatched;
+		uint32 mTotalPacketsCorrupt;
+		uint32 mDefaultBandwidth;
+		bool mAdaptiveBandwidth;
 
 		ClientConnectCB mClientConnectCB;
 		ClientConnectCB mClientDisconnectCB;
 		std::vector< clientID_t > mNewClients;
-		std::vector< clientID_t > mDeadClients;
+		// Removed clients are gone from mClientInfos by the time their callback fires, so keep the address
+		struct DeadClient
+		{
+			clientID_t ID;
+			IPaddress Address;
+		};
+		std::vector< DeadClient > mDeadClients;
 
 		Clock* mNetClock;					// Keep track of time for when send/recv packets
 		double mReliableResendTimeout;		// How long to wait before resending reliable packets (ms)
 
 		udpSocket_t mSock;
+		Task< bool > mWaitTask;				// WaitForPacketAsync's job selects on mSock's handle, finished before it is closed
 		udpPacket mSendPacket;
 		udpPacket mRecvPacket;
+		uint32 mCrcSeed;					// Checksum of NET_PROTOCOL_ID, every packet checksum continues from it
+		int mOffloads;						// Requested UdpOffloadFlags
+		int mEnabledOffloads;
+
+		// Datagrams waiting to go out in one segmented send
+		int mSendBatchDepth;
+		std::vector< uint8 > mSendBatch;
+		IPaddress mSendBatchAddress;
+		int mSendBatchSegmentSize;
+		int mSendBatchCount;
+
+		// Data posted from other threads. Buffers cycle from mPostFree to mPostQueue and back.
+		struct PostedMessage
+		{
+			IPaddress Address;
+			int Opts;
+			int Size;
+			bool Broadcast;
+			uint8* Data;
+		};
+		PostedMessage* mPostMessages;
+		uint8* mPostData;
+		int mMaxPostSize;
+		LockFreeQueue< PostedMessage* >* mPostFree;
+		LockFreeQueue< PostedMessage* >* mPostQueue;
+		volatile int32 mTotalPostsDropped;
+
+		NetCaptureWriter mCapture;
 
 		LocalClient mLocalClient;
 		//std::vector< NetClient > mNetClients;
@@ -90,13 +193,43 @@ namespace mage
 			uint32	   Flags;				// Header flags this packet was sent with
 		};
 
+		// Every reliable send makes one, so they come from a pool. Declared before mClientInfos so it outlives them.
+		ObjectPool< AckInfo > mAckInfoPool;
+
+		// Order queued packets go out in when a client's bandwidth is limited
+		enum SendPriority
+		{
+			SENDPRI_CONTROL,				// Connect/accept/disconnect, never queued
+			SENDPRI_RELIABLE,
+			SENDPRI_NORMAL,
+			SENDPRI_LOW,
+			SENDPRI_COUNT
+		};
+
+		struct QueuedPacket
+		{
+			std::vector< uint8 > Data;
+			int Opts;
+			double TimeQueued;				// Real time (sec)
+		};
+
 		struct ClientInfo
 		{
 			ClientInfo()
-				: LastRecvPacketID( 0 )
+				: ID( 0 )
+				, LastRecvPacketID( 0 )
 				, LastSendPacketID( 0 )
 				, LastSendTime( 0 )
-				, AverageRTTSeconds( 0 )
+				, AverageRTTMS( 0 )
+				, BytesPerSecond( 0 )
+				, MaxBytesPerSecond( 0 )
+				, Tokens( 0 )
+				, LastRefillTime( 0 )
+				, LastAdaptTime( 0 )
+				, LastDecreaseTime( 0 )
+				, MinRTT( 0 )
+				, LostPacket( false )
+				, QueuedBytes( 0 )
 			{}
 			~ClientInfo()
 			{
@@ -106,9 +239,14 @@ namespace mage
 					delete p;
 					PacketQueue.pop();
 				}
-				DestroyVector( PacketsNeedingAck );
+				// PacketsNeedingAck belong to mAckInfoPool
+				for ( int i = 0; i < SENDPRI_COUNT; ++i )
+				{
+					DestroyVector( SendQueue[i] );
+				}
 			}
 			bool IsPacketReady() const { return !PacketQueue.empty(); }
+			clientID_t ID;
 			std::queue< udpPacket* > PacketQueue;							// Packets from this client
 			IPaddress Address;												// Clients address
 			packetID_t LastRecvPacketID;									// LastID received from this client
@@ -117,10 +255,83 @@ namespace mage
 			std::vector< AckInfo* > PacketsNeedingAck;						// Packets sent to this client needing acknowledgment
 			std::vector< packetID_t > PacketsToAck;							// Packets this client needs to acknowledge
 			std::map< packetID_t, bool > PacketsAcked;
-			double AverageRTTSeconds;
+			double AverageRTTMS;
+
+			// Token bucket
+			double BytesPerSecond;											// Current limit, 0 for unlimited
+			double MaxBytesPerSecond;										// Configured limit the adaptive limit grows back to
+			double Tokens;													// Bytes we can send right now
+			double LastRefillTime;											// Real time tokens were last added (sec)
+			double LastAdaptTime;
+			double LastDecreaseTime;
+			double MinRTT;													// Lowest AverageRTTMS seen
+			bool LostPacket;												// Resent anything since the limit was last adapted
+			int QueuedBytes;
+			std::deque< QueuedPacket* > SendQueue[ SENDPRI_COUNT ];		// Waiting on bandwidth
 		};
 
 		std::map< clientID_t, ClientInfo > mClientInfos;
+		// One entry per packet queued on a client, in arrival order. Reading by client ID
+		// removes that client's first entry, so the entries always match the queued packets.
+		std::deque< ClientInfo* > mReadyClients;
+		std::vector< packetID_t > mRecvAcks;			// Acks read from the last received header
+
+		// Largest possible header not counting acks (version, flags, id, varint timestamp, varint ack count)
+		static const int MAX_HEADER_SIZE = 1 + 1 + 2 + 5 + 5;
+		static const int ACK_SIZE = 2;
+		static const int CRC_SIZE = 4;
+		// Segmented send limits
+		static const int MAX_SEND_BATCH_BYTES = 65000;
+		static const int MAX_SEND_BATCH_COUNT = 64;
+
+		static const double MAX_BURST_TIME;				// Bucket holds this many seconds of bandwidth (sec)
+		static const double MIN_BURST_BYTES;			// but always enough for a full datagram
+		static const double MAX_LOW_PRIORITY_AGE;		// Drop queued low priority data older than this (sec)
+		static const double MIN_BANDWIDTH;				// Adaptive limit floor (bytes/sec)
+		static const double BANDWIDTH_GROWTH;			// Fraction of the configured limit regained per loss free second
+		static const double BANDWIDTH_BACKOFF;			// Limit is scaled by this on congestion
+		static const double BACKOFF_INTERVAL;			// At most one back off per this many seconds
+		static const double RTT_SLACK_MS;				// Latency over twice the minimum plus this counts as congestion
+
+		// Find or add a client, new clients get the default bandwidth
+		ClientInfo& GetClientInfo( clientID_t clientID );
+		// Erase a client and its entries in mReadyClients
+		void RemoveClientInfo( std::map< clientID_t, ClientInfo >::iterator itr );
+		// Queue the disconnect callback for a client about to be removed
+		void AddDeadClient( const ClientInfo& info );
+		// Move the oldest packet from info into reader
+		void PopPacket( PacketReader& reader, ClientInfo& info );
+		// Give a client's unacknowledged packets back to mAckInfoPool
+		void DestroyPacketsNeedingAck( ClientInfo& info );
+		// Client the next packet is from or NULL
+		ClientInfo* GetNextReadyClient();
+		// Send or queue data to addr depending on its priority and the client's bandwidth
+		void SendRaw( const uint8* data, int size, const IPaddress& addr, int opts );
+		// Header, reliability bookkeeping and send for one datagram
+		void SendNow( ClientInfo& info, const uint8* data, int size, int opts );
+		// Add tokens for the time passed and check if bytes can be sent. Always true for unlimited clients.
+		bool HasBandwidthFor( ClientInfo& info, int bytes, double now );
+		double GetBurstBytes( const ClientInfo& info ) const;
+		void FlushSendQueue( ClientInfo& info, double now );
+		void AdaptBandwidth( ClientInfo& info, double now );
+
+		// Wait for WaitForPacketAsync's job to be done with the socket handle
+		void FinishWaitTask();
+		// Handle the datagram in mRecvPacket
+		void ProcessRecvPacket();
+		// Append the checksum to the datagram in mSendPacket
+		void SealPacket();
+		// Check and strip the checksum from the datagram in mRecvPacket
+		bool UnsealPacket();
+		// Send mSendPacket, recording it if capturing
+		void SendPacket();
+		void FlushSendBatch();
+
+		// Encode header followed by acks into dest. Returns bytes written.
+		int WriteHeader( uint8* dest, const PacketHeader& header, const packetID_t* acks );
+		// Decode the header and acks at the front of src. Packet IDs are expanded to 32 bits using info.
+		// Returns bytes read or 0 if the packet is malformed or from a different protocol version.
+		int ReadHeader( const uint8* src, int size, const ClientInfo& info, PacketHeader& header, std::vector< packetID_t >& acks );
 
 	};
 
@@ -5,6 +5,19 @@
 // Win32
 #define _WIN32_SOCKETS
 #include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <MSWSock.h>
+// UDP segmentation/receive coalescing offload (Windows 10 SDK ws2ipdef.h).
+// Older SDKs don't have them, setsockopt fails at runtime on systems without support.
+#ifndef UDP_SEND_MSG_SIZE
+#define UDP_SEND_MSG_SIZE 2
+#endif
+#ifndef UDP_RECV_MAX_COALESCED_SIZE
+#define UDP_RECV_MAX_COALESCED_SIZE 3
+#endif
+#ifndef UDP_COALESCED_INFO
+#define UDP_COALESCED_INFO 3
+#endif
 typedef int socklen_t;		// Only win64 defines this?
 #pragma comment( lib, "Ws2_32.lib" )
 
@@ -19,6 +19,7 @@ namespace mage
 	
 	typedef uint32 packetID_t;
 	typedef uint32 clientID_t;
+	typedef uint32 inputSeq_t;
 
 	// Options for out going packets
 	enum SendDataOpts
@@ -31,9 +32,37 @@ namespace mage
 		SENDOPT_CONNECT_ACCEPT			= 0x0008,
 		SENDOP_DISCONNECT				= 0x0010,
 		SENDOP_TIMESYNC  				= 0x0020,
+		SENDOPT_HEADER_FLAGS			= 0x003F,		// Options above are sent in the packet header
+
+		SENDOPT_LOW_PRIORITY			= 0x0100,		// Unreliable data that can wait behind everything else
+														// when a client's bandwidth is used up, and is dropped
+														// if it waits too long (ie. state that will be resent)
+	};
+
+	// Kernel/NIC offloads for UDP sockets, Windows only for now (see NetManager::udpEnableOffload)
+	enum UdpOffloadFlags
+	{
+		UDPOFFLOAD_NONE					= 0x0000,
+		UDPOFFLOAD_SEND_SEGMENTS		= 0x0001,		// One send call is split into equal sized datagrams
+		UDPOFFLOAD_RECV_COALESCE		= 0x0002,		// Datagrams from one sender arrive in one receive call
 	};
 
-	// Header appended to out going packets
+	// First byte of every packet. Bump when the wire format changes.
+	enum { NET_PROTOCOL_VERSION = 3 };
+	// Seeds every packet's checksum but isn't sent, so packets from other programs fail the check
+	enum { NET_PROTOCOL_ID = 0x4D4E4554 };
+
+	// Header prepended to out going packets (in memory form)
+	// On the wire (see NetSession::WriteHeader):
+	//   uint8  Version
+	//   uint8  Flags
+	//   uint16 PacketID (low 16 bits, wraps)
+	//   uint16 Timestamp (low 16 bits of ms, wraps) or varint full ms for timesync packets
+	//   varint PacketAcks
+	//   uint16 Acks[ PacketAcks ]
+	//   ...    User data
+	//   uint32 CRC-32C of NET_PROTOCOL_ID and everything above
+	// 7b + 4b checksum + 2b per ack, vs 24b + 4b per ack for the old fixed header
 	struct PacketHeader
 	{
 		double     Timestamp;			// Time packet was sent (ms)
@@ -46,7 +75,7 @@ namespace mage
 										// 4 | Disconnecting
 										// 5 | Timesync - syncs to timestamp
 		uint32     PacketAcks;			// Number of PacketID acknowledgments follow the header
-	};	// 24b (8b align)
+	};
 	
 	struct GenericSocket
 	{
@@ -58,6 +87,7 @@ namespace mage
 	typedef struct udpSocket* udpSocket_t;
 	typedef struct tcpSocket* tcpSocket_t;
 	typedef struct _SocketArray* SocketArray;
+	typedef size_t socketHandle_t;		// OS socket, SOCKET on Winsock
 	
 	// UDP Packet type
 	struct udpPacket
@@ -61,4 +61,18 @@ char* PacketReader::ReadString( char* buff, int size )
 	}
 	return buff;
 }
+//---------------------------------------
+bool PacketReader::ReadRaw( uint8* bytes, int num )
+{
+	if ( num < 0 || mPos + num > (int) mBuffer.size() )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "Buffer read fail: ReadRaw() not enough to read!\n" );
+		return false;
+	}
+	if ( num > 0 )
+	{
+		ReadBytes( bytes, num );
+	}
+	return true;
+}
 //---------------------------------------
\ No newline at end of file
@@ -37,6 +37,14 @@ namespace mage
 		// Get a null terminated string (static buffer)
 		char* ReadString( char* buff, int size );
 
+		// Copy num raw bytes out. Returns false if there is not enough data.
+		bool ReadRaw( uint8* bytes, int num );
+
+		// Unpack a message written with WriteMessage. Returns false on truncated or out of range data,
+		// or if the next message in the buffer has a different ID.
+		template< typename TMessage >
+		bool ReadMessage( TMessage& message );
+
 		double Timestamp;	// Time this data was received (ms)
 	};
 
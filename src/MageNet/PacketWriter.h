@@ -28,6 +28,16 @@ namespace mage
 		{
 			WriteBytes( (const uint8*)strz, strlen( strz ) + 1 );
 		}
+
+		// Append raw bytes, ie. a flushed BitWriter
+		void WriteRaw( const uint8* bytes, int num )
+		{
+			WriteBytes( bytes, num );
+		}
+
+		// Bit pack a message's ID then its fields using its schema (see MessageSchema.h)
+		template< typename TMessage >
+		void WriteMessage( const TMessage& message );
 	};
 
 }
\ No newline at end of file
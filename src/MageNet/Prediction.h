@@ -0,0 +1,181 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Client-side prediction and server reconciliation.
+ *   The client records numbered input commands and simulates them right away.
+ *   The server applies the inputs authoritatively and echoes back the last
+ *   input it processed along with its state. The client then rewinds to the
+ *   server state and replays the inputs the server has not seen yet.
+ *   Both sides share a user supplied fixed-step simulate function.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	//---------------------------------------
+	// Client side
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	class ClientPrediction
+	{
+	public:
+		// Advance state by one fixed step using input
+		typedef void(*SimulateFn)( TState& state, const TInput& input, float dt );
+
+		ClientPrediction( SimulateFn simulate, float fixedStep, int maxPendingInputs=64 );
+		~ClientPrediction();
+
+		// Record a new input and simulate it on state. Returns the input's sequence number.
+		inputSeq_t ApplyInput( TState& state, const TInput& input );
+		// Rewind state to the server state and replay inputs the server has not processed.
+		// Returns false if the server state is older than one already reconciled.
+		bool Reconcile( TState& state, const TState& serverState, inputSeq_t lastProcessedInput );
+		// Forget all pending inputs (ie. after a respawn). Sequence numbers keep increasing.
+		void Reset();
+
+		// Inputs not yet acknowledged by the server, oldest first
+		int GetNumPendingInputs() const							{ return (int) ( mNextSequence - mOldestPending ); }
+		inputSeq_t GetPendingSequence( int i ) const			{ return mOldestPending + i; }
+		const TInput& GetPendingInput( int i ) const			{ return mInputs[ ( mOldestPending + i ) % mInputs.size() ]; }
+		inputSeq_t GetLastAcknowledgedInput() const				{ return mLastAcknowledged; }
+		float GetFixedStep() const								{ return mFixedStep; }
+
+	private:
+		SimulateFn mSimulate;
+		float mFixedStep;
+		std::vector< TInput > mInputs;			// Ring of inputs indexed by sequence
+		inputSeq_t mNextSequence;				// Sequence given to the next input
+		inputSeq_t mOldestPending;				// Oldest input not acknowledged by the server
+		inputSeq_t mLastAcknowledged;			// Last input the server told us it processed
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Server side (one per client)
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	class ServerInputProcessor
+	{
+	public:
+		typedef void(*SimulateFn)( TState& state, const TInput& input, float dt );
+
+		ServerInputProcessor( SimulateFn simulate, float fixedStep );
+		~ServerInputProcessor();
+
+		// Apply input to state if it is newer than the last one processed.
+		// Returns false for duplicate or late inputs.
+		bool ApplyInput( TState& state, inputSeq_t sequence, const TInput& input );
+		// Input number to echo back to the client with the state
+		inputSeq_t GetLastProcessedInput() const				{ return mLastProcessed; }
+		void Reset()											{ mLastProcessed = 0; }
+
+	private:
+		SimulateFn mSimulate;
+		float mFixedStep;
+		inputSeq_t mLastProcessed;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	ClientPrediction< TInput, TState >::ClientPrediction( SimulateFn simulate, float fixedStep, int maxPendingInputs )
+		: mSimulate( simulate )
+		, mFixedStep( fixedStep )
+		, mInputs( maxPendingInputs )
+		, mNextSequence( 1 )
+		, mOldestPending( 1 )
+		, mLastAcknowledged( 0 )
+	{}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	ClientPrediction< TInput, TState >::~ClientPrediction()
+	{}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	inputSeq_t ClientPrediction< TInput, TState >::ApplyInput( TState& state, const TInput& input )
+	{
+		// Ring is full, the oldest input can no longer be replayed
+		if ( mNextSequence - mOldestPending == mInputs.size() )
+		{
+			++mOldestPending;
+		}
+
+		inputSeq_t sequence = mNextSequence++;
+		mInputs[ sequence % mInputs.size() ] = input;
+
+		mSimulate( state, input, mFixedStep );
+
+		return sequence;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool ClientPrediction< TInput, TState >::Reconcile( TState& state, const TState& serverState, inputSeq_t lastProcessedInput )
+	{
+		// Stale or reordered state
+		if ( lastProcessedInput < mLastAcknowledged || lastProcessedInput >= mNextSequence )
+		{
+			return false;
+		}
+		mLastAcknowledged = lastProcessedInput;
+
+		// Drop inputs the server has already applied
+		if ( lastProcessedInput >= mOldestPending )
+		{
+			mOldestPending = lastProcessedInput + 1;
+		}
+
+		// Rewind and replay
+		state = serverState;
+		for ( inputSeq_t seq = mOldestPending; seq != mNextSequence; ++seq )
+		{
+			mSimulate( state, mInputs[ seq % mInputs.size() ], mFixedStep );
+		}
+
+		return true;
+	}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	void ClientPrediction< TInput, TState >::Reset()
+	{
+		mOldestPending = mNextSequence;
+	}
+	//---------------------------------------
+
+
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	ServerInputProcessor< TInput, TState >::ServerInputProcessor( SimulateFn simulate, float fixedStep )
+		: mSimulate( simulate )
+		, mFixedStep( fixedStep )
+		, mLastProcessed( 0 )
+	{}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	ServerInputProcessor< TInput, TState >::~ServerInputProcessor()
+	{}
+	//---------------------------------------
+	template< typename TInput, typename TState >
+	bool ServerInputProcessor< TInput, TState >::ApplyInput( TState& state, inputSeq_t sequence, const TInput& input )
+	{
+		if ( sequence <= mLastProcessed )
+		{
+			return false;
+		}
+		mLastProcessed = sequence;
+
+		mSimulate( state, input, mFixedStep );
+
+		return true;
+	}
+	//---------------------------------------
+
+}
@@ -0,0 +1,680 @@
+#include "NetLib.h"
+
+using namespace mage;
+
+//---------------------------------------
+// Bits in front of every entity record: more flag, op, class ID and update mask (max)
+static const int RECORD_HEADER_BITS = 1 + 2 + 8 + ReplicatedClass::MAX_PROPERTIES;
+//---------------------------------------
+// Append numBits from a flushed bit buffer
+static void CopyBits( BitWriter& dest, const uint8* src, int numBits )
+{
+	BitReader reader( src, ( numBits + 7 ) / 8 );
+	uint32 value;
+	while ( numBits > 0 )
+	{
+		int bits = numBits < 32 ? numBits : 32;
+		reader.ReadBits( value, bits );
+		dest.WriteBits( value, bits );
+		numBits -= bits;
+	}
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// ReplicatedClass
+//---------------------------------------
+ReplicatedClass::ReplicatedClass( const char* name, CreateFn create, DestroyFn destroy, UpdateFn update )
+	: Create( create )
+	, Destroy( destroy )
+	, Update( update )
+	, mName( name )
+	, mMaxBits( 0 )
+{}
+//---------------------------------------
+ReplicatedClass::~ReplicatedClass()
+{
+	DestroyVector( mProperties );
+}
+//---------------------------------------
+uint32 ReplicatedClass::GetAllPropertiesMask() const
+{
+	return mProperties.size() == MAX_PROPERTIES ? 0xFFFFFFFF : ( 1u << mProperties.size() ) - 1;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// ReplicationManager
+//---------------------------------------
+ReplicationManager::ReplicationManager( int maxEntities )
+	: mEntities( maxEntities )
+	, mPriorityFn( NULL )
+	, mIDBits( 0 )
+	, mNumEntities( 0 )
+	, mHighestEntity( 0 )
+	, mTotalEntitiesSent( 0 )
+	, mTotalEntitiesResent( 0 )
+	, mPayload( 1 )
+	, mRemoteObjects( maxEntities, (void*) 0 )
+	, mRemoteClasses( maxEntities, -1 )
+	, mRecvLatest( 0 )
+	, mRecvBits( 0 )
+	, mHasRecv( false )
+{
+	if ( maxEntities > INVALID_ENTITY )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : maxEntities clamped to %d\n", INVALID_ENTITY );
+		maxEntities = INVALID_ENTITY;
+		mEntities.resize( maxEntities );
+	}
+
+	while ( ( 1 << mIDBits ) < maxEntities )
+	{
+		++mIDBits;
+	}
+
+	// Hand out low IDs first
+	mFreeIDs.reserve( maxEntities );
+	for ( int i = maxEntities - 1; i >= 0; --i )
+	{
+		Entity& entity = mEntities[i];
+		entity.Object = 0;
+		entity.ClassID = -1;
+		entity.BasePriority = 0;
+		entity.Active = false;
+		entity.NumViews = 0;
+		mFreeIDs.push_back( (netEntityID_t) i );
+	}
+	mCandidates.reserve( maxEntities );
+}
+//---------------------------------------
+ReplicationManager::~ReplicationManager()
+{
+	DestroyMapByValue( mClients );
+	DestroyVector( mClasses );
+}
+//---------------------------------------
+int ReplicationManager::AddClass( ReplicatedClass* type )
+{
+	if ( mClasses.size() == 256 )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "ReplicationManager : too many classes, '%s' not added\n", type->GetName() );
+		delete type;
+		return -1;
+	}
+
+	mClasses.push_back( type );
+	return (int) mClasses.size() - 1;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Server
+//---------------------------------------
+netEntityID_t ReplicationManager::AddEntity( int classID, void* object, float basePriority )
+{
+	if ( classID < 0 || classID >= (int) mClasses.size() )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "ReplicationManager : AddEntity() invalid class %d\n", classID );
+		return INVALID_ENTITY;
+	}
+	if ( mFreeIDs.empty() )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Out of entity IDs\n" );
+		return INVALID_ENTITY;
+	}
+
+	netEntityID_t id = mFreeIDs.back();
+	mFreeIDs.pop_back();
+
+	Entity& entity = mEntities[ id ];
+	entity.Object = object;
+	entity.ClassID = classID;
+	entity.BasePriority = basePriority;
+	entity.Active = true;
+	entity.NumViews = 0;
+
+	++mNumEntities;
+	mHighestEntity = Mathi::Max( mHighestEntity, id + 1 );
+
+	// Every client needs to be told about it
+	for ( std::map< clientID_t, ClientState* >::iterator itr = mClients.begin(); itr != mClients.end(); ++itr )
+	{
+		EntityView& view = itr->second->Views[ id ];
+		view.State = VIEW_CREATING;
+		view.SendPending = 1;
+		view.Dirty = 0;
+		view.Priority = 0;
+		++entity.NumViews;
+	}
+
+	return id;
+}
+//---------------------------------------
+void ReplicationManager::RemoveEntity( netEntityID_t id )
+{
+	if ( !IsValidEntity( id ) )
+	{
+		return;
+	}
+
+	Entity& entity = mEntities[ id ];
+	entity.Active = false;
+	entity.Object = 0;
+	--mNumEntities;
+
+	// Clients that may have it need a destroy. The ID stays reserved until they ack it.
+	for ( std::map< clientID_t, ClientState* >::iterator itr = mClients.begin(); itr != mClients.end(); ++itr )
+	{
+		EntityView& view = itr->second->Views[ id ];
+		if ( view.State != VIEW_NONE )
+		{
+			view.State = VIEW_DESTROYING;
+			view.SendPending = 1;
+			view.Dirty = 0;
+		}
+	}
+
+	if ( entity.NumViews == 0 )
+	{
+		mFreeIDs.push_back( id );
+	}
+}
+//---------------------------------------
+void ReplicationManager::MarkDirty( netEntityID_t id, uint32 mask )
+{
+	if ( !IsValidEntity( id ) )
+	{
+		return;
+	}
+
+	for ( std::map< clientID_t, ClientState* >::iterator itr = mClients.begin(); itr != mClients.end(); ++itr )
+	{
+		EntityView& view = itr->second->Views[ id ];
+
+		// Creating clients need changes made after the create was sent too
+		if ( view.State == VIEW_CREATING || view.State == VIEW_LIVE )
+		{
+			view.Dirty |= mask;
+		}
+	}
+}
+//---------------------------------------
+void ReplicationManager::AddClient( clientID_t clientID )
+{
+	if ( FindClient( clientID ) )
+	{
+		return;
+	}
+
+	ClientState* client = new ClientState;
+	client->ID = clientID;
+	client->NextSequence = 0;
+	client->Views.resize( mEntities.size() );
+	for ( int i = 0; i < SENT_HISTORY; ++i )
+	{
+		client->Sent[i].InFlight = false;
+	}
+
+	for ( int id = 0; id < (int) mEntities.size(); ++id )
+	{
+		EntityView& view = client->Views[ id ];
+		view.State = VIEW_NONE;
+		view.SendPending = 0;
+		view.Dirty = 0;
+		view.Priority = 0;
+
+		if ( mEntities[ id ].Active )
+		{
+			view.State = VIEW_CREATING;
+			view.SendPending = 1;
+			++mEntities[ id ].NumViews;
+		}
+	}
+
+	mClients[ clientID ] = client;
+}
+//---------------------------------------
+void ReplicationManager::RemoveClient( clientID_t clientID )
+{
+	ClientState* client = FindClient( clientID );
+	if ( !client )
+	{
+		return;
+	}
+
+	for ( int id = 0; id < mHighestEntity; ++id )
+	{
+		if ( client->Views[ id ].State != VIEW_NONE )
+		{
+			ReleaseView( (netEntityID_t) id, client->Views[ id ] );
+		}
+	}
+
+	mClients.erase( clientID );
+	delete client;
+}
+//---------------------------------------
+int ReplicationManager::WriteUpdate( clientID_t clientID, PacketWriter& writer, int budgetBytes, float dt )
+{
+	ClientState* client = FindClient( clientID );
+	if ( !client )
+	{
+		return 0;
+	}
+
+	// An update this old was never acked, count it as lost before its slot is reused
+	SentUpdate& update = client->Sent[ client->NextSequence % SENT_HISTORY ];
+	if ( update.InFlight )
+	{
+		OnLost( *client, update );
+	}
+
+	// Accumulate priority for everything with something to send
+	mCandidates.clear();
+	for ( int id = 0; id < mHighestEntity; ++id )
+	{
+		EntityView& view = client->Views[ id ];
+		if ( !view.SendPending && !( view.State == VIEW_LIVE && view.Dirty ) )
+		{
+			view.Priority = 0;
+			continue;
+		}
+
+		const Entity& entity = mEntities[ id ];
+		float relevance = 1.0f;
+		if ( entity.Active && mPriorityFn )
+		{
+			relevance = mPriorityFn( clientID, (netEntityID_t) id, entity.Object );
+			if ( relevance <= 0.0f )
+			{
+				continue;
+			}
+		}
+
+		view.Priority += entity.BasePriority * relevance * dt;
+		mCandidates.push_back( std::make_pair( view.Priority, (netEntityID_t) id ) );
+	}
+
+	if ( mCandidates.empty() )
+	{
+		return 0;
+	}
+
+	std::sort( mCandidates.begin(), mCandidates.end(), std::greater< std::pair< float, netEntityID_t > >() );
+
+	// Highest priority first until the budget is used up. Smaller records may still fit after a big one doesn't.
+	int payloadBytes = budgetBytes - (int) ( sizeof( uint16 ) * 2 );
+	if ( payloadBytes <= 0 )
+	{
+		return 0;
+	}
+	if ( (int) mPayload.size() < payloadBytes )
+	{
+		mPayload.resize( payloadBytes );
+	}
+
+	BitWriter payload( &mPayload[0], payloadBytes );
+	const int maxBits = payloadBytes * 8 - 1;
+	update.Entities.clear();
+
+	for ( size_t i = 0; i < mCandidates.size(); ++i )
+	{
+		netEntityID_t id = mCandidates[i].second;
+		EntityView& view = client->Views[ id ];
+		SentEntity sent;
+
+		int recordBytes = ( RECORD_HEADER_BITS + mIDBits + mClasses[ mEntities[ id ].ClassID ]->GetMaxBits() + 7 ) / 8;
+		if ( (int) mEntityBits.size() < recordBytes )
+		{
+			mEntityBits.resize( recordBytes );
+		}
+
+		BitWriter record( &mEntityBits[0], recordBytes );
+		WriteEntity( record, id, view, sent );
+		record.Flush();
+
+		if ( record.IsOverflow() || payload.GetBitsWritten() + record.GetBitsWritten() > maxBits )
+		{
+			continue;
+		}
+
+		CopyBits( payload, &mEntityBits[0], record.GetBitsWritten() );
+		update.Entities.push_back( sent );
+
+		if ( sent.Op == OP_UPDATE )
+		{
+			view.Dirty = 0;
+		}
+		else
+		{
+			view.SendPending = 0;
+			view.Dirty = 0;
+		}
+		view.Priority = 0;
+	}
+
+	if ( update.Entities.empty() )
+	{
+		return 0;
+	}
+
+	payload.WriteBits( 0, 1 );
+	payload.Flush();
+
+	update.Sequence = client->NextSequence++;
+	update.InFlight = true;
+	mTotalEntitiesSent += (uint32) update.Entities.size();
+
+	writer.Write( update.Sequence );
+	writer.Write( (uint16) payload.GetBytesWritten() );
+	writer.WriteRaw( &mPayload[0], payload.GetBytesWritten() );
+
+	return (int) update.Entities.size();
+}
+//---------------------------------------
+bool ReplicationManager::ReadAcks( clientID_t clientID, PacketReader& reader )
+{
+	uint16 latest = reader.Read< uint16 >();
+	uint32 bits = reader.Read< uint32 >();
+
+	ClientState* client = FindClient( clientID );
+	if ( !client )
+	{
+		return false;
+	}
+
+	for ( int i = 0; i < SENT_HISTORY; ++i )
+	{
+		SentUpdate& update = client->Sent[i];
+		if ( !update.InFlight || SequenceNewer( update.Sequence, latest ) )
+		{
+			continue;
+		}
+
+		// Clients drop updates older than the newest they applied, so anything older and not acked is gone
+		uint16 age = (uint16) ( latest - update.Sequence );
+		if ( age == 0 || ( age <= ACK_BITS && ( ( bits >> ( age - 1 ) ) & 1 ) ) )
+		{
+			OnDelivered( *client, update );
+		}
+		else
+		{
+			OnLost( *client, update );
+		}
+	}
+
+	return true;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Client
+//---------------------------------------
+bool ReplicationManager::ReadUpdate( PacketReader& reader )
+{
+	uint16 sequence = reader.Read< uint16 >();
+	uint16 length = reader.Read< uint16 >();
+
+	if ( (int) mPayload.size() < length + 1 )
+	{
+		mPayload.resize( length + 1 );
+	}
+	if ( !reader.ReadRaw( &mPayload[0], length ) )
+	{
+		return false;
+	}
+
+	// Late, a newer update already went out. Not acking it makes the server resend what changed.
+	if ( mHasRecv && !SequenceNewer( sequence, mRecvLatest ) )
+	{
+		return true;
+	}
+
+	BitReader bits( &mPayload[0], length );
+	uint32 more;
+
+	while ( bits.ReadBits( more, 1 ) && more )
+	{
+		uint32 id;
+		uint32 op;
+		bits.ReadBits( id, mIDBits );
+		bits.ReadBits( op, 2 );
+
+		if ( id >= mRemoteObjects.size() )
+		{
+			ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Bad entity ID %u\n", id );
+			return false;
+		}
+
+		void*& object = mRemoteObjects[ id ];
+		int& classID = mRemoteClasses[ id ];
+
+		if ( op == OP_DESTROY )
+		{
+			if ( object && mClasses[ classID ]->Destroy )
+			{
+				mClasses[ classID ]->Destroy( (netEntityID_t) id, object );
+			}
+			object = 0;
+			classID = -1;
+			continue;
+		}
+
+		uint32 mask;
+		if ( op == OP_CREATE )
+		{
+			uint32 newClass;
+			if ( !bits.ReadBits( newClass, 8 ) || newClass >= mClasses.size() )
+			{
+				ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Bad class for entity %u\n", id );
+				return false;
+			}
+
+			// A resent create for something we already have is just a full update
+			if ( object && classID != (int) newClass )
+			{
+				if ( mClasses[ classID ]->Destroy )
+					mClasses[ classID ]->Destroy( (netEntityID_t) id, object );
+				object = 0;
+			}
+			if ( !object )
+			{
+				ReplicatedClass::CreateFn create = mClasses[ newClass ]->Create;
+				object = create ? create( (netEntityID_t) id ) : 0;
+			}
+			classID = (int) newClass;
+			mask = mClasses[ classID ]->GetAllPropertiesMask();
+
+			if ( !object )
+			{
+				ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Failed to create '%s'\n", mClasses[ classID ]->GetName() );
+				classID = -1;
+				return false;
+			}
+		}
+		else if ( object )
+		{
+			bits.ReadBits( mask, mClasses[ classID ]->GetNumProperties() );
+		}
+		else
+		{
+			ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Update for unknown entity %u\n", id );
+			return false;
+		}
+
+		const ReplicatedClass* type = mClasses[ classID ];
+		for ( int p = 0; p < type->GetNumProperties(); ++p )
+		{
+			if ( ( mask & ( 1u << p ) ) && !type->GetProperty( p )->Decode( bits, object ) )
+			{
+				ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Truncated or out of range data for entity %u\n", id );
+				return false;
+			}
+		}
+
+		if ( type->Update )
+		{
+			type->Update( (netEntityID_t) id, object, mask );
+		}
+	}
+
+	if ( bits.IsOverflow() )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "ReplicationManager : Truncated update\n" );
+		return false;
+	}
+
+	// Ack it
+	if ( !mHasRecv )
+	{
+		mRecvBits = 0;
+		mHasRecv = true;
+	}
+	else
+	{
+		uint16 shift = (uint16) ( sequence - mRecvLatest );
+		if ( shift < ACK_BITS )
+			mRecvBits = ( mRecvBits << shift ) | ( 1u << ( shift - 1 ) );
+		else
+			mRecvBits = shift == ACK_BITS ? 1u << ( ACK_BITS - 1 ) : 0;
+	}
+	mRecvLatest = sequence;
+
+	return true;
+}
+//---------------------------------------
+void ReplicationManager::WriteAcks( PacketWriter& writer )
+{
+	writer.Write( mRecvLatest );
+	writer.Write( mRecvBits );
+}
+//---------------------------------------
+void* ReplicationManager::GetRemoteObject( netEntityID_t id ) const
+{
+	return id < mRemoteObjects.size() ? mRemoteObjects[ id ] : 0;
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Private
+//---------------------------------------
+ReplicationManager::ClientState* ReplicationManager::FindClient( clientID_t clientID )
+{
+	std::map< clientID_t, ClientState* >::iterator itr = mClients.find( clientID );
+	return itr != mClients.end() ? itr->second : 0;
+}
+//---------------------------------------
+void ReplicationManager::WriteEntity( BitWriter& writer, netEntityID_t id, const EntityView& view, SentEntity& sent )
+{
+	const Entity& entity = mEntities[ id ];
+
+	sent.ID = id;
+	writer.WriteBits( 1, 1 );
+	writer.WriteBits( id, mIDBits );
+
+	if ( view.State == VIEW_DESTROYING )
+	{
+		sent.Op = OP_DESTROY;
+		sent.Mask = 0;
+		writer.WriteBits( OP_DESTROY, 2 );
+		return;
+	}
+
+	const ReplicatedClass* type = mClasses[ entity.ClassID ];
+
+	if ( view.State == VIEW_CREATING )
+	{
+		sent.Op = OP_CREATE;
+		sent.Mask = type->GetAllPropertiesMask();
+		writer.WriteBits( OP_CREATE, 2 );
+		writer.WriteBits( entity.ClassID, 8 );
+	}
+	else
+	{
+		sent.Op = OP_UPDATE;
+		sent.Mask = view.Dirty & type->GetAllPropertiesMask();
+		writer.WriteBits( OP_UPDATE, 2 );
+		writer.WriteBits( sent.Mask, type->GetNumProperties() );
+	}
+
+	for ( int p = 0; p < type->GetNumProperties(); ++p )
+	{
+		if ( sent.Mask & ( 1u << p ) )
+		{
+			type->GetProperty( p )->Encode( writer, entity.Object );
+		}
+	}
+}
+//---------------------------------------
+void ReplicationManager::OnDelivered( ClientState& client, SentUpdate& update )
+{
+	for ( size_t i = 0; i < update.Entities.size(); ++i )
+	{
+		const SentEntity& sent = update.Entities[i];
+		EntityView& view = client.Views[ sent.ID ];
+
+		if ( sent.Op == OP_CREATE && view.State == VIEW_CREATING )
+		{
+			// Any resend queued for an earlier lost create is covered by this one
+			view.State = VIEW_LIVE;
+			view.SendPending = 0;
+		}
+		else if ( sent.Op == OP_DESTROY && view.State == VIEW_DESTROYING )
+		{
+			ReleaseView( sent.ID, view );
+		}
+	}
+	update.InFlight = false;
+}
+//---------------------------------------
+void ReplicationManager::OnLost( ClientState& client, SentUpdate& update )
+{
+	for ( size_t i = 0; i < update.Entities.size(); ++i )
+	{
+		const SentEntity& sent = update.Entities[i];
+		EntityView& view = client.Views[ sent.ID ];
+
+		switch ( sent.Op )
+		{
+		case OP_CREATE:
+			if ( view.State == VIEW_CREATING )
+				view.SendPending = 1;
+			else if ( view.State == VIEW_LIVE )
+				view.Dirty |= sent.Mask;
+			break;
+		case OP_UPDATE:
+			if ( view.State == VIEW_LIVE )
+				view.Dirty |= sent.Mask;
+			break;
+		case OP_DESTROY:
+			if ( view.State == VIEW_DESTROYING )
+				view.SendPending = 1;
+			break;
+		}
+	}
+	mTotalEntitiesResent += (uint32) update.Entities.size();
+	update.InFlight = false;
+}
+//---------------------------------------
+void ReplicationManager::ReleaseView( netEntityID_t id, EntityView& view )
+{
+	Entity& entity = mEntities[ id ];
+
+	view.State = VIEW_NONE;
+	view.SendPending = 0;
+	view.Dirty = 0;
+	view.Priority = 0;
+
+	// Last client to let go of a removed entity frees its ID
+	if ( --entity.NumViews == 0 && !entity.Active )
+	{
+		mFreeIDs.push_back( id );
+	}
+}
+//---------------------------------------
\ No newline at end of file
@@ -0,0 +1,295 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Entity replication with dirty tracking and per-client prioritization.
+ *   Object types are described by a ReplicatedClass listing their replicated
+ *   members and the codec for each one. Property i of a class is dirty bit i.
+ *   The server marks properties dirty as they change. Each tick, every
+ *   client's entities with pending changes accumulate priority (base priority
+ *   scaled by a relevance callback, times dt) and are written highest first
+ *   until the client's byte budget is full. Entities that don't fit keep
+ *   their priority and win a later tick, so every client converges.
+ *   Clients ack updates with a sequence + bitfield. Changes in updates that
+ *   were lost are marked dirty again, so updates can be sent unreliably.
+ *
+ *   Update wire format:
+ *     uint16 Sequence
+ *     uint16 Length
+ *     bits   { 1 more, ID, 2 op, [ 8 class, all props ] | [ mask, dirty props ] | [] }... 0
+ *   Ack wire format:
+ *     uint16 Latest sequence applied
+ *     uint32 Bitfield of the 32 sequences before it
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	typedef uint16 netEntityID_t;
+
+	//---------------------------------------
+	// ReplicatedPropertyBase
+	// Encodes one member of a replicated object
+	//---------------------------------------
+	class ReplicatedPropertyBase
+	{
+	public:
+		virtual ~ReplicatedPropertyBase() {}
+
+		virtual void Encode( BitWriter& writer, const void* object ) const = 0;
+		virtual bool Decode( BitReader& reader, void* object ) const = 0;
+		virtual int GetMaxBits() const = 0;
+
+	protected:
+		ReplicatedPropertyBase() {}
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// ReplicatedProperty
+	// Binds an object member to a codec (see MessageSchema.h)
+	//---------------------------------------
+	template< typename TObject, typename TValue, typename TCodec >
+	class ReplicatedProperty
+		: public ReplicatedPropertyBase
+	{
+	public:
+		ReplicatedProperty( TValue TObject::*member )
+			: mMember( member )
+		{}
+		virtual ~ReplicatedProperty() {}
+
+		virtual void Encode( BitWriter& writer, const void* object ) const
+		{
+			TCodec::Encode( writer, ( (const TObject*) object )->*mMember );
+		}
+
+		virtual bool Decode( BitReader& reader, void* object ) const
+		{
+			return TCodec::Decode( reader, ( (TObject*) object )->*mMember );
+		}
+
+		virtual int GetMaxBits() const
+		{
+			return TCodec::BITS;
+		}
+
+	private:
+		TValue TObject::*mMember;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// ReplicatedClass
+	// Replicated properties of one object type and the client side callbacks
+	//---------------------------------------
+	class ReplicatedClass
+	{
+	public:
+		enum { MAX_PROPERTIES = 32 };
+
+		// Client side. Create returns the object to decode into.
+		typedef void*(*CreateFn)( netEntityID_t id );
+		typedef void(*DestroyFn)( netEntityID_t id, void* object );
+		// Called after properties in changedMask were decoded into object
+		typedef void(*UpdateFn)( netEntityID_t id, void* object, uint32 changedMask );
+
+		ReplicatedClass( const char* name, CreateFn create=NULL, DestroyFn destroy=NULL, UpdateFn update=NULL );
+		~ReplicatedClass();
+
+		// Add a replicated member. Returns its dirty bit.
+		//  playerClass.AddProperty< ScreenPosCodec >( &Player::pos );
+		template< typename TCodec, typename TObject, typename TValue >
+		uint32 AddProperty( TValue TObject::*member );
+
+		const char* GetName() const							{ return mName.c_str(); }
+		int GetNumProperties() const						{ return (int) mProperties.size(); }
+		const ReplicatedPropertyBase* GetProperty( int i ) const	{ return mProperties[i]; }
+		uint32 GetAllPropertiesMask() const;
+		int GetMaxBits() const								{ return mMaxBits; }
+
+		CreateFn Create;
+		DestroyFn Destroy;
+		UpdateFn Update;
+
+	private:
+		std::string mName;
+		std::vector< ReplicatedPropertyBase* > mProperties;
+		int mMaxBits;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// ReplicationManager
+	//---------------------------------------
+	class ReplicationManager
+	{
+	public:
+		// Relevance of an entity to a client, scales its base priority. <= 0 to not send it.
+		typedef float(*PriorityFn)( clientID_t client, netEntityID_t id, const void* object );
+
+		static const netEntityID_t INVALID_ENTITY = 0xFFFF;
+
+		ReplicationManager( int maxEntities=1024 );
+		~ReplicationManager();
+
+		// Classes must be registered in the same order on the server and clients.
+		// The manager takes ownership. Returns the class ID.
+		int AddClass( ReplicatedClass* type );
+
+		//---------------------------------------
+		// Server
+		//---------------------------------------
+		// Start replicating object to all clients. Returns INVALID_ENTITY if full.
+		netEntityID_t AddEntity( int classID, void* object, float basePriority=1.0f );
+		// Stop replicating and destroy the entity on clients. The ID is reused once all clients ack the destroy.
+		void RemoveEntity( netEntityID_t id );
+		// Properties in mask changed and need sending
+		void MarkDirty( netEntityID_t id, uint32 mask=0xFFFFFFFF );
+		void SetPriorityCallback( PriorityFn fn )			{ mPriorityFn = fn; }
+
+		void AddClient( clientID_t client );
+		void RemoveClient( clientID_t client );
+
+		// Accumulate priority over dt and write the most important changes for client, up to budgetBytes.
+		// Writes nothing and returns 0 if there is nothing to send.
+		int WriteUpdate( clientID_t client, PacketWriter& writer, int budgetBytes, float dt );
+		// Acks written by a client with WriteAcks
+		bool ReadAcks( clientID_t client, PacketReader& reader );
+
+		//---------------------------------------
+		// Client
+		//---------------------------------------
+		// Apply an update written with WriteUpdate. Updates older than the newest applied are dropped.
+		bool ReadUpdate( PacketReader& reader );
+		// Ack the updates applied so far, send these back to the server regularly
+		void WriteAcks( PacketWriter& writer );
+		bool HasReceivedUpdates() const						{ return mHasRecv; }
+		void* GetRemoteObject( netEntityID_t id ) const;
+
+		int GetNumEntities() const							{ return mNumEntities; }
+		uint32 GetTotalEntitiesSent() const					{ return mTotalEntitiesSent; }
+		uint32 GetTotalEntitiesResent() const				{ return mTotalEntitiesResent; }
+
+	private:
+		static const int SENT_HISTORY = 64;		// Updates kept waiting for an ack per client
+		static const int ACK_BITS = 32;
+
+		enum EntityOp
+		{
+			OP_CREATE,
+			OP_UPDATE,
+			OP_DESTROY,
+		};
+
+		enum ViewState
+		{
+			VIEW_NONE,						// Client does not have the entity
+			VIEW_CREATING,					// Create sent or pending but not acked
+			VIEW_LIVE,						// Client has the entity
+			VIEW_DESTROYING,				// Destroy sent or pending but not acked
+		};
+
+		struct Entity
+		{
+			void* Object;
+			int ClassID;
+			float BasePriority;
+			bool Active;
+			int NumViews;					// Clients whose view is not VIEW_NONE
+		};
+
+		// An entity as seen by one client
+		struct EntityView
+		{
+			uint8 State;
+			uint8 SendPending;				// Create or destroy needs (re)sending
+			uint32 Dirty;					// Properties changed since last sent
+			float Priority;					// Accumulated while there is something to send
+		};
+
+		struct SentEntity
+		{
+			netEntityID_t ID;
+			uint8 Op;
+			uint32 Mask;
+		};
+
+		struct SentUpdate
+		{
+			uint16 Sequence;
+			bool InFlight;
+			std::vector< SentEntity > Entities;
+		};
+
+		struct ClientState
+		{
+			clientID_t ID;
+			uint16 NextSequence;
+			std::vector< EntityView > Views;
+			SentUpdate Sent[ SENT_HISTORY ];	// Updates waiting for an ack, indexed by sequence
+		};
+
+		static bool SequenceNewer( uint16 a, uint16 b )		{ return (int16) ( a - b ) > 0; }
+
+		bool IsValidEntity( netEntityID_t id ) const		{ return id < mEntities.size() && mEntities[ id ].Active; }
+		ClientState* FindClient( clientID_t client );
+		// Write one entity's record as the client should see it next
+		void WriteEntity( BitWriter& writer, netEntityID_t id, const EntityView& view, SentEntity& sent );
+		void OnDelivered( ClientState& client, SentUpdate& update );
+		// Queue everything in a lost update to be sent again
+		void OnLost( ClientState& client, SentUpdate& update );
+		void ReleaseView( netEntityID_t id, EntityView& view );
+
+		std::vector< ReplicatedClass* > mClasses;
+		std::vector< Entity > mEntities;
+		std::vector< netEntityID_t > mFreeIDs;
+		std::map< clientID_t, ClientState* > mClients;
+		PriorityFn mPriorityFn;
+		int mIDBits;
+		int mNumEntities;
+		int mHighestEntity;				// One past the highest ID handed out
+		uint32 mTotalEntitiesSent;
+		uint32 mTotalEntitiesResent;
+
+		// Scratch space reused every update
+		std::vector< std::pair< float, netEntityID_t > > mCandidates;
+		std::vector< uint8 > mPayload;
+		std::vector< uint8 > mEntityBits;
+
+		// Client side
+		std::vector< void* > mRemoteObjects;
+		std::vector< int > mRemoteClasses;
+		uint16 mRecvLatest;
+		uint32 mRecvBits;
+		bool mHasRecv;
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename TCodec, typename TObject, typename TValue >
+	uint32 ReplicatedClass::AddProperty( TValue TObject::*member )
+	{
+		if ( mProperties.size() == MAX_PROPERTIES )
+		{
+			ConsolePrintf( CONSOLE_ERROR, "ReplicatedClass '%s': too many properties\n", mName.c_str() );
+			return 0;
+		}
+
+		mProperties.push_back( new ReplicatedProperty< TObject, TValue, TCodec >( member ) );
+		mMaxBits += TCodec::BITS;
+		return 1u << ( mProperties.size() - 1 );
+	}
+	//---------------------------------------
+
+}
\ No newline at end of file
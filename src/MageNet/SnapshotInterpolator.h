@@ -0,0 +1,202 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Buffers timestamped snapshots of remote entities and samples them at a
+ *   delay behind the synced server time. Samples between two snapshots are
+ *   interpolated, samples past the newest snapshot are briefly extrapolated.
+ *   The delay adapts to the measured arrival jitter.
+ *   All snapshot storage is allocated up front, sampling never allocates.
+ */
+
+#pragma once
+
+namespace mage
+{
+
+	template< typename TState >
+	class SnapshotInterpolator
+	{
+	public:
+		// Blend a to b. t is in [0,1] when interpolating and > 1 when extrapolating.
+		typedef void(*LerpFn)( const TState& a, const TState& b, float t, TState& out );
+
+		SnapshotInterpolator( LerpFn lerp, int maxEntities, int snapshotsPerEntity=32 );
+		~SnapshotInterpolator();
+
+		// Add a snapshot for an entity. Times are in seconds of synced net time.
+		// Snapshots older than the newest one for the entity are dropped.
+		void AddSnapshot( int entity, double timestamp, const TState& state, double arrivalTime );
+		// Forget all snapshots of an entity (ie. after it teleports)
+		void Clear( int entity );
+		// Adapt the delay to the measured jitter. Call once per frame.
+		void OnUpdate( float dt );
+
+		// Time to sample entities at for the given synced net time
+		double GetRenderTime( double netTime ) const				{ return netTime - mDelay; }
+		// Sample an entity at renderTime. Returns false if there are no snapshots.
+		bool Sample( int entity, double renderTime, TState& out ) const;
+
+		// Base delay before jitter is added, and the range the delay is kept in (sec)
+		void SetDelay( double baseDelay, double minDelay, double maxDelay );
+		// How far past the newest snapshot we are allowed to extrapolate (sec)
+		void SetMaxExtrapolation( double seconds )					{ mMaxExtrapolation = seconds; }
+
+		double GetDelay() const										{ return mDelay; }
+		double GetJitter() const									{ return mJitter; }
+		int GetMaxEntities() const									{ return (int) mEntities.size(); }
+
+	private:
+		struct Snapshot
+		{
+			double Time;
+			TState State;
+		};
+
+		LerpFn mLerp;
+		std::vector< CircularBuffer< Snapshot > > mEntities;
+
+		double mDelay;						// Current delay behind net time (sec)
+		double mBaseDelay;
+		double mMinDelay;
+		double mMaxDelay;
+		double mMaxExtrapolation;
+
+		double mAverageTransit;				// Average arrival - timestamp (sec)
+		double mJitter;						// Average deviation from mAverageTransit (sec)
+		bool mHasTransit;
+
+		static const double JITTER_SCALE;	// Jitter multiplier added to the base delay
+		static const double DELAY_RATE;		// Max change in delay per second
+	};
+	//---------------------------------------
+
+
+	//---------------------------------------
+	// Implementation
+	//---------------------------------------
+
+	//---------------------------------------
+	template< typename TState >
+	const double SnapshotInterpolator< TState >::JITTER_SCALE = 3.0;
+	//---------------------------------------
+	template< typename TState >
+	const double SnapshotInterpolator< TState >::DELAY_RATE = 0.05;
+	//---------------------------------------
+	template< typename TState >
+	SnapshotInterpolator< TState >::SnapshotInterpolator( LerpFn lerp, int maxEntities, int snapshotsPerEntity )
+		: mLerp( lerp )
+		, mEntities( maxEntities, CircularBuffer< Snapshot >( snapshotsPerEntity ) )
+		, mDelay( 0.1 )
+		, mBaseDelay( 0.1 )
+		, mMinDelay( 0.05 )
+		, mMaxDelay( 0.5 )
+		, mMaxExtrapolation( 0.25 )
+		, mAverageTransit( 0 )
+		, mJitter( 0 )
+		, mHasTransit( false )
+	{}
+	//---------------------------------------
+	template< typename TState >
+	SnapshotInterpolator< TState >::~SnapshotInterpolator()
+	{}
+	//---------------------------------------
+	template< typename TState >
+	void SnapshotInterpolator< TState >::AddSnapshot( int entity, double timestamp, const TState& state, double arrivalTime )
+	{
+		CircularBuffer< Snapshot >& snapshots = mEntities[ entity ];
+
+		// Out of order, we already have something newer
+		int length = snapshots.Length();
+		if ( length > 0 && snapshots.Read( length - 1 ).Time >= timestamp )
+		{
+			return;
+		}
+
+		Snapshot snapshot = { timestamp, state };
+		snapshots.Write( snapshot );
+
+		// Track jitter as the deviation of the transit time from its average
+		double transit = arrivalTime - timestamp;
+		if ( !mHasTransit )
+		{
+			mAverageTransit = transit;
+			mHasTransit = true;
+		}
+		mJitter = ( 0.9 * mJitter ) + ( 0.1 * std::abs( transit - mAverageTransit ) );
+		mAverageTransit = ( 0.9 * mAverageTransit ) + ( 0.1 * transit );
+	}
+	//---------------------------------------
+	template< typename TState >
+	void SnapshotInterpolator< TState >::Clear( int entity )
+	{
+		mEntities[ entity ].Clear();
+	}
+	//---------------------------------------
+	template< typename TState >
+	void SnapshotInterpolator< TState >::OnUpdate( float dt )
+	{
+		// Ease toward the target delay so render time never jumps
+		double target = Mathd::Clamp( mBaseDelay + JITTER_SCALE * mJitter, mMinDelay, mMaxDelay );
+		double maxStep = DELAY_RATE * dt;
+		mDelay += Mathd::Clamp( target - mDelay, -maxStep, maxStep );
+	}
+	//---------------------------------------
+	template< typename TState >
+	bool SnapshotInterpolator< TState >::Sample( int entity, double renderTime, TState& out ) const
+	{
+		const CircularBuffer< Snapshot >& snapshots = mEntities[ entity ];
+		int length = snapshots.Length();
+
+		if ( length == 0 )
+		{
+			return false;
+		}
+
+		const Snapshot& newest = snapshots.Read( length - 1 );
+
+		// Past the newest snapshot, extrapolate from the last two
+		if ( renderTime >= newest.Time )
+		{
+			if ( length == 1 )
+			{
+				out = newest.State;
+			}
+			else
+			{
+				const Snapshot& prev = snapshots.Read( length - 2 );
+				double span = newest.Time - prev.Time;
+				double ahead = Mathd::Min( renderTime - newest.Time, mMaxExtrapolation );
+				mLerp( prev.State, newest.State, (float) ( 1.0 + ahead / span ), out );
+			}
+			return true;
+		}
+
+		// Find the snapshots bracketing renderTime, newest first since that's where we usually are
+		for ( int i = length - 2; i >= 0; --i )
+		{
+			const Snapshot& a = snapshots.Read( i );
+			if ( a.Time <= renderTime )
+			{
+				const Snapshot& b = snapshots.Read( i + 1 );
+				mLerp( a.State, b.State, (float) ( ( renderTime - a.Time ) / ( b.Time - a.Time ) ), out );
+				return true;
+			}
+		}
+
+		// Older than anything we have
+		out = snapshots.Read( 0 ).State;
+		return true;
+	}
+	//---------------------------------------
+	template< typename TState >
+	void SnapshotInterpolator< TState >::SetDelay( double baseDelay, double minDelay, double maxDelay )
+	{
+		mBaseDelay = baseDelay;
+		mMinDelay = minDelay;
+		mMaxDelay = maxDelay;
+		mDelay = Mathd::Clamp( baseDelay, minDelay, maxDelay );
+	}
+	//---------------------------------------
+
+}
@@ -0,0 +1,313 @@
+#include <MageMath.h>
+#include <MageCore.h>
+#include <MageNet.h>
+
+using namespace mage;
+
+/* Checks LockstepSimulation with three peers exchanging input over a fake
+ * network that delays and reorders it. Every peer has to end on the same
+ * state, late input has to cause rollbacks, and a peer whose simulation
+ * goes wrong has to be caught as a desync.
+ *
+ * LockstepTest [seed]
+ */
+
+typedef FixedPoint< int, 16 > Fixed;
+
+static const int NUM_PEERS = 3;
+static const int INPUT_DELAY = 2;
+static const int MAX_DELIVERY_DELAY = 8;	// Ticks, more than INPUT_DELAY so input is late
+static const int NUM_TICKS = 600;
+static const int CORRUPT_TICK = 100;
+static int gNumFailed = 0;
+
+//---------------------------------------
+static void Check( bool condition, const char* what )
+{
+	if ( !condition )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "FAILED : %s\n", what );
+		++gNumFailed;
+	}
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Simulation
+//---------------------------------------
+struct ShipInput
+{
+	int8 Turn;						// -1, 0, 1
+	int8 Thrust;					// 0 to 2
+	uint8 Pad[2];
+};
+//---------------------------------------
+// Raw Fixed values, the state has to be POD
+struct ShipState
+{
+	int32 X[ NUM_PEERS ];
+	int32 Y[ NUM_PEERS ];
+	int32 Angle[ NUM_PEERS ];
+	int32 Tick;
+};
+//---------------------------------------
+// Peer whose simulation is running and the one that gets it wrong, for the desync check
+static int gSimulatingPeer = -1;
+static int gCorruptPeer = -1;
+//---------------------------------------
+static void SimulateShips( ShipState& state, const ShipInput* inputs, int numPlayers )
+{
+	static const Fixed TURN_RATE( 0.05 );
+	static const Fixed ARENA_RADIUS( 50 );
+
+	for ( int p = 0; p < numPlayers; ++p )
+	{
+		Fixed angle = Fixed::FromRaw( state.Angle[p] ) + Fixed( inputs[p].Turn ) * TURN_RATE;
+		Fixed x = Fixed::FromRaw( state.X[p] ) + cos( angle ) * Fixed( inputs[p].Thrust );
+		Fixed y = Fixed::FromRaw( state.Y[p] ) + sin( angle ) * Fixed( inputs[p].Thrust );
+
+		// Keep ships in the arena
+		Fixed dist = sqrt( x * x + y * y );
+		if ( dist > ARENA_RADIUS )
+		{
+			x = x * ARENA_RADIUS / dist;
+			y = y * ARENA_RADIUS / dist;
+		}
+
+		state.Angle[p] = angle.GetRaw();
+		state.X[p] = x.GetRaw();
+		state.Y[p] = y.GetRaw();
+	}
+
+	// Stands in for a simulation that isn't deterministic on one peer
+	if ( gSimulatingPeer == gCorruptPeer && state.Tick == CORRUPT_TICK )
+	{
+		state.Angle[0] += Fixed( 1 ).GetRaw();
+	}
+
+	++state.Tick;
+}
+//---------------------------------------
+typedef LockstepSimulation< ShipInput, ShipState > ShipSimulation;
+//---------------------------------------
+
+
+//---------------------------------------
+// Network
+//---------------------------------------
+struct InFlight
+{
+	int DeliverTick;
+	int To;
+	std::vector< uint8 > Data;
+};
+//---------------------------------------
+// Send a peer's inputs to every other peer, arriving after a random delay or right away
+static void SendInputs( std::vector< InFlight >& network, ShipSimulation* peers[], int from, int now, bool randomDelay )
+{
+	PacketWriter writer;
+	peers[ from ]->WriteInputs( writer );
+
+	for ( int to = 0; to < NUM_PEERS; ++to )
+	{
+		if ( to != from )
+		{
+			InFlight message;
+			message.DeliverTick = now + ( randomDelay ? 1 + rand() % MAX_DELIVERY_DELAY : 0 );
+			message.To = to;
+			message.Data.assign( writer.Data(), writer.Data() + writer.Size() );
+			network.push_back( message );
+		}
+	}
+}
+//---------------------------------------
+// Random delays mean messages are delivered in a different order than they were sent
+static void Deliver( std::vector< InFlight >& network, ShipSimulation* peers[], int now )
+{
+	for ( size_t i = 0; i < network.size(); )
+	{
+		if ( network[i].DeliverTick <= now )
+		{
+			PacketReader reader;
+			reader.CopyDataFrom( network[i].Data.data(), (int) network[i].Data.size() );
+			Check( peers[ network[i].To ]->ReadInputs( reader ), "Inputs read" );
+			network.erase( network.begin() + i );
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+//---------------------------------------
+// Each peer sends to the others then every message due is delivered
+static void ExchangeInputs( std::vector< InFlight >& network, ShipSimulation* peers[], int now, bool randomDelay )
+{
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		SendInputs( network, peers, p, now, randomDelay );
+	}
+	Deliver( network, peers, now );
+}
+//---------------------------------------
+static void AdvancePeer( ShipSimulation* peer, const ShipInput& input )
+{
+	gSimulatingPeer = peer->GetLocalPlayer();
+	peer->AddLocalInput( input );
+	peer->Advance();
+	gSimulatingPeer = -1;
+}
+//---------------------------------------
+// Play NUM_TICKS ticks of random input over the delayed network, then bring every
+// peer to the same tick with all input known and simulate it
+static void RunPeers( ShipSimulation* peers[] )
+{
+	ShipState initialState;
+	memset( &initialState, 0, sizeof( ShipState ) );
+
+	ShipInput inputs[ NUM_PEERS ];
+	ShipInput noInput;
+	memset( inputs, 0, sizeof( inputs ) );
+	memset( &noInput, 0, sizeof( ShipInput ) );
+
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		peers[p] = new ShipSimulation( SimulateShips, NUM_PEERS, p, initialState, INPUT_DELAY );
+	}
+
+	std::vector< InFlight > network;
+	for ( int tick = 0; tick < NUM_TICKS; ++tick )
+	{
+		for ( int p = 0; p < NUM_PEERS; ++p )
+		{
+			if ( rand() % 8 == 0 )
+			{
+				inputs[p].Turn = (int8) ( rand() % 3 - 1 );
+				inputs[p].Thrust = (int8) ( rand() % 3 );
+			}
+			AdvancePeer( peers[p], inputs[p] );
+		}
+		ExchangeInputs( network, peers, tick, true );
+	}
+
+	// Deliver everything straight away until all peers wait on the same tick with its input known
+	const int32 lastTick = NUM_TICKS + MAX_DELIVERY_DELAY;
+	bool caughtUp = false;
+	for ( int round = 0; round < 1000 && !caughtUp; ++round )
+	{
+		ExchangeInputs( network, peers, NUM_TICKS + MAX_DELIVERY_DELAY + round, false );
+
+		caughtUp = true;
+		for ( int p = 0; p < NUM_PEERS; ++p )
+		{
+			if ( peers[p]->GetCurrentTick() < lastTick )
+			{
+				AdvancePeer( peers[p], noInput );
+			}
+			caughtUp = caughtUp && peers[p]->GetCurrentTick() == lastTick && peers[p]->GetConfirmedTick() >= lastTick;
+		}
+	}
+	Check( caughtUp, "Peers caught up" );
+
+	// Rolls back for any input that arrived last round, then simulates lastTick with no predictions
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		AdvancePeer( peers[p], noInput );
+	}
+}
+//---------------------------------------
+static void DestroyPeers( ShipSimulation* peers[] )
+{
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		Delete0( peers[p] );
+	}
+}
+//---------------------------------------
+
+
+//---------------------------------------
+// Tests
+//---------------------------------------
+static void TestFixedPointMath()
+{
+	double maxSinError = 0;
+	double maxCosError = 0;
+	for ( double angle = -20.0; angle < 20.0; angle += 0.01 )
+	{
+		maxSinError = Mathd::Max( maxSinError, fabs( (double) sin( Fixed( angle ) ) - ::sin( angle ) ) );
+		maxCosError = Mathd::Max( maxCosError, fabs( (double) cos( Fixed( angle ) ) - ::cos( angle ) ) );
+	}
+
+	double maxSqrtError = 0;
+	for ( double x = 0.0; x < 1000.0; x += 0.37 )
+	{
+		maxSqrtError = Mathd::Max( maxSqrtError, fabs( (double) sqrt( Fixed( x ) ) - ::sqrt( x ) ) );
+	}
+
+	ConsolePrintf( "FixedPoint max error: sin %f cos %f sqrt %f\n", maxSinError, maxCosError, maxSqrtError );
+	Check( maxSinError < 0.002, "FixedPoint sin" );
+	Check( maxCosError < 0.002, "FixedPoint cos" );
+	Check( maxSqrtError < 0.001, "FixedPoint sqrt" );
+	Check( sqrt( Fixed( -4 ) ) == Fixed(), "FixedPoint sqrt of a negative is 0" );
+}
+//---------------------------------------
+// Late, reordered input is rolled back and every peer ends on the same state
+static void TestSync()
+{
+	ShipSimulation* peers[ NUM_PEERS ];
+	RunPeers( peers );
+
+	uint32 hash = ShipSimulation::HashState( peers[0]->GetState() );
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		ConsolePrintf( "Peer %d: tick %d rollbacks %d resimulated %d hash %08x\n", p, peers[p]->GetCurrentTick(),
+			peers[p]->GetNumRollbacks(), peers[p]->GetNumResimulatedTicks(), ShipSimulation::HashState( peers[p]->GetState() ) );
+
+		Check( ShipSimulation::HashState( peers[p]->GetState() ) == hash, "Peers have the same state" );
+		Check( peers[p]->GetCurrentTick() == peers[0]->GetCurrentTick(), "Peers on the same tick" );
+		Check( peers[p]->GetNumRollbacks() > 0, "Late input rolled back" );
+		Check( !peers[p]->IsDesynced(), "No desync" );
+	}
+
+	DestroyPeers( peers );
+}
+//---------------------------------------
+// One peer simulates a tick differently, everyone has to notice
+static void TestDesync()
+{
+	ShipSimulation* peers[ NUM_PEERS ];
+	gCorruptPeer = 1;
+	RunPeers( peers );
+	gCorruptPeer = -1;
+
+	for ( int p = 0; p < NUM_PEERS; ++p )
+	{
+		ConsolePrintf( "Peer %d: desync at tick %d\n", p, peers[p]->GetDesyncTick() );
+		Check( peers[p]->IsDesynced(), "Desync detected" );
+		Check( peers[p]->GetDesyncTick() > CORRUPT_TICK, "Desync after the corrupted tick" );
+	}
+
+	DestroyPeers( peers );
+}
+//---------------------------------------
+
+
+//---------------------------------------
+int main( int argc, char** argv )
+{
+	srand( argc > 1 ? atoi( argv[1] ) : 1 );
+
+	TestFixedPointMath();
+	TestSync();
+	TestDesync();
+
+	if ( gNumFailed == 0 )
+	{
+		ConsolePrintf( "LockstepTest : All checks passed\n" );
+	}
+
+	return gNumFailed == 0 ? 0 : 1;
+}
+//---------------------------------------
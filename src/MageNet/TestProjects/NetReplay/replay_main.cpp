@@ -0,0 +1,99 @@
+#include <MageMath.h>
+#include <MageCore.h>
+#include <MageNet.h>
+
+using namespace mage;
+
+/* Replays a NetSession capture into a session with no open port.
+ * Received datagrams are fed back in at their captured times, or as fast
+ * as possible with -fast which makes this a throughput benchmark of the
+ * protocol layer on real traffic.
+ *
+ * NetReplay -capture <file> [-fast] [-loops <n>]
+ */
+int main( int argc, char** argv )
+{
+	CommandArgs args( argc, argv );
+	char captureFile[256];
+	bool fast = args.HasParam( "-fast" );
+	int loops = 1;
+	PacketReader reader;
+	NetClient sender;
+	NetCaptureRecord record;
+
+	if ( !args.GetArgAs( "-capture", captureFile ) )
+	{
+		ConsolePrintf( "Usage: NetReplay -capture <file> [-fast] [-loops <n>]\n" );
+		return 1;
+	}
+	args.GetArgAs( "-loops", loops );
+
+	uint32 numRecv = 0;
+	uint32 numSent = 0;
+	uint32 bytesRecv = 0;
+	uint32 numDelivered = 0;
+	double startTime = Clock::QueryTime();
+
+	for ( int loop = 0; loop < loops; ++loop )
+	{
+		NetCaptureReader capture;
+		if ( !capture.Open( captureFile ) )
+		{
+			return 1;
+		}
+
+		// Fresh session each loop so sequence numbers line up with the capture
+		NetSession session;
+		LocalClient client = session.CreateLocalClient();
+		double loopStart = Clock::QueryTime();
+		double firstRecordMS = -1;
+
+		while ( capture.Read( record ) )
+		{
+			// What the session sent back, only interesting for stats
+			if ( record.Direction == NET_CAPTURE_SEND )
+			{
+				++numSent;
+				continue;
+			}
+
+			// Wait until the packet's time came around in the capture
+			if ( firstRecordMS < 0 )
+			{
+				firstRecordMS = record.NetTimeMS;
+			}
+			if ( !fast )
+			{
+				double due = loopStart + ( record.NetTimeMS - firstRecordMS ) / 1000.0;
+				while ( Clock::QueryTime() < due )
+				{
+					Thread::Sleep( 1 );
+				}
+			}
+
+			session.InjectPacket( record.Address, record.Data.data(), (int) record.Data.size(), record.NetTimeMS );
+			session.OnUpdate();
+			++numRecv;
+			bytesRecv += record.Data.size();
+
+			while ( client.IsDataReady() )
+			{
+				client.ReceiveData( reader, sender );
+				++numDelivered;
+			}
+		}
+	}
+
+	double elapsed = Clock::QueryTime() - startTime;
+
+	ConsolePrintf( "Replayed %u packets (%s) in %.3fs, %u captured sends skipped\n"
+		, numRecv, ByteDisplay( bytesRecv ).ToString(), elapsed, numSent );
+	ConsolePrintf( "Delivered %u packets to the application\n", numDelivered );
+	if ( elapsed > 0 )
+	{
+		ConsolePrintf( "%.0f packets/s, %.2f MB/s\n"
+			, numRecv / elapsed, bytesRecv / elapsed / ( 1024.0 * 1024.0 ) );
+	}
+
+	return 0;
+}
\ No newline at end of file
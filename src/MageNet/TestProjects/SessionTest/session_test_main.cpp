@@ -0,0 +1,140 @@
+#include <MageMath.h>
+#include <MageCore.h>
+#include <MageNet.h>
+
+using namespace mage;
+
+/* Checks NetSession over loopback. Two client sessions send to a server
+ * session which reads them by sender and by client ID, mixed. Packets must
+ * come out in arrival order whichever way they are read.
+ *
+ * SessionTest [-port <n>]
+ */
+
+static const int CLIENT_A = 1;
+static const int CLIENT_B = 2;
+static int gNumFailed = 0;
+
+//---------------------------------------
+static void Check( bool condition, const char* what )
+{
+	if ( !condition )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "FAILED : %s\n", what );
+		++gNumFailed;
+	}
+}
+//---------------------------------------
+// Payload is the client tag times 1000 plus a sequence number
+static void Send( NetSession& session, IPaddress& to, int client, int sequence )
+{
+	PacketWriter writer;
+	writer.Write< int >( client * 1000 + sequence );
+	session.SendData( writer, to, SENDOPT_NONE );
+}
+//---------------------------------------
+// Give loopback time to deliver numPackets more packets to the server
+static void Deliver( NetSession& server, int numPackets )
+{
+	int expected = server.GetNumPacketsReady() + numPackets;
+	for ( int i = 0; i < 100 && server.GetNumPacketsReady() < expected; ++i )
+	{
+		Thread::Sleep( 5 );
+		server.OnUpdate();
+	}
+	Check( server.GetNumPacketsReady() == expected, "Packets delivered over loopback" );
+}
+//---------------------------------------
+static int ReadBySender( NetSession& server, clientID_t& senderID )
+{
+	PacketReader reader;
+	NetClient sender;
+	server.ReceiveData( reader, sender );
+	senderID = sender.GetID();
+	return reader.Read< int >();
+}
+//---------------------------------------
+static int ReadByID( NetSession& server, clientID_t clientID )
+{
+	PacketReader reader;
+	server.ReceiveData( reader, clientID );
+	return reader.Read< int >();
+}
+//---------------------------------------
+
+
+//---------------------------------------
+int main( int argc, char** argv )
+{
+	CommandArgs args( argc, argv );
+	int port = 5100;
+	args.GetArgAs( "-port", port );
+
+	NetSession server;
+	NetSession clientA;
+	NetSession clientB;
+	IPaddress serverAddress;
+
+	server.OpenPort( (uint16) port );
+	clientA.OpenPort( 0 );
+	clientB.OpenPort( 0 );
+	NetManager::ResolveHost( serverAddress, "localhost", (uint16) port );
+
+	// Learn each client's ID from its first packet
+	clientID_t idA, idB;
+	Send( clientA, serverAddress, CLIENT_A, 0 );
+	Deliver( server, 1 );
+	ReadBySender( server, idA );
+	Send( clientB, serverAddress, CLIENT_B, 0 );
+	Deliver( server, 1 );
+	ReadBySender( server, idB );
+	Check( idA != idB, "Clients have different IDs" );
+
+	// A1 B1 A2, read A1 by ID then the rest by sender
+	Send( clientA, serverAddress, CLIENT_A, 1 );
+	Deliver( server, 1 );
+	Send( clientB, serverAddress, CLIENT_B, 1 );
+	Deliver( server, 1 );
+	Send( clientA, serverAddress, CLIENT_A, 2 );
+	Deliver( server, 1 );
+
+	clientID_t sender;
+	Check( ReadByID( server, idA ) == 1001, "A1 read by ID" );
+	Check( ReadBySender( server, sender ) == 2001 && sender == idB, "B1 next by sender" );
+	Check( ReadBySender( server, sender ) == 1002 && sender == idA, "A2 last by sender" );
+	Check( !server.PacketIsReady() && server.GetNumPacketsReady() == 0, "Nothing left after mixed reads" );
+
+	// Reading only by ID leaves nothing behind
+	for ( int i = 0; i < 100; ++i )
+	{
+		Send( clientA, serverAddress, CLIENT_A, 100 + i );
+	}
+	Deliver( server, 100 );
+
+	bool inOrder = true;
+	for ( int i = 0; i < 100; ++i )
+	{
+		int payload = ReadByID( server, idA );
+		inOrder = inOrder && payload == 1100 + i;
+	}
+	Check( inOrder, "Packets read by ID in order" );
+	Check( server.GetNumPacketsReady() == 0, "Reading by ID removes ready entries" );
+
+	// B then A, read B by ID then A by sender
+	Send( clientB, serverAddress, CLIENT_B, 2 );
+	Deliver( server, 1 );
+	Send( clientA, serverAddress, CLIENT_A, 3 );
+	Deliver( server, 1 );
+
+	Check( ReadByID( server, idB ) == 2002, "B2 read by ID" );
+	Check( ReadBySender( server, sender ) == 1003 && sender == idA, "A3 next by sender" );
+	Check( server.GetNumPacketsReady() == 0, "Nothing left at the end" );
+
+	if ( gNumFailed == 0 )
+	{
+		ConsolePrintf( "SessionTest : All checks passed\n" );
+	}
+
+	return gNumFailed == 0 ? 0 : 1;
+}
+//---------------------------------------
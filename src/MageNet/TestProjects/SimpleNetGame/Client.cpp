@@ -6,9 +6,19 @@ IPaddress gServerAddr;
 LocalClient gClient;
 int gClientIndex;
 Player* gLocalPlayer;
-bool gClientPosChanged;
 float gLastFireTime;
 
+// Prediction
+PlayerPrediction gPrediction( SimulatePlayerInput, SIM_STEP );
+PlayerInput gPendingInput;
+
+// Interpolation of remote players
+PlayerInterpolator gInterpolator( LerpPlayerMoveState, MAX_PLAYERS );
+
+// Replicated remote players, decoded here by entity ID then handed to the interpolator
+ReplicationManager gReplication( MAX_PLAYERS );
+Player gReplicatedPlayers[ MAX_PLAYERS ];
+
 // Effects
 SpringGrid* gGrid;
 BloomEffect gGlow;
@@ -41,7 +51,7 @@ void InitClient( const std::string& addr )
 	RegisterInputFn( ClientInput );
 
 	// Events
-	EventManager::RegisterFunctionForEvent( "ClientSendPos", ClientSendPos );
+	EventManager::RegisterFunctionForEvent( "ClientSendInput", ClientSendInput );
 	EventManager::RegisterFunctionForEvent( "PlayerThrust", PlayerThrust );
 	EventManager::RegisterFunctionForEvent( "PlayerSteer", PlayerSteer );
 	EventManager::RegisterFunctionForEvent( "Fire", ClientFire );
@@ -71,13 +81,22 @@ void InitClient( const std::string& addr )
 
 	gExplosionMangaer.Init();
 
+	gReplication.AddClass( CreatePlayerClass( OnReplicatedPlayerCreate, NULL, OnReplicatedPlayerUpdate ) );
+
+	// Host lookups run on a worker so a slow DNS server doesn't freeze the window
+	JobManager::CreateJobManager();
+	JobManager::GetInstance()->SetMaxWorkerThreads( 1 );
+
 	gClient = gSession->CreateLocalClient();
-	gServerAddr = gClient.ConnectTo( addr.c_str(), 5000 );
+	gClient.ConnectToAsync( addr.c_str(), 5000, OnServerResolved );
 
 	gClientIndex = -1;
 	gLocalPlayer = 0;
-	gClientPosChanged = false;
 	gLastFireTime = 0;
+	gPendingInput.steer = 0;
+	gPendingInput.thrust = 0;
+	// Remote players are sent every 50ms, stay two updates behind
+	gInterpolator.SetDelay( 0.1, 0.05, 0.5 );
 	RNG::SetRandomSeed( (unsigned long) time(0) );
 }
 //--------------------------------------
@@ -85,6 +104,7 @@ void OnClientExit()
 {
 	gClient.Disconnect();
 	delete gSession;
+	JobManager::DestroyJobManager();
 }
 //--------------------------------------
 void ClientUpdate( float dt )
@@ -95,10 +115,19 @@ void ClientUpdate( float dt )
 	// Update players
 	UpdatePlayers( gPlayers, dt );
 
-	if ( gClientIndex >= 0 && gPlayers[ gClientIndex ].vel.LengthSqr() != 0 )
-		gClientPosChanged = true;
+	// Predict local player from this frame's input
+	if ( LocalPlayerAliveAndWell )
+	{
+		PlayerMoveState state;
+		GetPlayerMoveState( gLocalPlayer, state );
+		gPrediction.ApplyInput( state, gPendingInput );
+		SetPlayerMoveState( gLocalPlayer, state );
+	}
+	gPendingInput.steer = 0;
+	gPendingInput.thrust = 0;
 
 	// Update network
+	JobManager::GetInstance()->OnUpdate();
 	gSession->OnUpdate();
 
 	gLastFireTime = Mathf::Max( gLastFireTime - dt, 0 );
@@ -119,10 +148,11 @@ void ClientUpdate( float dt )
 		{
 			gClientIndex = gReader.Read< int >();
 			gLocalPlayer = &gPlayers[ gClientIndex ];
+			gLocalPlayer->inputDriven = 1;
 
 			ConsolePrintf( "Client : I am player %d\n", gClientIndex );
 
-			gClock->PostEventCallbackAfter( "ClientSendPos", 0.05 );
+			gClock->PostEventCallbackAfter( "ClientSendInput", 0.05 );
 		}
 
 		// Player(s) joined
@@ -133,10 +163,24 @@ void ClientUpdate( float dt )
 			for ( int i = 0; i < num; ++i )
 			{
 				int index = DeserializePlayer( gPlayers, gReader );
+				if ( index < 0 )
+				{
+					break;
+				}
 
 				player = &gPlayers[ index ];
 				player->active = 1;
 
+				// Remote players are drawn from snapshots
+				if ( index != gClientIndex )
+				{
+					PlayerMoveState state;
+					GetPlayerMoveState( player, state );
+					player->interpolated = 1;
+					gInterpolator.Clear( index );
+					gInterpolator.AddSnapshot( index, gReader.Timestamp / 1000.0, state, gSession->GetNetTimeSeconds() );
+				}
+
 				ConsolePrintf( "Client : Player joined id=%d name=%s\n", index, player->name );
 
 				gGrid->ApplyDirectionalForce( Vec3f( 0, 0, 5000 ), Vec3f( player->pos.x, player->pos.y, 0 ), 80 );
@@ -153,51 +197,74 @@ void ClientUpdate( float dt )
 				int index = gReader.Read< int >();
 				player = &gPlayers[ index ];
 				player->active = 0;
+				player->interpolated = 0;
 				player->ID = 0;
+				gInterpolator.Clear( index );
 
 				ConsolePrintf( "Client : Player left id=%d name=%s\n", index, player->name );
 			}
 		}
 
-		// Location info
-		if ( commands_in & NC_LOCATION )
+		// Replicated players
+		if ( commands_in & NC_REPLICATE )
 		{
-			int num = gReader.Read< int >();
-			for ( int i = 0; i < num; ++i )
+			gReplication.ReadUpdate( gReader );
+		}
+
+		// Authoritative state for our player
+		if ( commands_in & NC_STATE )
+		{
+			StateMsg msg;
+			PlayerMoveState serverState;
+			if ( !gReader.ReadMessage( msg ) )
 			{
-				int index = gReader.Read< int >();
-				player = &gPlayers[ index ];
-				player->pos = gReader.Read< Vec2f >();
-				player->rotation = gReader.Read< float >();
+				continue;
+			}
+			serverState.pos = msg.pos;
+			serverState.vel = msg.vel;
+			serverState.rotation = msg.rotation;
 
-				gGrid->ApplyExplosionForce( 40, player->pos, 20 );
+			// Rewind to the server state and replay unacknowledged inputs
+			if ( LocalPlayerAliveAndWell )
+			{
+				PlayerMoveState state;
+				GetPlayerMoveState( gLocalPlayer, state );
+				gPrediction.Reconcile( state, serverState, msg.lastInput );
+				SetPlayerMoveState( gLocalPlayer, state );
 			}
 		}
 
 		// Fire info
 		if ( commands_in & NC_FIRE )
 		{
-			int who = gReader.Read< int >();
-			int bulletIndex = gReader.Read< int >();
-			Vec2f bulletVel = gReader.Read< Vec2f >();
+			FireMsg msg;
+			if ( !gReader.ReadMessage( msg ) )
+			{
+				continue;
+			}
 
 			Dictionary params;
 
-			params.Set( "PlayerIndex", who );
-			params.Set( "BulletIndex", bulletIndex );
-			params.Set( "BulletVel", bulletVel );
+			params.Set( "PlayerIndex", msg.playerIndex );
+			params.Set( "BulletIndex", msg.bulletIndex );
+			params.Set( "BulletVel", msg.vel );
 
 			// Fire bullet in 100ms - rtt to server
 			gClock->PostEventCallbackAfter( "SpawnBullet",
-				Mathd::Max( 0.0, 0.1 - gSession->GetAverageRTT( gClient.GetID() ) ),
+				Mathd::Max( 0.0, 0.1 - gSession->GetAverageRTT( gClient.GetID() ) / 1000.0 ),
 				params );
 		}
 
 		// Kill info
 		if ( commands_in & NC_KILL )
 		{
-			int killer = gReader.Read< int >();
-			int killed = gReader.Read< int >();
+			KillMsg msg;
+			if ( !gReader.ReadMessage( msg ) )
+			{
+				continue;
+			}
+			int killer = msg.killerIndex;
+			int killed = msg.killedIndex;
 			gPlayers[killed].alive = 0;
 			gPlayers[killed].timeToRespawn = RESPAWN_TIME;
 
@@ -209,16 +276,48 @@ void ClientUpdate( float dt )
 		// Respawn info
 		if ( commands_in & NC_RESPAWN )
 		{
-			int who = gReader.Read< int >();
+			RespawnMsg msg;
+			if ( !gReader.ReadMessage( msg ) )
+			{
+				continue;
+			}
+			int who = msg.index;
 			gPlayers[who].alive = 1;
-			gPlayers[who].pos = gReader.Read< Vec2f >();
+			gPlayers[who].pos = msg.pos;
 			gPlayers[who].rotation = 0;
 			gPlayers[who].vel = Vec2f::ZERO;
 
+			// Inputs from before we died no longer apply
+			if ( who == gClientIndex )
+			{
+				gPrediction.Reset();
+			}
+			// Don't interpolate from where they died
+			else
+			{
+				PlayerMoveState state;
+				GetPlayerMoveState( &gPlayers[who], state );
+				gInterpolator.Clear( who );
+				gInterpolator.AddSnapshot( who, gReader.Timestamp / 1000.0, state, gSession->GetNetTimeSeconds() );
+			}
+
 			gGrid->ApplyDirectionalForce( Vec3f( 0, 0, 5000 ), Vec3f( gPlayers[who].pos.x, gPlayers[who].pos.y, 0 ), 80 );
 		}
 	}
 
+	// Place remote players from their snapshots
+	gInterpolator.OnUpdate( dt );
+	double renderTime = gInterpolator.GetRenderTime( gSession->GetNetTimeSeconds() );
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		PlayerMoveState state;
+		player = &gPlayers[i];
+		if ( player->active && player->interpolated && gInterpolator.Sample( i, renderTime, state ) )
+		{
+			SetPlayerMoveState( player, state );
+		}
+	}
+
 	gGrid->OnUpdate( dt );
 	gExplosionMangaer.OnUpdate( dt );
 
@@ -281,7 +380,7 @@ void ClientUpdate( float dt )
 	
 	if ( LocalPlayerAliveAndWell )
 	{
-		DrawTextFormat( 0, 0, "Ping: %d", gSession->GetAverageRTT( gLocalPlayer->ID ) * 1000 );
+		DrawTextFormat( 0, 0, "Ping: %d", (int) gSession->GetAverageRTT( gLocalPlayer->ID ) );
 	}
 
 	DrawPlayerNames( gPlayers, 10, 28 );
@@ -294,6 +393,16 @@ bool ClientInput( SDL_Event& sdlEvent )
 	return DefaultInputFn( sdlEvent );
 }
 //--------------------------------------
+void OnServerResolved( bool success, IPaddress serverAddr, void* userData )
+{
+	if ( !success )
+	{
+		ConsolePrintf( CONSOLE_ERROR, "Client : Could not find server\n" );
+		return;
+	}
+	gServerAddr = serverAddr;
+}
+//--------------------------------------
 void OnServerConnect( clientID_t clientID, IPaddress clientAddr )
 {
 	ConsolePrintf( "Client : Connected to %u\n", clientID );
@@ -329,23 +438,44 @@ void SendHello( const char* name )
 	gClient.SendData( gWriter, gServerAddr );
 }
 //--------------------------------------
-void ClientSendPos( Dictionary& params )
+void ClientSendInput( Dictionary& params )
 {
 	// Call this function again after a delay
-	gClock->PostEventCallbackAfter( "ClientSendPos", 0.05 );
+	gClock->PostEventCallbackAfter( "ClientSendInput", 0.05 );
 
-	// Send position packet if needed
-	if ( gClientPosChanged )
+	// Send all inputs the server has not acknowledged yet.
+	// Resending covers lost packets, the server skips inputs it already applied.
+	int num = Mathi::Min( gPrediction.GetNumPendingInputs(), MAX_INPUTS_PER_PACKET );
+	uint32 command = 0;
+
+	if ( num > 0 )
+	{
+		command |= NC_INPUT;
+	}
+	// Ack replication updates along with the inputs
+	if ( gReplication.HasReceivedUpdates() )
 	{
-		uint32 command = 0;
+		command |= NC_REPLICATE;
+	}
 
-		gClientPosChanged = false;
+	if ( command )
+	{
+		gWriter.Write( command );
 
-		command |= NC_LOCATION;
+		if ( command & NC_INPUT )
+		{
+			gWriter.Write( num );
+			gWriter.Write( gPrediction.GetPendingSequence( 0 ) );
+			for ( int i = 0; i < num; ++i )
+			{
+				gWriter.Write( gPrediction.GetPendingInput( i ) );
+			}
+		}
 
-		gWriter.Write( command );
-		gWriter.Write( gLocalPlayer->pos );
-		gWriter.Write( gLocalPlayer->rotation );
+		if ( command & NC_REPLICATE )
+		{
+			gReplication.WriteAcks( gWriter );
+		}
 
 		gClient.SendData( gWriter, gServerAddr );
 	}
@@ -359,25 +489,19 @@ void PlayerSteer( Dictionary& params )
 	{
 		params.Get( "x", x );
 
-		gLocalPlayer->rotation += x;
-		gClientPosChanged = true;
+		gPendingInput.steer += x;
 	}
 }
 //--------------------------------------
 void PlayerThrust( Dictionary& params )
 {
 	float x = 0;
-	const float radians = gLocalPlayer->rotation;
-
-	const float cosRot = std::cos( radians );
-	const float sinRot = std::sin( radians );
 
 	if ( LocalPlayerAliveAndWell )
 	{
 		params.Get( "x", x );
 
-		gLocalPlayer->vel += Vec2f( sinRot * x, cosRot * x );
-		gClientPosChanged = true;
+		gPendingInput.thrust += x;
 	}
 }
 //--------------------------------------
@@ -392,6 +516,8 @@ void ClientFire( Dictionary& params )
 			uint32 commands = NC_FIRE;
 			gWriter.Write( commands );
 			gWriter.Write( gLocalPlayer->index );
+			// Lets the server rewind to what we saw when we fired
+			gWriter.Write( (float) gInterpolator.GetDelay() );
 
 			gClient.SendData( gWriter, gServerAddr );
 		}
@@ -415,5 +541,30 @@ void ClientSpawnBullet( Dictionary& params )
 	b.pos = gPlayers[ who ].pos;
 	b.vel = bulletVel;
 	b.lifetime = BULLET_LIFE;
+	b.rewind = 0;
+}
+//--------------------------------------
+void* OnReplicatedPlayerCreate( netEntityID_t id )
+{
+	return &gReplicatedPlayers[ id ];
+}
+//--------------------------------------
+void OnReplicatedPlayerUpdate( netEntityID_t id, void* object, uint32 changedMask )
+{
+	const Player* replicated = (const Player*) object;
+
+	if ( replicated->index == gClientIndex || !( changedMask & ( RP_PLAYER_POS | RP_PLAYER_ROTATION ) ) )
+	{
+		return;
+	}
+
+	PlayerMoveState state;
+	state.pos = replicated->pos;
+	state.vel = Vec2f::ZERO;
+	state.rotation = replicated->rotation;
+
+	gInterpolator.AddSnapshot( replicated->index, gReader.Timestamp / 1000.0, state, gSession->GetNetTimeSeconds() );
+
+	gGrid->ApplyExplosionForce( 40, state.pos, 20 );
 }
 //--------------------------------------
\ No newline at end of file
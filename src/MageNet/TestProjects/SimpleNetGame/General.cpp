@@ -1,11 +1,13 @@
 #include "main.h"
 
+#ifndef HEADLESS_SERVER
 //--------------------------------------
 void InitGraphics()
 {
 	// Init renderer
 	CreateRenderer();
 }
+#endif
 //--------------------------------------
 Player* GetPlayerByID( Player* players, clientID_t id )
 {
@@ -52,50 +54,65 @@ Color GetColorForPlayer( int index )
 //--------------------------------------
 void SerializePlayer( Player* player, PacketWriter& writer )
 {
-	writer.Write( player->index );
-	writer.WriteString( player->name );
-	writer.Write( player->pos );
-	writer.Write( player->vel );
-	writer.Write( player->rotation );
-	writer.Write( player->alive );
+	PlayerMsg msg;
+	msg.index = player->index;
+	strncpy( msg.name, player->name, MAX_NAME_LEN );
+	msg.name[ MAX_NAME_LEN - 1 ] = 0;
+	msg.pos = player->pos;
+	msg.vel = player->vel;
+	msg.rotation = player->rotation;
+	msg.alive = player->alive;
+	writer.WriteMessage( msg );
+
 	for ( int i = 0; i < MAX_BULLETS; ++i )
 	{
-		writer.Write( player->bullets[i].active );
-		writer.Write( player->bullets[i].pos );
-		writer.Write( player->bullets[i].vel );
-		writer.Write( player->bullets[i].lifetime );
+		BulletMsg bullet;
+		bullet.active   = player->bullets[i].active;
+		bullet.pos      = player->bullets[i].pos;
+		bullet.vel      = player->bullets[i].vel;
+		bullet.lifetime = player->bullets[i].lifetime;
+		writer.WriteMessage( bullet );
 	}
 }
 //--------------------------------------
 int DeserializePlayer( Player* players, PacketReader& reader )
 {
 	Player* player;
-	int index;
+	PlayerMsg msg;
 
-	index = reader.Read< int >();
-	player = &players[ index ];
+	if ( !reader.ReadMessage( msg ) )
+	{
+		return -1;
+	}
 
-	player->index = index;
-	reader.ReadString( player->name, MAX_NAME_LEN );
-	player->pos = reader.Read< Vec2f >();
-	player->vel = reader.Read< Vec2f >();
-	player->rotation = reader.Read< float >();
-	player->alive = reader.Read< int >();
+	player = &players[ msg.index ];
+
+	player->index = msg.index;
+	memcpy( player->name, msg.name, MAX_NAME_LEN );
+	player->pos = msg.pos;
+	player->vel = msg.vel;
+	player->rotation = msg.rotation;
+	player->alive = msg.alive;
 	player->killedBy = -1;
 	for ( int i = 0; i < MAX_BULLETS; ++i )
 	{
-		player->bullets[i].active      = reader.Read< int >();
-		player->bullets[i].pos         = reader.Read< Vec2f >();
-		player->bullets[i].vel         = reader.Read< Vec2f >();
-		player->bullets[i].lifetime	   = reader.Read< float >();
+		BulletMsg bullet;
+		if ( !reader.ReadMessage( bullet ) )
+		{
+			return -1;
+		}
+		player->bullets[i].active      = bullet.active;
+		player->bullets[i].pos         = bullet.pos;
+		player->bullets[i].vel         = bullet.vel;
+		player->bullets[i].lifetime	   = bullet.lifetime;
 		player->bullets[i].ownerIndex  = player->index;
 		player->bullets[i].index       = i;
 	}
 
-	return index;
+	return msg.index;
 }
 //--------------------------------------
-void UpdatePlayers( Player* players, float dt )
+void UpdatePlayers( Player* players, float dt, const PlayerHistory* history, double now )
 {
 	Player* player;
 	for ( int i = 0; i < MAX_PLAYERS; ++i )
@@ -105,13 +122,17 @@ void UpdatePlayers( Player* players, float dt )
 		// Update player
 		if ( player->active && player->alive )
 		{
-			player->pos += player->vel * dt;
-			player->vel *= 0.98f;
+			// Input driven and interpolated players are moved elsewhere
+			if ( !player->inputDriven && !player->interpolated )
+			{
+				player->pos += player->vel * dt;
+				player->vel *= 0.98f;
 
-			if ( player->pos.x > 800 ) player->pos.x = 0;
-			if ( player->pos.x < 0 )   player->pos.x = 800;
-			if ( player->pos.y > 600 ) player->pos.y = 0;
-			if ( player->pos.y < 0 )   player->pos.y = 600;
+				if ( player->pos.x > 800 ) player->pos.x = 0;
+				if ( player->pos.x < 0 )   player->pos.x = 800;
+				if ( player->pos.y > 600 ) player->pos.y = 0;
+				if ( player->pos.y < 0 )   player->pos.y = 600;
+			}
 
 			// Update players bullets
 			for ( int j = 0; j < MAX_BULLETS; ++j )
@@ -131,7 +152,16 @@ void UpdatePlayers( Player* players, float dt )
 						if ( k != i )
 						{
 							Player* otherP = &players[k];
-							Vec2f d = otherP->pos - b->pos;
+							Vec2f targetPos = otherP->pos;
+							Vec2f pastPos;
+
+							// Test against where the shooter saw the target
+							if ( history && b->rewind > 0 && history->GetPositionAt( k, now - b->rewind, pastPos ) )
+							{
+								targetPos = pastPos;
+							}
+
+							Vec2f d = targetPos - b->pos;
 							float radius = BULLET_RADIUS * PLAYER_RADIUS;
 							if ( d.LengthSqr() < radius * radius && otherP->alive )
 							{
@@ -158,6 +188,68 @@ void UpdatePlayers( Player* players, float dt )
 	}
 }
 //--------------------------------------
+void SimulatePlayerInput( PlayerMoveState& state, const PlayerInput& input, float dt )
+{
+	state.rotation += input.steer;
+
+	const float cosRot = std::cos( state.rotation );
+	const float sinRot = std::sin( state.rotation );
+
+	state.vel += Vec2f( sinRot * input.thrust, cosRot * input.thrust );
+	state.pos += state.vel * dt;
+	state.vel *= 0.98f;
+
+	if ( state.pos.x > 800 ) state.pos.x = 0;
+	if ( state.pos.x < 0 )   state.pos.x = 800;
+	if ( state.pos.y > 600 ) state.pos.y = 0;
+	if ( state.pos.y < 0 )   state.pos.y = 600;
+}
+//--------------------------------------
+void GetPlayerMoveState( const Player* player, PlayerMoveState& state )
+{
+	state.pos = player->pos;
+	state.vel = player->vel;
+	state.rotation = player->rotation;
+}
+//--------------------------------------
+void SetPlayerMoveState( Player* player, const PlayerMoveState& state )
+{
+	player->pos = state.pos;
+	player->vel = state.vel;
+	player->rotation = state.rotation;
+}
+//--------------------------------------
+void LerpPlayerMoveState( const PlayerMoveState& a, const PlayerMoveState& b, float t, PlayerMoveState& out )
+{
+	// Player wrapped around the screen edge, don't drag it across the screen
+	Vec2f d = b.pos - a.pos;
+	if ( std::abs( d.x ) > 400 || std::abs( d.y ) > 300 )
+	{
+		out = t < 0.5f ? a : b;
+		return;
+	}
+
+	// Rotation is sent wrapped to [0,2pi), turn the short way around
+	float dr = b.rotation - a.rotation;
+	if ( dr > Mathf::PI )  dr -= Mathf::TWO_PI;
+	if ( dr < -Mathf::PI ) dr += Mathf::TWO_PI;
+
+	out.pos = a.pos + d * t;
+	out.vel = a.vel + ( b.vel - a.vel ) * t;
+	out.rotation = a.rotation + dr * t;
+}
+//--------------------------------------
+ReplicatedClass* CreatePlayerClass( ReplicatedClass::CreateFn create, ReplicatedClass::DestroyFn destroy, ReplicatedClass::UpdateFn update )
+{
+	// Same order as PlayerProperty
+	ReplicatedClass* playerClass = new ReplicatedClass( "Player", create, destroy, update );
+	playerClass->AddProperty< PlayerIndexCodec >( &Player::index );
+	playerClass->AddProperty< ScreenPosCodec >( &Player::pos );
+	playerClass->AddProperty< RotationCodec >( &Player::rotation );
+	return playerClass;
+}
+#ifndef HEADLESS_SERVER
+//--------------------------------------
 void DrawPlayerNames( Player* payers, float x, float y )
 {
 	DrawRect( x, y, 128, 14 * MAX_PLAYERS, Color( 0x88000000 ) );
@@ -176,4 +268,5 @@ void DrawPlayerNames( Player* payers, float x, float y )
 		}
 	}
 }
-//--------------------------------------
\ No newline at end of file
+//--------------------------------------
+#endif
\ No newline at end of file
@@ -1,39 +1,71 @@
 #include "main.h"
 
+#ifdef HEADLESS_SERVER
+#	include <signal.h>
+#endif
+
 using namespace mage;
 
 LocalClient gServer;
+PlayerInputProcessor* gPlayerInputs[ MAX_PLAYERS ];
+PlayerHistory gPlayerHistory( MAX_PLAYERS );
+ReplicationManager gReplication( MAX_PLAYERS );
+netEntityID_t gPlayerEntities[ MAX_PLAYERS ];
+int gPlayerClass;
+#ifdef HEADLESS_SERVER
+volatile bool gServerRunning;
+#endif
 
 //--------------------------------------
 void InitServer()
 {
+#ifndef HEADLESS_SERVER
 	InitApp( "Simple Net Game - Server", 300, 400 );
 
 	InitGraphics();
 	SetViewport( 0, 0, 300, 400 );
 	SetOrthoView( 0, 300, 400, 0, 0, 1 );
+#endif
 
 	gClock = &Clock::Initialize();
 
+#ifndef HEADLESS_SERVER
 	RegisterUpdateFn( ServerUpdate );
+#endif
 
 	EventManager::RegisterFunctionForEvent( "RespawnPlayer", RespawnPlayer );
 
 	gSession = new NetSession();
+	gSession->EnableOffload( UDPOFFLOAD_SEND_SEGMENTS | UDPOFFLOAD_RECV_COALESCE );
 	gSession->OpenPort( 5000 );
 	gSession->VerboseDebugMsg = VERBOSE_NET_DEBUG;
 	gSession->SetMaxPacketSize( 2048 );
+	gSession->SetDefaultBandwidth( CLIENT_BANDWIDTH );
+	gSession->SetAdaptiveBandwidth( true );
 
 	gServer = gSession->CreateLocalClient();
 	
 	gSession->RegisterClientConnectCallback( OnNewClient );
 	gSession->RegisterClientDisconnectCallback( OnLostClient );
+
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		gPlayerInputs[i] = new PlayerInputProcessor( SimulatePlayerInput, SIM_STEP );
+	}
+
+	gPlayerClass = gReplication.AddClass( CreatePlayerClass() );
+	gReplication.SetPriorityCallback( GetPlayerRelevance );
 }
 //--------------------------------------
 void OnServerExit()
 {
 	gSession->DropAllClients();
 	delete gSession;
+
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		Delete0( gPlayerInputs[i] );
+	}
 }
 //--------------------------------------
 void ServerUpdate( float dt )
@@ -48,7 +80,7 @@ void ServerUpdate( float dt )
 	gClock->AdvanceTime( dt );
 
 	// Update players
-	UpdatePlayers( gPlayers, dt );
+	UpdatePlayers( gPlayers, dt, &gPlayerHistory, gSession->GetNetTimeSeconds() );
 
 	// Update network
 	gSession->OnUpdate();
@@ -87,45 +119,79 @@ void ServerUpdate( float dt )
 			ConsolePrintf( "Got name msg: %s\n", player->name );
 		}
 
-		// Client position update
-		if ( commands_in & NC_LOCATION )
+		// Client input commands
+		if ( commands_in & NC_INPUT )
 		{
-			player->pos = gReader.Read< Vec2f >();
-			player->rotation = gReader.Read< float >();
-			
-			// Replicate location message to other clients
-			gWriter.Write( (uint32) NC_LOCATION );
-			gWriter.Write( 1 );
-			gWriter.Write( player->index );
-			gWriter.Write( player->pos );
-			gWriter.Write( player->rotation );
-			for ( int i = 0; i < MAX_PLAYERS; ++i )
+			PlayerInputProcessor* inputs = gPlayerInputs[ player->index ];
+			PlayerMoveState state;
+			int num = gReader.Read< int >();
+			inputSeq_t sequence = gReader.Read< inputSeq_t >();
+
+			// Clients never send more than this, the rest of the packet can't be trusted
+			if ( num < 0 || num > MAX_INPUTS_PER_PACKET )
 			{
-				if ( gPlayers[i].active && i != player->index )
+				ConsolePrintf( CONSOLE_WARNING, "Server : Client %u sent %d inputs, dropping packet\n", client.GetID(), num );
+				continue;
+			}
+
+			// Apply inputs we have not seen yet (resent inputs are skipped)
+			GetPlayerMoveState( player, state );
+			for ( int i = 0; i < num; ++i, ++sequence )
+			{
+				PlayerInput input = gReader.Read< PlayerInput >();
+				if ( player->alive )
 				{
-					gServer.SendData( PacketWriter( gWriter ), gPlayers[i].address );
+					inputs->ApplyInput( state, sequence, input );
 				}
 			}
-			gWriter.Clear();
+			SetPlayerMoveState( player, state );
+
+			// Echo the authoritative state back to the owner
+			StateMsg stateMsg;
+			stateMsg.lastInput = inputs->GetLastProcessedInput();
+			stateMsg.pos = player->pos;
+			stateMsg.vel = player->vel;
+			stateMsg.rotation = player->rotation;
+			gWriter.Write( (uint32) NC_STATE );
+			gWriter.WriteMessage( stateMsg );
+			gServer.SendData( gWriter, client.Address );
+			
+			// Other clients get the new location through replication
+			gReplication.MarkDirty( gPlayerEntities[ player->index ], RP_PLAYER_POS | RP_PLAYER_ROTATION );
+		}
+
+		// Replication updates the client has received
+		if ( commands_in & NC_REPLICATE )
+		{
+			gReplication.ReadAcks( client.GetID(), gReader );
 		}
 
 		// Client requesting to fire
 		if ( commands_in & NC_FIRE )
 		{
 //			ConsolePrintf( "Server : Got fire command from %u\n", client.GetID() );
+			gReader.Read< int >();	// playerIndex, we already know the sender
+			float viewDelay = gReader.Read< float >();
+
 			b = ServerFire( player );
 			if ( b )
 			{
+				// The shooter saw other players as of its send time minus its interpolation delay
+				double viewTime = gReader.Timestamp / 1000.0 - viewDelay;
+				b->rewind = (float) Mathd::Clamp( gSession->GetNetTimeSeconds() - viewTime, 0.0, MAX_LAG_COMPENSATION );
+
 				// Replicate fire message to other clients
+				FireMsg fireMsg;
+				fireMsg.playerIndex = player->index;
+				fireMsg.bulletIndex = b->index;
+				fireMsg.vel = b->vel;
 				gWriter.Write( (uint32) NC_FIRE );
-				gWriter.Write( player->index );
-				gWriter.Write( b->index );
-				gWriter.Write( b->vel );
+				gWriter.WriteMessage( fireMsg );
 				for ( int i = 0; i < MAX_PLAYERS; ++i )
 				{
 					if ( gPlayers[i].active )
 					{
-						gServer.SendData( PacketWriter( gWriter ), gPlayers[i].address );
+						gServer.SendData( gWriter, gPlayers[i].address, SENDOPT_NONE, false );
 					}
 				}
 				gWriter.Clear();
@@ -172,7 +238,7 @@ void ServerUpdate( float dt )
 				{
 					if ( gPlayers[i].active && i != player->index )
 					{
-						gServer.SendData( PacketWriter( gWriter ), gPlayers[i].address, SENDOPT_RELIABLE );
+						gServer.SendData( gWriter, gPlayers[i].address, SENDOPT_RELIABLE, false );
 					}
 				}
 				gWriter.Clear();
@@ -180,6 +246,16 @@ void ServerUpdate( float dt )
 		}
 	}
 
+	// Remember where everyone is this tick for lag compensation
+	gPlayerHistory.BeginTick( gSession->GetNetTimeSeconds() );
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		if ( gPlayers[i].active && gPlayers[i].alive )
+		{
+			gPlayerHistory.Record( i, gPlayers[i].pos );
+		}
+	}
+
 	// Process kills
 	commands_out = 0;
 	for ( int i = 0; i < MAX_PLAYERS; ++i )
@@ -193,8 +269,10 @@ void ServerUpdate( float dt )
 				gWriter.Write( commands_out );
 			}
 
-			gWriter.Write( player->killedBy );
-			gWriter.Write( player->index );
+			KillMsg killMsg;
+			killMsg.killerIndex = player->killedBy;
+			killMsg.killedIndex = player->index;
+			gWriter.WriteMessage( killMsg );
 
 			player->killedBy = -1;
 			player->alive = 0;
@@ -209,6 +287,23 @@ void ServerUpdate( float dt )
 		gServer.SendData( gWriter );
 	}
 
+	// Replicate players, the most relevant to each client first
+	for ( int i = 0; i < MAX_PLAYERS; ++i )
+	{
+		player = &gPlayers[i];
+		if ( player->active )
+		{
+			gWriter.Write( (uint32) NC_REPLICATE );
+			if ( gReplication.WriteUpdate( player->ID, gWriter, REPLICATION_BUDGET, dt ) )
+			{
+				// Lost or dropped updates are resent by the replication manager
+				gServer.SendData( gWriter, player->address, SENDOPT_LOW_PRIORITY );
+			}
+			gWriter.Clear();
+		}
+	}
+
+#ifndef HEADLESS_SERVER
 	// Render
 	ClearScreen();
 
@@ -218,6 +313,7 @@ void ServerUpdate( float dt )
 	DrawPlayerNames( gPlayers, 10, 28 );
 
 	FlushRenderer();
+#endif
 }
 //--------------------------------------
 void OnNewClient( clientID_t clientID, IPaddress clientAddr )
@@ -250,10 +346,16 @@ void OnNewClient( clientID_t clientID, IPaddress clientAddr )
 		p.ID = clientID;
 		p.index = index;
 		p.pos = RNG::RandomInRange( Vec2f( 100, 100 ), Vec2f( 700, 500 ) );
+		p.vel = Vec2f::ZERO;
 		p.rotation = 0;
 		p.alive = 1;
+		p.inputDriven = 1;
 		p.killedBy = -1;
+		gPlayerInputs[ index ]->Reset();
 		memset( p.bullets, 0, sizeof( Bullet ) * MAX_BULLETS );
+
+		gPlayerEntities[ index ] = gReplication.AddEntity( gPlayerClass, &p );
+		gReplication.AddClient( clientID );
 	}
 }
 //--------------------------------------
@@ -267,6 +369,9 @@ void OnLostClient( clientID_t clientID, IPaddress clientAddr )
 	{
 		player->active = 0;
 
+		gReplication.RemoveEntity( gPlayerEntities[ player->index ] );
+		gReplication.RemoveClient( clientID );
+
 		// Tell all other clients about the dropped player
 		int commands_out = NC_REMOVE;
 		gWriter.Write( commands_out );
@@ -277,7 +382,7 @@ void OnLostClient( clientID_t clientID, IPaddress clientAddr )
 		{
 			if ( gPlayers[i].active && i != player->index )
 			{
-				gServer.SendData( PacketWriter( gWriter ), gPlayers[i].address, SENDOPT_RELIABLE );
+				gServer.SendData( gWriter, gPlayers[i].address, SENDOPT_RELIABLE, false );
 			}
 		}
 		gWriter.Clear();
@@ -300,6 +405,7 @@ Bullet* ServerFire( Player* player )
 			b->pos = player->pos;
 			b->vel = vel;
 			b->lifetime = BULLET_LIFE;
+			b->rewind = 0;
 			b->ownerIndex = player->index;
 			break;
 		}
@@ -325,12 +431,76 @@ void RespawnPlayer( Dictionary& params )
 			player->pos = RNG::RandomInRange( Vec2f( 100, 100 ), Vec2f( 700, 500 ) );
 			player->rotation = 0;
 			player->vel = Vec2f::ZERO;
+			gReplication.MarkDirty( gPlayerEntities[ who ], RP_PLAYER_POS | RP_PLAYER_ROTATION );
 			
+			RespawnMsg respawnMsg;
+			respawnMsg.index = who;
+			respawnMsg.pos = player->pos;
 			gWriter.Write( NC_RESPAWN );
-			gWriter.Write( who );
-			gWriter.Write( player->pos );
+			gWriter.WriteMessage( respawnMsg );
 			gServer.SendData( gWriter );
 		}
 	}
 }
-//--------------------------------------
\ No newline at end of file
+//--------------------------------------
+float GetPlayerRelevance( clientID_t clientID, netEntityID_t id, const void* object )
+{
+	const Player* player = (const Player*) object;
+	const Player* viewer = GetPlayerByID( gPlayers, clientID );
+
+	// Owners get their own player through NC_STATE
+	if ( !viewer || viewer == player )
+	{
+		return 0.0f;
+	}
+
+	// Nearby players update more often
+	float distance = ( player->pos - viewer->pos ).Length();
+	return 1.0f + 400.0f / ( 100.0f + distance );
+}
+//--------------------------------------
+#ifdef HEADLESS_SERVER
+//--------------------------------------
+static void OnInterrupt( int )
+{
+	gServerRunning = false;
+}
+//--------------------------------------
+void RunDedicatedServer( int tickRate, const char* captureFile )
+{
+	TickScheduler scheduler( tickRate );
+
+	if ( captureFile && gSession->StartCapture( captureFile ) )
+	{
+		ConsolePrintf( "Server : Capturing traffic to '%s'\n", captureFile );
+	}
+
+	// The clock would otherwise clamp slow tick rates to 1/60
+	gClock->SetMaxDeltaSeconds( scheduler.GetTickDelta() );
+
+	ConsolePrintf( "Server : Running headless at %d ticks/sec\n", scheduler.GetTickRate() );
+
+	gServerRunning = true;
+	signal( SIGINT, OnInterrupt );
+
+	while ( gServerRunning )
+	{
+		if ( scheduler.WaitForNextTick( *gSession ) )
+		{
+			FrameAllocator::BeginFrame();
+			ServerUpdate( scheduler.GetTickDelta() );
+		}
+		else
+		{
+			// Woken by a packet, pull it off the socket now so it's queued for the next tick
+			gSession->OnUpdate();
+		}
+	}
+
+	ConsolePrintf( "Server : Shutting down after %u ticks (%u skipped)\n",
+		scheduler.GetTickCount(), scheduler.GetTicksSkipped() );
+
+	gSession->StopCapture();
+}
+//--------------------------------------
+#endif
\ No newline at end of file
@@ -2,6 +2,27 @@
 
 using namespace mage;
 
+#ifdef HEADLESS_SERVER
+int main( int argc, char** argv )
+{
+	CommandArgs args( argc, argv );
+	int tickRate = DEFAULT_TICK_RATE;
+	std::string capture;
+	args.GetArgAs( "-tickrate", tickRate );
+	args.GetArgAs( "-capture", capture );
+
+	InitServer();
+
+	RunDedicatedServer( tickRate, capture.empty() ? 0 : capture.c_str() );
+
+	OnServerExit();
+
+	// Worker threads are gone now
+	FrameAllocator::Terminate();
+
+	return 0;
+}
+#else
 int main( int argc, char** argv )
 {
 	CommandArgs args( argc, argv );
@@ -15,5 +36,9 @@ int main( int argc, char** argv )
 
 	isServer ? OnServerExit() : OnClientExit();
 
+	// Worker threads are gone now
+	FrameAllocator::Terminate();
+
 	return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
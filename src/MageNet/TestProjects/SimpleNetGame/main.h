@@ -2,9 +2,13 @@
 
 #include <MageMath.h>
 #include <MageCore.h>
-#include <MageRenderer.h>
 #include <MageNet.h>
-#include <MageApp.h>
+
+// Dedicated server builds define HEADLESS_SERVER and link no SDL/GL
+#ifndef HEADLESS_SERVER
+#	include <MageRenderer.h>
+#	include <MageApp.h>
+#endif
 
 using namespace mage;
 
@@ -20,6 +24,12 @@ using namespace mage;
 #define BULLET_RADIUS 5
 #define PLAYER_RADIUS 3
 #define RESPAWN_TIME 2.0f
+#define SIM_STEP ( 1.0f / 60.0f )
+#define MAX_INPUTS_PER_PACKET 32
+#define MAX_LAG_COMPENSATION 0.5
+#define DEFAULT_TICK_RATE 60
+#define REPLICATION_BUDGET 200		// Bytes of replicated state per client per tick
+#define CLIENT_BANDWIDTH 32768		// Bytes/sec sent to each client at most
 //--------------------------------------
 
 
@@ -34,6 +44,7 @@ struct Bullet
 	Vec2f pos;
 	Vec2f vel;
 	float lifetime;
+	float rewind;					// Seconds to rewind targets by for hit tests (lag compensation)
 };
 //--------------------------------------
 struct Player
@@ -48,10 +59,32 @@ struct Player
 	float rotation;
 	int killedBy;
 	int alive;
+	int inputDriven;				// Motion comes from input commands instead of dead-reckoning
+	int interpolated;				// Motion comes from the snapshot interpolator
 	float timeToRespawn;
 	Bullet bullets[ MAX_BULLETS ];
 };
 //--------------------------------------
+// One fixed step of player input
+struct PlayerInput
+{
+	float steer;
+	float thrust;
+};
+//--------------------------------------
+// Part of the player simulated from input
+struct PlayerMoveState
+{
+	Vec2f pos;
+	Vec2f vel;
+	float rotation;
+};
+//--------------------------------------
+typedef ClientPrediction< PlayerInput, PlayerMoveState > PlayerPrediction;
+typedef ServerInputProcessor< PlayerInput, PlayerMoveState > PlayerInputProcessor;
+typedef SnapshotInterpolator< PlayerMoveState > PlayerInterpolator;
+typedef LagCompensator< Vec2f > PlayerHistory;
+//--------------------------------------
 
 
 //--------------------------------------
@@ -62,14 +95,142 @@ enum NetCommand
 	NC_HELLO		= 0x0001,				// No data
 	NC_PLAYER_ID	= 0x0002,				// int
 	NC_NAME		    = 0x0004,				// char* (null terminated)
-	NC_ADD			= 0x0008,				// int (count) int (playerIndex) char* (name)
+	NC_ADD			= 0x0008,				// int (count) { PlayerMsg BulletMsg[MAX_BULLETS] }...
 	NC_REMOVE		= 0x0010,				// int (count) int (playerIndex)
-	NC_LOCATION		= 0x0020,				// int (count) int (playerIndex) vec2f (pos) float (rotation)
-	NC_FIRE			= 0x0040,				// int (playerIndex) int (bulletIndex)
-	NC_KILL			= 0x0080,				// int (killerIndex) int (killedIndex)
-	NC_RESPAWN		= 0x0100,				// int (playerIndex)
+	NC_REPLICATE	= 0x0020,				// to server: replication acks
+											// to client: replication update (see ReplicationManager)
+	NC_FIRE			= 0x0040,				// to server: int (playerIndex) float (interpDelay)
+											// to client: FireMsg
+	NC_KILL			= 0x0080,				// KillMsg
+	NC_RESPAWN		= 0x0100,				// RespawnMsg
+	NC_INPUT		= 0x0200,				// int (count) uint32 (firstSequence) PlayerInput...
+	NC_STATE		= 0x0400,				// StateMsg
+};
+//--------------------------------------
+
+
+//--------------------------------------
+// Network messages
+// Positions sent to remote players are quantized to 1/8 pixel. State used
+// for reconciliation is sent exact so replays match the server.
+//--------------------------------------
+typedef IntCodec< 0, MAX_PLAYERS - 1 > PlayerIndexCodec;
+typedef IntCodec< 0, MAX_BULLETS - 1 > BulletIndexCodec;
+typedef Vec2Codec< FloatCodec< 0, 800, 8 >, FloatCodec< 0, 600, 8 > > ScreenPosCodec;
+typedef AngleCodec< 10 > RotationCodec;
+//--------------------------------------
+// Written in front of each message, ReadMessage fails if it finds a different one
+enum NetMessageID
+{
+	MSG_PLAYER = 1,
+	MSG_BULLET,
+	MSG_STATE,
+	MSG_FIRE,
+	MSG_KILL,
+	MSG_RESPAWN,
+};
+//--------------------------------------
+// Player properties replicated to remote players, in the order they are added to the class
+enum PlayerProperty
+{
+	RP_PLAYER_INDEX		= 0x0001,
+	RP_PLAYER_POS		= 0x0002,
+	RP_PLAYER_ROTATION	= 0x0004,
+};
+//--------------------------------------
+struct PlayerMsg
+{
+	enum { ID = MSG_PLAYER };
+	int index;
+	char name[ MAX_NAME_LEN ];
+	Vec2f pos;
+	Vec2f vel;
+	float rotation;
+	int alive;
+
+	typedef MessageSchema<
+		MessageField< PlayerMsg, int, &PlayerMsg::index, PlayerIndexCodec >,
+		MessageField< PlayerMsg, char[ MAX_NAME_LEN ], &PlayerMsg::name, StringCodec< MAX_NAME_LEN - 1 > >,
+		MessageField< PlayerMsg, Vec2f, &PlayerMsg::pos, ScreenPosCodec >,
+		MessageField< PlayerMsg, Vec2f, &PlayerMsg::vel, RawCodec< Vec2f > >,
+		MessageField< PlayerMsg, float, &PlayerMsg::rotation, RotationCodec >,
+		MessageField< PlayerMsg, int, &PlayerMsg::alive, BoolCodec >
+	> Schema;
+};
+//--------------------------------------
+struct BulletMsg
+{
+	enum { ID = MSG_BULLET };
+	int active;
+	Vec2f pos;
+	Vec2f vel;
+	float lifetime;
+
+	typedef MessageSchema<
+		MessageField< BulletMsg, int, &BulletMsg::active, BoolCodec >,
+		MessageField< BulletMsg, Vec2f, &BulletMsg::pos, ScreenPosCodec >,
+		MessageField< BulletMsg, Vec2f, &BulletMsg::vel, RawCodec< Vec2f > >,
+		MessageField< BulletMsg, float, &BulletMsg::lifetime, FloatCodec< 0, (int) BULLET_LIFE, 100 > >
+	> Schema;
 };
 //--------------------------------------
+struct StateMsg
+{
+	enum { ID = MSG_STATE };
+	inputSeq_t lastInput;
+	Vec2f pos;
+	Vec2f vel;
+	float rotation;
+
+	typedef MessageSchema<
+		MessageField< StateMsg, inputSeq_t, &StateMsg::lastInput, UIntCodec< 32 > >,
+		MessageField< StateMsg, Vec2f, &StateMsg::pos, RawCodec< Vec2f > >,
+		MessageField< StateMsg, Vec2f, &StateMsg::vel, RawCodec< Vec2f > >,
+		MessageField< StateMsg, float, &StateMsg::rotation, RawCodec< float > >
+	> Schema;
+};
+//--------------------------------------
+struct FireMsg
+{
+	enum { ID = MSG_FIRE };
+	int playerIndex;
+	int bulletIndex;
+	Vec2f vel;
+
+	typedef MessageSchema<
+		MessageField< FireMsg, int, &FireMsg::playerIndex, PlayerIndexCodec >,
+		MessageField< FireMsg, int, &FireMsg::bulletIndex, BulletIndexCodec >,
+		MessageField< FireMsg, Vec2f, &FireMsg::vel, RawCodec< Vec2f > >
+	> Schema;
+};
+//--------------------------------------
+struct KillMsg
+{
+	enum { ID = MSG_KILL };
+	int killerIndex;
+	int killedIndex;
+
+	typedef MessageSchema<
+		MessageField< KillMsg, int, &KillMsg::killerIndex, PlayerIndexCodec >,
+		MessageField< KillMsg, int, &KillMsg::killedIndex, PlayerIndexCodec >
+	> Schema;
+};
+//--------------------------------------
+struct RespawnMsg
+{
+	enum { ID = MSG_RESPAWN };
+	int index;
+	Vec2f pos;
+
+	typedef MessageSchema<
+		MessageField< RespawnMsg, int, &RespawnMsg::index, PlayerIndexCodec >,
+		MessageField< RespawnMsg, Vec2f, &RespawnMsg::pos, ScreenPosCodec >
+	> Schema;
+};
+//--------------------------------------
+static_assert( MessageIDs< PlayerMsg, BulletMsg, StateMsg, FireMsg, KillMsg, RespawnMsg >::UNIQUE,
+	"SimpleNetGame: message IDs must be unique" );
+//--------------------------------------
 
 
 //--------------------------------------
@@ -86,14 +247,23 @@ static Player gPlayers[ MAX_PLAYERS ];
 //--------------------------------------
 // General
 //--------------------------------------
+#ifndef HEADLESS_SERVER
 void InitGraphics();
+void DrawPlayerNames( Player* payers, float x, float y );
+#endif
 Player* GetPlayerByID( Player* players, clientID_t id );
 int GetNumActivePlayers( Player* players );
 Color GetColorForPlayer( int index );
 void SerializePlayer( Player* player, PacketWriter& writer );
+// Returns the player index or -1 if the data was bad
 int DeserializePlayer( Player* players, PacketReader& reader );
-void UpdatePlayers( Player* players, float dt );
-void DrawPlayerNames( Player* payers, float x, float y );
+void UpdatePlayers( Player* players, float dt, const PlayerHistory* history=NULL, double now=0.0 );
+void SimulatePlayerInput( PlayerMoveState& state, const PlayerInput& input, float dt );
+void GetPlayerMoveState( const Player* player, PlayerMoveState& state );
+void SetPlayerMoveState( Player* player, const PlayerMoveState& state );
+void LerpPlayerMoveState( const PlayerMoveState& a, const PlayerMoveState& b, float t, PlayerMoveState& out );
+// Replicated class for players, the client passes its callbacks
+ReplicatedClass* CreatePlayerClass( ReplicatedClass::CreateFn create=NULL, ReplicatedClass::DestroyFn destroy=NULL, ReplicatedClass::UpdateFn update=NULL );
 //--------------------------------------
 
 
@@ -107,9 +277,16 @@ void OnNewClient( clientID_t clientID, IPaddress clientAddr );
 void OnLostClient( clientID_t clientID, IPaddress clientAddr );
 Bullet* ServerFire( Player* player );
 void RespawnPlayer( Dictionary& params );
+float GetPlayerRelevance( clientID_t clientID, netEntityID_t id, const void* object );
+#ifdef HEADLESS_SERVER
+// Run the server at a fixed tick rate without a window until interrupted.
+// If captureFile is set all traffic is recorded to it.
+void RunDedicatedServer( int tickRate, const char* captureFile=NULL );
+#endif
 //--------------------------------------
 
 
+#ifndef HEADLESS_SERVER
 //--------------------------------------
 // Client
 //--------------------------------------
@@ -117,13 +294,17 @@ void InitClient( const std::string& addr );
 void OnClientExit();
 void ClientUpdate( float dt );
 bool ClientInput( SDL_Event& sdlEvent );
+void OnServerResolved( bool success, IPaddress serverAddr, void* userData );
 void OnServerConnect( clientID_t clientID, IPaddress clientAddr );
 void OnServerLost( clientID_t clientID, IPaddress clientAddr );
 void SendHello( const char* name );
-void ClientSendPos( Dictionary& params );
+void ClientSendInput( Dictionary& params );
 void PlayerSteer( Dictionary& params );
 void PlayerThrust( Dictionary& params );
 void ApplyPlayerMotion( float dx, float dy );
 void ClientFire( Dictionary& params );
 void ClientSpawnBullet( Dictionary& params );
-//--------------------------------------
\ No newline at end of file
+void* OnReplicatedPlayerCreate( netEntityID_t id );
+void OnReplicatedPlayerUpdate( netEntityID_t id, void* object, uint32 changedMask );
+//--------------------------------------
+#endif
\ No newline at end of file
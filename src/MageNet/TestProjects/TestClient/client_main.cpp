@@ -46,6 +46,12 @@ int main( int argc, char** argv )
 			if ( frame % 100 == 0 )
 			{
 				ConsolePrintf( "Send: %d\n", frame );
+				if ( session.GetTotalPacketsSent() > 0 )
+				{
+					ConsolePrintf( " Avg packet %.1fb, header+acks %.1fb\n"
+						, session.GetTotalBytesSent() / (float) session.GetTotalPacketsSent()
+						, session.GetTotalHeaderBytesSent() / (float) session.GetTotalPacketsSent() );
+				}
 				writer.Write< int >( frame );
 				client.SendData( writer, addr, SENDOPT_RELIABLE );
 				writer.Write< int >( frame + 1 );
@@ -59,7 +65,7 @@ int main( int argc, char** argv )
 			{
 				client.ReceiveData( reader, sender );
 				//ConsolePrintf( "Recv:\n %s\n", reader.ReadString( buff, 512 ) );
-				//ConsolePrintf( " RTT: %fs\n", session.GetAverageRTT( sender.GetID() ) );
+				//ConsolePrintf( " RTT: %fms\n", session.GetAverageRTT( sender.GetID() ) );
 			}
 		}
 	}
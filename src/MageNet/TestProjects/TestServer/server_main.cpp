@@ -17,10 +17,18 @@ int main( int argc, char** argv )
 	LocalClient sender;
 	int frame = 0;
 
+	CommandArgs args( argc, argv );
+
 	// Init
 	session.OpenPort( 5000 );
 	server = session.CreateLocalClient();
 
+	// Record traffic for NetReplay
+	if ( args.GetArgAs( "-capture", buff ) )
+	{
+		session.StartCapture( buff );
+	}
+
 	//session.SetPacketLoss( 50 );
 
 
@@ -0,0 +1,103 @@
+#include "NetLib.h"
+
+#ifdef WIN32
+#	include <Windows.h>
+#	include <mmsystem.h>
+#	pragma comment( lib, "winmm.lib" )
+#endif
+
+using namespace mage;
+
+//---------------------------------------
+const double TickScheduler::SPIN_TIME = 0.001;
+const int TickScheduler::MAX_TICKS_BEHIND = 5;
+//---------------------------------------
+
+
+//---------------------------------------
+TickScheduler::TickScheduler( int ticksPerSecond )
+	: mNextTickTime( 0 )
+	, mTickCount( 0 )
+	, mTicksSkipped( 0 )
+{
+	SetTickRate( ticksPerSecond );
+
+#ifdef WIN32
+	// Default timer resolution is ~15ms which is most of a tick
+	timeBeginPeriod( 1 );
+#endif
+}
+//---------------------------------------
+TickScheduler::~TickScheduler()
+{
+#ifdef WIN32
+	timeEndPeriod( 1 );
+#endif
+}
+//---------------------------------------
+void TickScheduler::SetTickRate( int ticksPerSecond )
+{
+	if ( ticksPerSecond <= 0 )
+	{
+		ConsolePrintf( CONSOLE_WARNING, "TickScheduler : Invalid tick rate %d, using 60\n", ticksPerSecond );
+		ticksPerSecond = 60;
+	}
+	mTickRate = ticksPerSecond;
+	mTickDelta = 1.0 / ticksPerSecond;
+}
+//---------------------------------------
+bool TickScheduler::WaitForNextTick( NetSession& session )
+{
+	double now = Clock::QueryTime();
+
+	// First tick runs right away
+	if ( mNextTickTime == 0 )
+	{
+		mNextTickTime = now;
+	}
+
+	// Sleep on the socket for most of the wait, waking up to pace out queued sends
+	double remaining = mNextTickTime - now;
+	while ( remaining > SPIN_TIME )
+	{
+		double wait = remaining - SPIN_TIME;
+		double sendWait = session.GetTimeUntilNextSend();
+		if ( sendWait >= 0 && sendWait < wait )
+		{
+			wait = sendWait;
+		}
+
+		if ( session.WaitForPacket( (uint32) ( wait * 1000000.0 ) ) )
+		{
+			return false;
+		}
+
+		session.FlushSendQueues();
+		remaining = mNextTickTime - Clock::QueryTime();
+	}
+
+	// Spin the rest
+	do
+	{
+		now = Clock::QueryTime();
+	} while ( now < mNextTickTime );
+
+	AdvanceTick( now );
+	return true;
+}
+//---------------------------------------
+void TickScheduler::AdvanceTick( double now )
+{
+	++mTickCount;
+	mNextTickTime += mTickDelta;
+
+	// Stalled (ie. debugger or overloaded box), don't try to catch up on every missed tick
+	if ( now - mNextTickTime > MAX_TICKS_BEHIND * mTickDelta )
+	{
+		uint32 skipped = (uint32) ( ( now - mNextTickTime ) / mTickDelta );
+		mTicksSkipped += skipped;
+		ConsolePrintf( CONSOLE_WARNING, "TickScheduler : Fell behind, skipping %u ticks\n", skipped );
+		mNextTickTime = now + mTickDelta;
+	}
+}
+//---------------------------------------
\ No newline at end of file
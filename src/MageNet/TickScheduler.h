@@ -0,0 +1,53 @@
+/*
+ * Author      : Matthew Johnson
+ * Date        : 19/Oct/2026
+ * Description :
+ *   Fixed rate tick scheduler for dedicated servers.
+ *   Sleeps on the session socket until the next tick is due so incoming
+ *   packets can be drained as soon as they arrive, then spins for the last
+ *   bit of the wait since OS sleeps are not accurate to the millisecond.
+ *   Queued sends are flushed while waiting so they are spread over the tick.
+ */
+ 
+#pragma once
+
+namespace mage
+{
+
+	class NetSession;
+
+	class TickScheduler
+	{
+	public:
+		TickScheduler( int ticksPerSecond );
+		~TickScheduler();
+
+		void SetTickRate( int ticksPerSecond );
+
+		/**Wait until the next tick or until a packet arrives on session.
+		 * Data the session queued for bandwidth limited clients is sent as the budget allows while waiting.
+		 * Returns true when a tick is due and the simulation should be stepped by GetTickDelta().
+		 * Returns false if woken early by a packet.
+		 */
+		bool WaitForNextTick( NetSession& session );
+
+		int GetTickRate() const						{ return mTickRate; }
+		float GetTickDelta() const					{ return (float) mTickDelta; }
+		uint32 GetTickCount() const					{ return mTickCount; }
+		// Ticks dropped because we fell too far behind
+		uint32 GetTicksSkipped() const				{ return mTicksSkipped; }
+
+	private:
+		void AdvanceTick( double now );
+
+		int mTickRate;
+		double mTickDelta;					// Seconds per tick
+		double mNextTickTime;				// Real time the next tick is due (sec)
+		uint32 mTickCount;
+		uint32 mTicksSkipped;
+
+		static const double SPIN_TIME;			// Stop sleeping this long before a tick and spin instead (sec)
+		static const int MAX_TICKS_BEHIND;		// Resync instead of running this many ticks back to back
+	};
+
+}
\ No newline at end of file
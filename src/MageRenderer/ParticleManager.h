@@ -49,15 +49,16 @@ namespace mage
 				: mStart( 0 )
 				, mPoolSize( poolSize )
 			{
+				// Particles are stored together, the list orders them
+				mParticles = new Particle[ mPoolSize ];
 				mParticleList = new Particle*[ mPoolSize ];
 				for ( int i = 0; i < mPoolSize; ++i )
-					mParticleList[i] = new Particle();
+					mParticleList[i] = &mParticles[i];
 			}
 			~ParticlePool()
 			{
-				for ( int i = 0; i < mPoolSize; ++i )
-					delete mParticleList[i];
 				delete[] mParticleList;
+				delete[] mParticles;
 			}
 
 			inline int GetStart() const						{ return mStart; }
@@ -71,6 +72,7 @@ namespace mage
 		private:
 			int mStart;
 			int mPoolSize;
+			Particle* mParticles;
 			Particle** mParticleList;
 		};
 
@@ -362,7 +362,8 @@ void DrawCircle( float cx, float cy, float r, const mage::Color& color )
 	const int segments = 20;
 	const float inc = Mathf::TWO_PI / segments;
 	float theta = 0;
-	std::vector< float > polyLine;
+	std::vector< float, FrameStlAllocator< float > > polyLine;
+	polyLine.reserve( 2 * segments );
 
 	for ( int i = 0; i < segments; ++i )
 	{